@@ -0,0 +1,243 @@
+/*****************************************************************************
+
+Module Name:
+
+  asyncLog.cpp
+
+Description:
+
+  Logger that is safe to call from the servo loop: the formatting and the
+  writer thread.
+
+*******************************************************************************/
+
+#include <string.h>
+
+#include "asyncLog.h"
+
+namespace
+{
+
+// Ring buffer room, in messages. With rate limiting only a burst from many
+// call sites at once can fill it.
+const size_t kLogRingCapacity = 1024;
+
+// Longest formatted message; longer ones are cut.
+const size_t kLogLineSize = 512;
+
+long long integerValue(const LogArg& arg)
+{
+    switch (arg.type)
+    {
+    case LogArg::REAL: return (long long) arg.d;
+    case LogArg::POINTER: return (long long) (size_t) arg.p;
+    case LogArg::UNSIGNED: return (long long) arg.u;
+    default: return arg.i;
+    }
+}
+
+double realValue(const LogArg& arg)
+{
+    switch (arg.type)
+    {
+    case LogArg::INTEGER: return (double) arg.i;
+    case LogArg::UNSIGNED: return (double) arg.u;
+    case LogArg::POINTER: return 0;
+    default: return arg.d;
+    }
+}
+
+const void* pointerValue(const LogArg& arg)
+{
+    return arg.type == LogArg::POINTER ? arg.p : NULL;
+}
+
+/* Appends the output of snprintf to buffer, keeping it terminated when it
+   runs out of room. */
+template <typename T>
+void appendFormatted(char* buffer, size_t size, size_t& length, const char* spec, T value)
+{
+    if (length + 1 >= size)
+    {
+        return;
+    }
+    const int written = snprintf(buffer + length, size - length, spec, value);
+    if (written > 0)
+    {
+        length += (size_t) written;
+        if (length >= size)
+        {
+            length = size - 1;
+        }
+    }
+}
+
+void appendText(char* buffer, size_t size, size_t& length, const char* text, size_t count)
+{
+    if (length + count >= size)
+    {
+        count = size - 1 - length;
+    }
+    memcpy(buffer + length, text, count);
+    length += count;
+    buffer[length] = '\0';
+}
+
+} // namespace
+
+/******************************************************************************
+ Printf style formatting of a stored record. Each conversion is handed to
+ snprintf on its own, with its length modifier replaced to match the type
+ the argument was stored as, so a mismatched modifier in the log call
+ cannot misread the arguments.
+******************************************************************************/
+void formatLogRecord(const LogRecord& record, char* buffer, size_t size)
+{
+    size_t length = 0;
+    buffer[0] = '\0';
+    int nextArg = 0;
+
+    const char* p = record.format;
+    while (*p != '\0')
+    {
+        const char* percent = strchr(p, '%');
+        if (percent == NULL)
+        {
+            appendText(buffer, size, length, p, strlen(p));
+            break;
+        }
+        appendText(buffer, size, length, p, (size_t) (percent - p));
+
+        if (percent[1] == '%')
+        {
+            appendText(buffer, size, length, "%", 1);
+            p = percent + 2;
+            continue;
+        }
+
+        // Flags, width and precision are kept; length modifiers are dropped.
+        char spec[32];
+        size_t specLength = 0;
+        const char* q = percent;
+        spec[specLength++] = *q++;
+        while (*q != '\0' && strchr("-+ #0123456789.", *q) != NULL && specLength < sizeof(spec) - 4)
+        {
+            spec[specLength++] = *q++;
+        }
+        while (*q != '\0' && strchr("hljztL", *q) != NULL)
+        {
+            ++q;
+        }
+        const char conversion = *q;
+        if (conversion == '\0' || nextArg >= record.argCount)
+        {
+            // Malformed, or more conversions than arguments: print it as is.
+            appendText(buffer, size, length, percent, conversion == '\0' ? strlen(percent) : (size_t) (q + 1 - percent));
+            p = conversion == '\0' ? q : q + 1;
+            continue;
+        }
+
+        const LogArg& arg = record.args[nextArg++];
+        switch (conversion)
+        {
+        case 'd': case 'i':
+        case 'u': case 'o': case 'x': case 'X':
+            spec[specLength++] = 'l';
+            spec[specLength++] = 'l';
+            spec[specLength++] = conversion;
+            spec[specLength] = '\0';
+            appendFormatted(buffer, size, length, spec, integerValue(arg));
+            break;
+        case 'c':
+            spec[specLength++] = conversion;
+            spec[specLength] = '\0';
+            appendFormatted(buffer, size, length, spec, (int) integerValue(arg));
+            break;
+        case 'f': case 'F': case 'e': case 'E':
+        case 'g': case 'G': case 'a': case 'A':
+            spec[specLength++] = conversion;
+            spec[specLength] = '\0';
+            appendFormatted(buffer, size, length, spec, realValue(arg));
+            break;
+        case 's':
+            spec[specLength++] = conversion;
+            spec[specLength] = '\0';
+            appendFormatted(buffer, size, length, spec,
+                            pointerValue(arg) != NULL ? (const char*) pointerValue(arg) : "(null)");
+            break;
+        case 'p':
+            spec[specLength++] = conversion;
+            spec[specLength] = '\0';
+            appendFormatted(buffer, size, length, spec, pointerValue(arg));
+            break;
+        default:
+            appendText(buffer, size, length, percent, (size_t) (q + 1 - percent));
+            break;
+        }
+        p = q + 1;
+    }
+}
+
+AsyncLog::AsyncLog()
+    : m_out(NULL), m_running(false), m_startTime(0), m_minInterval(0)
+{
+}
+
+AsyncLog::~AsyncLog()
+{
+    stop();
+}
+
+void AsyncLog::start(FILE* out, double minInterval)
+{
+    stop();
+
+    m_out = out;
+    m_startTime = monotonicSeconds();
+    m_minInterval = minInterval;
+    m_drain.start(kLogRingCapacity,
+                  [this](const LogRecord* records, size_t count) { write(records, count); });
+    m_running.store(true);
+}
+
+void AsyncLog::stop()
+{
+    if (m_out == NULL)
+    {
+        return;
+    }
+
+    m_running.store(false);
+    m_drain.stop();
+
+    if (m_drain.dropped() > 0)
+    {
+        fprintf(m_out, "Log dropped %lu messages.\n", m_drain.dropped());
+    }
+    fflush(m_out);
+    m_out = NULL;
+}
+
+/******************************************************************************
+ Writer thread side: formats and writes whatever has been logged.
+******************************************************************************/
+void AsyncLog::write(const LogRecord* records, size_t count)
+{
+    char line[kLogLineSize];
+    for (size_t i = 0; i < count; ++i)
+    {
+        const LogRecord& record = records[i];
+        formatLogRecord(record, line, sizeof(line));
+        if (record.suppressed > 0)
+        {
+            fprintf(m_out, "[%9.3f] %s (%lu more suppressed)\n", record.time, line, record.suppressed);
+        }
+        else
+        {
+            fprintf(m_out, "[%9.3f] %s\n", record.time, line);
+        }
+    }
+    fflush(m_out);
+}
+
+/******************************************************************************/
@@ -0,0 +1,200 @@
+/*****************************************************************************
+
+Module Name:
+
+  asyncLog.h
+
+Description:
+
+  Logger that is safe to call from the servo loop. A log call copies the
+  format string pointer and its arguments into a ring buffer; a background
+  thread formats the message and writes it out. The servo thread never
+  formats, allocates, takes a lock or makes a system call.
+
+  Each call site is rate limited: after a message is logged, the same site
+  stays quiet for the logger's minimum interval and only counts what it
+  skipped, which the next message reports.
+
+  Restrictions that keep the log call cheap:
+    - one thread logs into a given AsyncLog (the ring is single producer);
+    - at most kMaxLogArgs arguments, of integer, floating point or pointer
+      type, with printf style conversions;
+    - the format and any %s argument must stay valid until the message is
+      written, i.e. be string literals.
+
+*******************************************************************************/
+
+#ifndef AsyncLog_H_
+#define AsyncLog_H_
+
+#include <stdio.h>
+
+#include <atomic>
+#include <type_traits>
+
+#include "drainThread.h"
+#include "monotonicClock.h"
+
+const int kMaxLogArgs = 6;
+
+struct LogArg
+{
+    enum Type { INTEGER, UNSIGNED, REAL, POINTER };
+
+    Type type;
+    union
+    {
+        long long i;
+        unsigned long long u;
+        double d;
+        const void* p;
+    };
+};
+
+struct LogRecord
+{
+    const char* format;
+    double time;              // seconds since the logger started
+    unsigned long suppressed; // messages this site skipped before this one
+    int argCount;
+    LogArg args[kMaxLogArgs];
+};
+
+/* Rate limiting state of one log call site. ASYNC_LOG keeps one per site. */
+struct LogSite
+{
+    LogSite() : next(0), suppressed(0) {}
+
+    double next;
+    unsigned long suppressed;
+};
+
+template <typename T>
+LogArg makeLogArg(T value, std::integral_constant<int, LogArg::INTEGER>)
+{
+    LogArg arg;
+    arg.type = LogArg::INTEGER;
+    arg.i = (long long) value;
+    return arg;
+}
+
+template <typename T>
+LogArg makeLogArg(T value, std::integral_constant<int, LogArg::UNSIGNED>)
+{
+    LogArg arg;
+    arg.type = LogArg::UNSIGNED;
+    arg.u = (unsigned long long) value;
+    return arg;
+}
+
+template <typename T>
+LogArg makeLogArg(T value, std::integral_constant<int, LogArg::REAL>)
+{
+    LogArg arg;
+    arg.type = LogArg::REAL;
+    arg.d = (double) value;
+    return arg;
+}
+
+template <typename T>
+LogArg makeLogArg(T value, std::integral_constant<int, LogArg::POINTER>)
+{
+    LogArg arg;
+    arg.type = LogArg::POINTER;
+    arg.p = (const void*) value;
+    return arg;
+}
+
+/* Stores one argument with its type, picked at compile time. */
+template <typename T>
+LogArg makeLogArg(T value)
+{
+    static_assert(std::is_arithmetic<T>::value || std::is_pointer<T>::value,
+                  "log arguments must be numbers or pointers");
+    return makeLogArg(value, std::integral_constant<int,
+        std::is_pointer<T>::value ? LogArg::POINTER :
+        std::is_floating_point<T>::value ? LogArg::REAL :
+        std::is_signed<T>::value ? LogArg::INTEGER : LogArg::UNSIGNED>());
+}
+
+inline void packLogArgs(LogArg*)
+{
+}
+
+template <typename T, typename... Rest>
+void packLogArgs(LogArg* out, T value, Rest... rest)
+{
+    *out = makeLogArg(value);
+    packLogArgs(out + 1, rest...);
+}
+
+class AsyncLog
+{
+public:
+    AsyncLog();
+    ~AsyncLog();
+
+    /* Starts the writer thread. Each call site logs at most once per
+       minInterval seconds. */
+    void start(FILE* out, double minInterval);
+
+    /* Stops the writer thread after it has written everything logged. */
+    void stop();
+
+    bool running() const { return m_running.load(std::memory_order_relaxed); }
+
+    /* Logging thread side; use ASYNC_LOG rather than calling this. Does
+       nothing while the logger is stopped. */
+    template <typename... Args>
+    void log(LogSite& site, const char* format, Args... args)
+    {
+        static_assert(sizeof...(Args) <= kMaxLogArgs, "too many log arguments");
+        if (!running())
+        {
+            return;
+        }
+
+        const double now = monotonicSeconds();
+        if (now < site.next)
+        {
+            ++site.suppressed;
+            return;
+        }
+        site.next = now + m_minInterval;
+
+        LogRecord record;
+        record.format = format;
+        record.time = now - m_startTime;
+        record.suppressed = site.suppressed;
+        record.argCount = (int) sizeof...(Args);
+        packLogArgs(record.args, args...);
+        site.suppressed = 0;
+
+        m_drain.push(record);
+    }
+
+    unsigned long dropped() const { return m_drain.dropped(); }
+
+private:
+    void write(const LogRecord* records, size_t count);
+
+    FILE* m_out;
+    DrainThread<LogRecord> m_drain;
+    std::atomic<bool> m_running;
+    double m_startTime;
+    double m_minInterval;
+
+    AsyncLog(const AsyncLog&);
+    AsyncLog& operator=(const AsyncLog&);
+};
+
+/* Formats a record the way the writer thread does, without the time stamp. */
+void formatLogRecord(const LogRecord& record, char* buffer, size_t size);
+
+/* Logs a printf style message through logger, rate limited per call site. */
+#define ASYNC_LOG(logger, ...) \
+    do { static LogSite asyncLogSite_; (logger).log(asyncLogSite_, __VA_ARGS__); } while (0)
+
+#endif /* AsyncLog_H_ */
+
+/******************************************************************************/
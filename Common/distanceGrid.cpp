@@ -0,0 +1,246 @@
+/*****************************************************************************
+
+Module Name:
+
+  distanceGrid.cpp
+
+Description:
+
+  Dense signed distance grid: layout, gradients, trilinear lookup and
+  file format.
+
+  File layout, native byte order: a DistanceGridHeader followed by the
+  GridSample of every grid point, x fastest, then y, then z.
+
+*******************************************************************************/
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "distanceGrid.h"
+
+namespace
+{
+
+const char kDistanceGridMagic[8] = { 'S', 'D', 'F', 'G', 'R', 'I', 'D', '\0' };
+const uint32_t kDistanceGridVersion = 1;
+
+struct DistanceGridHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t sampleSize; // sizeof(GridSample), also catches byte order mismatches
+    int32_t size[3];
+    int32_t reserved;
+    double origin[3];
+    double cellSize;
+};
+
+inline void lerpSample(const GridSample& a, const GridSample& b, float t, GridSample& out)
+{
+    out.distance = a.distance + (b.distance - a.distance) * t;
+    for (int i = 0; i < 3; ++i)
+    {
+        out.gradient[i] = a.gradient[i] + (b.gradient[i] - a.gradient[i]) * t;
+    }
+}
+
+} // namespace
+
+DistanceGrid::DistanceGrid()
+    : m_cellSize(0), m_inverseCell(0)
+{
+    m_size[0] = m_size[1] = m_size[2] = 0;
+}
+
+void DistanceGrid::resize(const hduVector3Dd& lo, const hduVector3Dd& hi, double cellSize)
+{
+    m_origin = lo;
+    m_cellSize = cellSize;
+    m_inverseCell = 1 / cellSize;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        // At least two points per axis, so every query has a whole cell around it.
+        const int cells = (int) ceil((hi[axis] - lo[axis]) / cellSize);
+        m_size[axis] = (cells > 1 ? cells : 1) + 1;
+    }
+    m_samples.assign((size_t) m_size[0] * m_size[1] * m_size[2], GridSample());
+}
+
+/******************************************************************************
+ Central differences inside the grid, one sided at its faces, normalized.
+ Where the gradient vanishes (on a medial plane, say) the normal is left
+ zero, which gives no force rather than a wrong one.
+******************************************************************************/
+void DistanceGrid::computeGradients()
+{
+    for (int k = 0; k < m_size[2]; ++k)
+    {
+        for (int j = 0; j < m_size[1]; ++j)
+        {
+            for (int i = 0; i < m_size[0]; ++i)
+            {
+                const int at[3] = { i, j, k };
+                double g[3];
+                double length2 = 0;
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    int lo[3] = { i, j, k };
+                    int hi[3] = { i, j, k };
+                    lo[axis] = at[axis] > 0 ? at[axis] - 1 : 0;
+                    hi[axis] = at[axis] < m_size[axis] - 1 ? at[axis] + 1 : at[axis];
+                    const double span = (hi[axis] - lo[axis]) * m_cellSize;
+                    g[axis] = (m_samples[index(hi[0], hi[1], hi[2])].distance -
+                               m_samples[index(lo[0], lo[1], lo[2])].distance) / span;
+                    length2 += g[axis] * g[axis];
+                }
+
+                GridSample& s = m_samples[index(i, j, k)];
+                const double scale = length2 > 1e-12 ? 1 / sqrt(length2) : 0;
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    s.gradient[axis] = (float) (g[axis] * scale);
+                }
+            }
+        }
+    }
+}
+
+/******************************************************************************
+ Trilinear interpolation of the distance and gradient over the cell
+ holding p. A point outside the grid uses the nearest point on its
+ boundary, plus the distance between the two.
+******************************************************************************/
+double DistanceGrid::sample(const hduVector3Dd& p, hduVector3Dd& normal) const
+{
+    int cell[3];
+    float t[3];
+    double outside2 = 0;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        double x = (p[axis] - m_origin[axis]) * m_inverseCell;
+        const double last = m_size[axis] - 1;
+        if (x < 0)
+        {
+            outside2 += x * x;
+            x = 0;
+        }
+        else if (x > last)
+        {
+            outside2 += (x - last) * (x - last);
+            x = last;
+        }
+        int c = (int) x;
+        if (c > m_size[axis] - 2)
+        {
+            c = m_size[axis] - 2;
+        }
+        cell[axis] = c;
+        t[axis] = (float) (x - c);
+    }
+
+    const size_t base = index(cell[0], cell[1], cell[2]);
+    const size_t dy = m_size[0];
+    const size_t dz = (size_t) m_size[0] * m_size[1];
+    const GridSample* s = &m_samples[base];
+
+    GridSample x00, x10, x01, x11, y0, y1, v;
+    lerpSample(s[0], s[1], t[0], x00);
+    lerpSample(s[dy], s[dy + 1], t[0], x10);
+    lerpSample(s[dz], s[dz + 1], t[0], x01);
+    lerpSample(s[dz + dy], s[dz + dy + 1], t[0], x11);
+    lerpSample(x00, x10, t[1], y0);
+    lerpSample(x01, x11, t[1], y1);
+    lerpSample(y0, y1, t[2], v);
+
+    normal.set(v.gradient[0], v.gradient[1], v.gradient[2]);
+    const double length = normal.magnitude();
+    if (length > 1e-9)
+    {
+        normal /= length;
+    }
+
+    double distance = v.distance;
+    if (outside2 > 0)
+    {
+        distance += sqrt(outside2) * m_cellSize;
+    }
+    return distance;
+}
+
+bool DistanceGrid::save(const char* path) const
+{
+    FILE* file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Cannot create distance grid '%s'.\n", path);
+        return false;
+    }
+
+    DistanceGridHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kDistanceGridMagic, sizeof(header.magic));
+    header.version = kDistanceGridVersion;
+    header.sampleSize = sizeof(GridSample);
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        header.size[axis] = m_size[axis];
+        header.origin[axis] = m_origin[axis];
+    }
+    header.cellSize = m_cellSize;
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(&m_samples[0], sizeof(GridSample), m_samples.size(), file) == m_samples.size();
+    ok = fclose(file) == 0 && ok;
+    if (!ok)
+    {
+        fprintf(stderr, "Cannot write distance grid '%s'.\n", path);
+    }
+    return ok;
+}
+
+bool DistanceGrid::load(const char* path)
+{
+    m_samples.clear();
+
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Cannot open distance grid '%s'.\n", path);
+        return false;
+    }
+
+    DistanceGridHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, kDistanceGridMagic, sizeof(header.magic)) != 0 ||
+        header.version != kDistanceGridVersion ||
+        header.sampleSize != sizeof(GridSample) ||
+        header.size[0] < 2 || header.size[1] < 2 || header.size[2] < 2 ||
+        header.cellSize <= 0)
+    {
+        fprintf(stderr, "'%s' is not a distance grid.\n", path);
+        fclose(file);
+        return false;
+    }
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        m_size[axis] = header.size[axis];
+        m_origin[axis] = header.origin[axis];
+    }
+    m_cellSize = header.cellSize;
+    m_inverseCell = 1 / m_cellSize;
+    m_samples.resize((size_t) m_size[0] * m_size[1] * m_size[2]);
+    const bool ok = fread(&m_samples[0], sizeof(GridSample), m_samples.size(), file) == m_samples.size();
+    fclose(file);
+    if (!ok)
+    {
+        fprintf(stderr, "Distance grid '%s' is truncated.\n", path);
+        m_samples.clear();
+    }
+    return ok;
+}
+
+/******************************************************************************/
@@ -0,0 +1,154 @@
+/*****************************************************************************
+
+Module Name:
+
+  distanceGrid.h
+
+Description:
+
+  Dense signed distance field: a regular grid of distances to a surface
+  and their gradients, baked once from any geometry that can report its
+  signed distance (negative inside), then saved and loaded as a flat
+  binary file. A query is one trilinear fetch of the eight corners of its
+  cell, which gives the distance and the surface normal, so it costs the
+  same whether the grid was baked from a plane or from a mesh of a
+  million triangles.
+
+  Each grid point is stored as four floats, distance first, so the eight
+  corners of a cell are four runs of two neighbours along x, 32 bytes each.
+  A run straddles a 64 byte cache line when it starts in the last 16 bytes
+  of one, so a lookup touches between four and eight lines.
+
+  SdfField renders a grid as a force primitive for ForceScene (see
+  forceField.h).
+
+*******************************************************************************/
+
+#ifndef DistanceGrid_H_
+#define DistanceGrid_H_
+
+#include <stddef.h>
+
+#include <thread>
+#include <vector>
+
+#include <HDU/hduVector.h>
+
+struct GridSample
+{
+    float distance;
+    float gradient[3];
+};
+
+class DistanceGrid
+{
+public:
+    DistanceGrid();
+
+    /* Samples distance(p) on the grid points of the box from lo to hi,
+       cellSize apart, spread over the available cores, then takes the
+       gradients by central differences. distance must be safe to call from
+       several threads at once. */
+    template <typename Distance>
+    void bake(const hduVector3Dd& lo, const hduVector3Dd& hi, double cellSize, const Distance& distance);
+
+    /* Writes or reads the grid. Both print a message and return false on
+       failure; a failed load leaves the grid empty. */
+    bool save(const char* path) const;
+    bool load(const char* path);
+
+    bool empty() const { return m_samples.empty(); }
+
+    /* Signed distance at p, and the unit normal there. Past the edge of the
+       grid the distance grows with the distance to the grid, so a grid
+       baked with some margin around the surface never reports contact
+       outside it. */
+    double sample(const hduVector3Dd& p, hduVector3Dd& normal) const;
+
+    int size(int axis) const { return m_size[axis]; }
+    double cellSize() const { return m_cellSize; }
+    size_t bytes() const { return m_samples.size() * sizeof(GridSample); }
+
+private:
+    void resize(const hduVector3Dd& lo, const hduVector3Dd& hi, double cellSize);
+    void computeGradients();
+
+    size_t index(int i, int j, int k) const
+    {
+        return ((size_t) k * m_size[1] + j) * m_size[0] + i;
+    }
+
+    hduVector3Dd m_origin;
+    double m_cellSize;
+    double m_inverseCell;
+    int m_size[3]; // grid points along each axis
+    std::vector<GridSample> m_samples;
+};
+
+template <typename Distance>
+void DistanceGrid::bake(const hduVector3Dd& lo, const hduVector3Dd& hi, double cellSize, const Distance& distance)
+{
+    resize(lo, hi, cellSize);
+
+    // Each thread takes every threadCount-th slice of the grid along z.
+    unsigned threadCount = std::thread::hardware_concurrency();
+    if (threadCount == 0)
+    {
+        threadCount = 1;
+    }
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < threadCount; ++t)
+    {
+        threads.push_back(std::thread([this, &distance, t, threadCount]()
+        {
+            for (int k = (int) t; k < m_size[2]; k += (int) threadCount)
+            {
+                for (int j = 0; j < m_size[1]; ++j)
+                {
+                    for (int i = 0; i < m_size[0]; ++i)
+                    {
+                        const hduVector3Dd p = m_origin + hduVector3Dd(i, j, k) * m_cellSize;
+                        m_samples[index(i, j, k)].distance = (float) distance(p);
+                    }
+                }
+            }
+        }));
+    }
+    for (size_t t = 0; t < threads.size(); ++t)
+    {
+        threads[t].join();
+    }
+
+    computeGradients();
+}
+
+/******************************************************************************
+ A distance grid as a force primitive: a HIP sphere of the given radius
+ (0 for a point) is pushed out along the surface normal with a spring of
+ stiffness k on its penetration.
+******************************************************************************/
+struct SdfField
+{
+    const DistanceGrid* grid;
+    double radius;
+    double k;
+
+    SdfField(const DistanceGrid* distanceGrid, double hipRadius, double stiffness)
+        : grid(distanceGrid), radius(hipRadius), k(stiffness)
+    {
+    }
+
+    void addForce(const hduVector3Dd& position, hduVector3Dd& force) const
+    {
+        hduVector3Dd normal;
+        const double depth = radius - grid->sample(position, normal);
+        if (depth > 0)
+        {
+            force += normal * (k * depth);
+        }
+    }
+};
+
+#endif /* DistanceGrid_H_ */
+
+/******************************************************************************/
@@ -0,0 +1,134 @@
+/*****************************************************************************
+
+Module Name:
+
+  drainThread.h
+
+Description:
+
+  Background thread that empties an SpscRing filled by the servo loop and
+  hands what it takes to a writer, in batches. The servo side only pushes,
+  and a push into a full ring is counted as dropped rather than waited on;
+  the drain thread sleeps while the ring is empty. Telemetry, the session
+  recorder and the servo log each run one.
+
+*******************************************************************************/
+
+#ifndef DrainThread_H_
+#define DrainThread_H_
+
+#include <stddef.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "spscRing.h"
+
+// Ring room for streams of one item per servo tick: several seconds at
+// 1 kHz, so a slow disk or console holds up the drain thread for a while
+// before anything is dropped.
+const size_t kTickRingCapacity = 8192;
+
+// Largest number of items handed to the writer at once.
+const size_t kDrainBatchSize = 512;
+
+// How long the drain thread sleeps when the ring is empty.
+const int kDrainIdleMs = 20;
+
+template <typename T>
+class DrainThread
+{
+public:
+    /* Called on the drain thread, or in stop(), with each batch. */
+    typedef std::function<void(const T* items, size_t count)> Writer;
+
+    DrainThread()
+        : m_stop(false), m_dropped(0)
+    {
+    }
+
+    ~DrainThread()
+    {
+        stop();
+    }
+
+    /* Sizes the ring for capacity items, empties it and starts the thread.
+       Not thread safe; call before the producer starts pushing. */
+    void start(size_t capacity, const Writer& write)
+    {
+        stop();
+        m_ring.init(capacity);
+        m_batch.resize(kDrainBatchSize);
+        m_write = write;
+        m_dropped.store(0);
+        m_stop.store(false);
+        m_thread = std::thread(&DrainThread::run, this);
+    }
+
+    /* Stops the thread, then writes whatever is still in the ring. */
+    void stop()
+    {
+        if (!m_thread.joinable())
+        {
+            return;
+        }
+        m_stop.store(true);
+        m_thread.join();
+        while (drain() > 0)
+        {
+        }
+    }
+
+    /* Producer side. Never blocks; returns false, and counts the item as
+       dropped, if the ring is full. */
+    bool push(const T& item)
+    {
+        if (!m_ring.push(item))
+        {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    unsigned long dropped() const { return m_dropped.load(); }
+
+private:
+    size_t drain()
+    {
+        const size_t count = m_ring.popBatch(&m_batch[0], m_batch.size());
+        if (count > 0)
+        {
+            m_write(&m_batch[0], count);
+        }
+        return count;
+    }
+
+    void run()
+    {
+        while (!m_stop.load())
+        {
+            if (drain() == 0)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(kDrainIdleMs));
+            }
+        }
+    }
+
+    SpscRing<T> m_ring;
+    std::vector<T> m_batch;
+    Writer m_write;
+    std::thread m_thread;
+    std::atomic<bool> m_stop;
+    std::atomic<unsigned long> m_dropped;
+
+    DrainThread(const DrainThread&);
+    DrainThread& operator=(const DrainThread&);
+};
+
+#endif /* DrainThread_H_ */
+
+/******************************************************************************/
@@ -0,0 +1,264 @@
+/*****************************************************************************
+
+Module Name:
+
+  forceField.h
+
+Description:
+
+  Haptic force primitives (plane, open box, rigid sphere, gravity well)
+  and ForceScene, which composes any mix of them at compile time. A scene
+  is a plain aggregate of its primitives; its force() adds up each
+  primitive's force in a fixed, fully inlined sequence, with no virtual
+  calls, no per primitive branching on type and no allocation, so a scene
+  costs no more per servo tick than writing the primitives out by hand.
+
+  Every primitive has
+
+      void addForce(const hduVector3Dd& position, hduVector3Dd& force) const;
+
+  which adds its force on a HIP at position (mm) to force (N). Stiffnesses
+  are in N/mm. Any type with that member can be put in a scene.
+
+  The primitives with a surface also have
+
+      double distance(const hduVector3Dd& position) const;
+
+  the signed distance from position to the surface, negative where the
+  primitive pushes back, so they can be baked into a DistanceGrid.
+
+  Example:
+
+      typedef ForceScene<PlaneField, SphereField> Scene;
+      const Scene scene(PlaneField(...), SphereField(...));
+      hdSetDoublev(HD_CURRENT_FORCE, scene.force(position));
+
+*******************************************************************************/
+
+#ifndef ForceField_H_
+#define ForceField_H_
+
+#include <math.h>
+#include <stddef.h>
+
+#include <tuple>
+#include <utility>
+
+#include <HDU/hduVector.h>
+
+/******************************************************************************
+ Frictionless plane through point with the given normal. The HIP is pushed
+ out along the normal when it is behind the plane.
+******************************************************************************/
+struct PlaneField
+{
+    hduVector3Dd normal; // unit
+    hduVector3Dd point;
+    double k;
+
+    PlaneField(const hduVector3Dd& planeNormal, const hduVector3Dd& planePoint, double stiffness)
+        : normal(planeNormal), point(planePoint), k(stiffness)
+    {
+        normal.normalize();
+    }
+
+    /* How far the HIP is behind the plane, or 0 if it is in front. */
+    double depth(const hduVector3Dd& position) const
+    {
+        const double d = dotProduct(position - point, normal);
+        return d < 0 ? -d : 0;
+    }
+
+    double distance(const hduVector3Dd& position) const
+    {
+        return dotProduct(position - point, normal);
+    }
+
+    void addForce(const hduVector3Dd& position, hduVector3Dd& force) const
+    {
+        const double d = dotProduct(position - point, normal);
+        if (d < 0)
+        {
+            force -= normal * (k * d);
+        }
+    }
+};
+
+/******************************************************************************
+ Axis aligned box that holds the HIP inside it, with some faces left open.
+ Each closed face pushes the HIP back in when it passes through it.
+******************************************************************************/
+struct BoxField
+{
+    enum Face
+    {
+        MIN_X = 1 << 0, MAX_X = 1 << 1,
+        MIN_Y = 1 << 2, MAX_Y = 1 << 3,
+        MIN_Z = 1 << 4, MAX_Z = 1 << 5
+    };
+
+    hduVector3Dd low, high;
+    double k;
+    int openFaces; // Face bits
+
+    BoxField(const hduVector3Dd& boxLow, const hduVector3Dd& boxHigh, double stiffness, int open = 0)
+        : low(boxLow), high(boxHigh), k(stiffness), openFaces(open)
+    {
+    }
+
+    /* Distance to the nearest closed face, taking each face as a whole
+       plane; exact inside the box, an underestimate past its corners. */
+    double distance(const hduVector3Dd& position) const
+    {
+        double d = HUGE_VAL;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            if (!(openFaces & (MIN_X << (2 * axis))) && position[axis] - low[axis] < d)
+            {
+                d = position[axis] - low[axis];
+            }
+            if (!(openFaces & (MAX_X << (2 * axis))) && high[axis] - position[axis] < d)
+            {
+                d = high[axis] - position[axis];
+            }
+        }
+        return d;
+    }
+
+    void addForce(const hduVector3Dd& position, hduVector3Dd& force) const
+    {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            if (position[axis] < low[axis] && !(openFaces & (MIN_X << (2 * axis))))
+            {
+                force[axis] += k * (low[axis] - position[axis]);
+            }
+            else if (position[axis] > high[axis] && !(openFaces & (MAX_X << (2 * axis))))
+            {
+                force[axis] += k * (high[axis] - position[axis]);
+            }
+        }
+    }
+};
+
+/******************************************************************************
+ Rigid sphere. The HIP is pushed out radially while it is inside; the
+ square root is only taken on contact.
+******************************************************************************/
+struct SphereField
+{
+    hduVector3Dd center;
+    double radius;
+    double k;
+
+    SphereField(const hduVector3Dd& sphereCenter, double sphereRadius, double stiffness)
+        : center(sphereCenter), radius(sphereRadius), k(stiffness)
+    {
+    }
+
+    double distance(const hduVector3Dd& position) const
+    {
+        return (position - center).magnitude() - radius;
+    }
+
+    void addForce(const hduVector3Dd& position, hduVector3Dd& force) const
+    {
+        const hduVector3Dd r = position - center;
+        const double distanceSquared = dotProduct(r, r);
+        if (distanceSquared < radius * radius && distanceSquared > 0)
+        {
+            const double distance = sqrt(distanceSquared);
+            force += r * (k * (radius - distance) / distance);
+        }
+    }
+};
+
+/******************************************************************************
+ Gravity well: an inverse square pull towards center beyond radius R, and
+ inside it a spring with stiffness k/R^3, which matches the pull at R so
+ the force is continuous.
+******************************************************************************/
+struct GravityWellField
+{
+    hduVector3Dd center;
+    double radius;
+    double k;
+
+    GravityWellField(const hduVector3Dd& wellCenter, double wellRadius, double strength)
+        : center(wellCenter), radius(wellRadius), k(strength)
+    {
+    }
+
+    void addForce(const hduVector3Dd& position, hduVector3Dd& force) const
+    {
+        const hduVector3Dd d = position - center;
+        const double distanceSquared = dotProduct(d, d);
+        if (distanceSquared > radius * radius)
+        {
+            const double distance = sqrt(distanceSquared);
+            force -= d * (k / (distanceSquared * distance));
+        }
+        else
+        {
+            force -= d * (k / (radius * radius * radius));
+        }
+    }
+};
+
+/******************************************************************************
+ A scene of any number of primitives, of any types with addForce.
+******************************************************************************/
+template <typename... Fields>
+class ForceScene
+{
+public:
+    explicit ForceScene(const Fields&... fields)
+        : m_fields(fields...)
+    {
+    }
+
+    /* Net force of all the primitives on a HIP at position. */
+    hduVector3Dd force(const hduVector3Dd& position) const
+    {
+        hduVector3Dd f(0, 0, 0);
+        addForces(position, f, std::index_sequence_for<Fields...>());
+        return f;
+    }
+
+    /* The I-th primitive, e.g. to move it or to query it. */
+    template <size_t I>
+    typename std::tuple_element<I, std::tuple<Fields...> >::type& field()
+    {
+        return std::get<I>(m_fields);
+    }
+
+    template <size_t I>
+    const typename std::tuple_element<I, std::tuple<Fields...> >::type& field() const
+    {
+        return std::get<I>(m_fields);
+    }
+
+    static const size_t fieldCount = sizeof...(Fields);
+
+private:
+    template <size_t... I>
+    void addForces(const hduVector3Dd& position, hduVector3Dd& f, std::index_sequence<I...>) const
+    {
+        // Expands to one addForce call per primitive, in order.
+        const int expand[] = { 0, (std::get<I>(m_fields).addForce(position, f), 0)... };
+        (void) expand;
+    }
+
+    std::tuple<Fields...> m_fields;
+};
+
+/* Deduces the scene type from its primitives. */
+template <typename... Fields>
+ForceScene<Fields...> makeForceScene(const Fields&... fields)
+{
+    return ForceScene<Fields...>(fields...);
+}
+
+#endif /* ForceField_H_ */
+
+/******************************************************************************/
@@ -0,0 +1,46 @@
+/*****************************************************************************
+
+Module Name:
+
+  monotonicClock.h
+
+Description:
+
+  The monotonic clock everything here is timed with: the servo scheduler's
+  deadlines, telemetry and recordings, the physics thread and the logs. On
+  Linux it is CLOCK_MONOTONIC, the clock clock_nanosleep sleeps on; reading
+  it goes through the vDSO and makes no system call.
+
+*******************************************************************************/
+
+#ifndef MonotonicClock_H_
+#define MonotonicClock_H_
+
+#if defined(__linux__)
+#include <time.h>
+#else
+#include <chrono>
+#endif
+
+/* Nanoseconds on the monotonic clock. */
+inline long long monotonicNs()
+{
+#if defined(__linux__)
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (long long) now.tv_sec * 1000000000LL + now.tv_nsec;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+/* Seconds on the monotonic clock. */
+inline double monotonicSeconds()
+{
+    return monotonicNs() * 1e-9;
+}
+
+#endif /* MonotonicClock_H_ */
+
+/******************************************************************************/
@@ -0,0 +1,373 @@
+/*****************************************************************************
+
+Module Name:
+
+  realtime.cpp
+
+Description:
+
+  Opt-in real-time setup for the servo loop.
+
+*******************************************************************************/
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+
+#include "realtime.h"
+
+#if defined(__linux__)
+#include <alloca.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <ucontext.h>
+#include <unistd.h>
+#endif
+
+RealtimeOptions::RealtimeOptions()
+    : enabled(false),
+      cpu(-1),
+      priority(80),
+      heapPrefault(32 << 20),
+      stackPrefault(128 << 10)
+{
+}
+
+namespace
+{
+
+const size_t kPageSize = 4096;
+
+// Distinct system calls the check keeps track of.
+const int kMaxTrappedCalls = 16;
+
+struct ServoThreadStatus
+{
+    std::atomic<bool> done;
+    int cpu;
+    int pinError;
+    int fifoError;
+    bool checkArmed;
+};
+
+ServoThreadStatus gServoStatus;
+
+// Filled in by the SIGSYS handler, on the servo thread only.
+struct TrappedCall
+{
+    long number;
+    unsigned long count;
+};
+TrappedCall gTrappedCalls[kMaxTrappedCalls];
+std::atomic<int> gTrappedCallCount(0);
+std::atomic<unsigned long> gTrappedTotal(0);
+
+bool parseInt(const char* value, int low, int high, int* result)
+{
+    char* end = NULL;
+    const long v = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || v < low || v > high)
+    {
+        return false;
+    }
+    *result = (int) v;
+    return true;
+}
+
+#if defined(__linux__)
+
+/* First core the kernel was told to keep free of other work (isolcpus),
+   else the last core this process may run on. */
+int pickServoCpu()
+{
+    FILE* file = fopen("/sys/devices/system/cpu/isolated", "r");
+    if (file != NULL)
+    {
+        int cpu = -1;
+        const int read = fscanf(file, "%d", &cpu);
+        fclose(file);
+        if (read == 1 && cpu >= 0)
+        {
+            return cpu;
+        }
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+    {
+        for (int cpu = CPU_SETSIZE - 1; cpu >= 0; --cpu)
+        {
+            if (CPU_ISSET(cpu, &set))
+            {
+                return cpu;
+            }
+        }
+    }
+    return 0;
+}
+
+/* Grows the stack by bytes and touches every page, so the servo loop
+   never faults in stack pages. Kept out of line so the frame is really
+   this large. */
+__attribute__((noinline)) void prefaultStack(size_t bytes)
+{
+    volatile char* stack = (volatile char*) alloca(bytes);
+    for (size_t i = 0; i < bytes; i += kPageSize)
+    {
+        stack[i] = 0;
+    }
+}
+
+#endif
+
+#if defined(RT_SYSCALL_CHECK)
+
+// si_code of a SIGSYS raised by syscall user dispatch; older C libraries lack it.
+#ifndef SYS_USER_DISPATCH
+#define SYS_USER_DISPATCH 2
+#endif
+
+void noteTrappedCall(long number)
+{
+    gTrappedTotal.fetch_add(1, std::memory_order_relaxed);
+    const int count = gTrappedCallCount.load(std::memory_order_relaxed);
+    for (int i = 0; i < count; ++i)
+    {
+        if (gTrappedCalls[i].number == number)
+        {
+            ++gTrappedCalls[i].count;
+            return;
+        }
+    }
+    if (count < kMaxTrappedCalls)
+    {
+        gTrappedCalls[count].number = number;
+        gTrappedCalls[count].count = 1;
+        gTrappedCallCount.store(count + 1, std::memory_order_release);
+    }
+}
+
+/******************************************************************************
+ SIGSYS handler for syscall user dispatch. The trapped call has not been
+ made; the handler notes it, makes it on the caller's behalf and stores
+ the result where the caller expects it. The selector is left open, as
+ returning from the handler is itself a system call, so only the first
+ call of each servo tick is trapped.
+******************************************************************************/
+void onSyscallTrap(int, siginfo_t* info, void* context)
+{
+    rtSyscallSelector = SYSCALL_DISPATCH_FILTER_ALLOW;
+    if (info->si_code != SYS_USER_DISPATCH)
+    {
+        return;
+    }
+
+    const int savedErrno = errno;
+    noteTrappedCall(info->si_syscall);
+
+    greg_t* regs = ((ucontext_t*) context)->uc_mcontext.gregs;
+    const long result = syscall(info->si_syscall, regs[REG_RDI], regs[REG_RSI], regs[REG_RDX],
+                                regs[REG_R10], regs[REG_R8], regs[REG_R9]);
+    regs[REG_RAX] = result == -1 ? -errno : result;
+    errno = savedErrno;
+}
+
+bool armSyscallCheck()
+{
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = onSyscallTrap;
+    action.sa_flags = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGSYS, &action, NULL) != 0)
+    {
+        return false;
+    }
+
+    rtSyscallSelector = SYSCALL_DISPATCH_FILTER_ALLOW;
+    return prctl(PR_SET_SYSCALL_USER_DISPATCH, PR_SYS_DISPATCH_ON, 0, 0, &rtSyscallSelector) == 0;
+}
+
+#endif
+
+} // namespace
+
+#if defined(RT_SYSCALL_CHECK)
+thread_local volatile char rtSyscallSelector = SYSCALL_DISPATCH_FILTER_ALLOW;
+#endif
+
+/******************************************************************************
+ Parses and strips the real-time options.
+******************************************************************************/
+bool parseRealtimeOptions(int& argc, char* argv[], RealtimeOptions& options)
+{
+    int kept = 1;
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+
+        if (strcmp(arg, "--rt") == 0)
+        {
+            options.enabled = true;
+        }
+        else if (strncmp(arg, "--rt-cpu=", 9) == 0)
+        {
+            if (!parseInt(arg + 9, 0, 4095, &options.cpu))
+            {
+                fprintf(stderr, "Bad servo core '%s'.\n", arg + 9);
+                return false;
+            }
+            options.enabled = true;
+        }
+        else if (strncmp(arg, "--rt-priority=", 14) == 0)
+        {
+            if (!parseInt(arg + 14, 1, 99, &options.priority))
+            {
+                fprintf(stderr, "Bad servo priority '%s'.\n", arg + 14);
+                return false;
+            }
+            options.enabled = true;
+        }
+        else
+        {
+            argv[kept++] = argv[i];
+        }
+    }
+    argc = kept;
+    argv[argc] = NULL;
+    return true;
+}
+
+void printRealtimeOptionsUsage(FILE* stream)
+{
+    fprintf(stream,
+        "  --rt               real-time mode: lock memory, prefault, pin the servo thread\n"
+        "                     and run it SCHED_FIFO\n"
+        "  --rt-cpu=N         core for the servo thread (default: an isolated core, else\n"
+        "                     the last one)\n"
+        "  --rt-priority=N    SCHED_FIFO priority of the servo thread, 1-99 (default 80)\n");
+}
+
+/******************************************************************************
+ Process setup. Heap trimming and mmap allocations are turned off first so
+ the prefaulted heap stays with the process after it is freed.
+******************************************************************************/
+void rtSetupProcess(const RealtimeOptions& options)
+{
+    if (!options.enabled)
+    {
+        return;
+    }
+
+#if defined(__linux__)
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+        fprintf(stderr, "Real-time: cannot lock memory (%s); page faults may still stall the servo loop.\n",
+                strerror(errno));
+    }
+
+    char* heap = (char*) malloc(options.heapPrefault);
+    if (heap != NULL)
+    {
+        for (size_t i = 0; i < options.heapPrefault; i += kPageSize)
+        {
+            ((volatile char*) heap)[i] = 0;
+        }
+        free(heap);
+    }
+#else
+    fprintf(stderr, "Real-time mode is only supported on Linux.\n");
+#endif
+}
+
+/******************************************************************************
+ Servo thread setup. Only records what happened; rtReport prints it, so
+ the servo thread does not write to the console.
+******************************************************************************/
+void rtSetupServoThread(const RealtimeOptions& options)
+{
+    if (!options.enabled || gServoStatus.done.load())
+    {
+        return;
+    }
+
+#if defined(__linux__)
+    prefaultStack(options.stackPrefault);
+
+    gServoStatus.cpu = options.cpu >= 0 ? options.cpu : pickServoCpu();
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(gServoStatus.cpu, &set);
+    gServoStatus.pinError = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+
+    sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = options.priority;
+    gServoStatus.fifoError = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+#endif
+
+#if defined(RT_SYSCALL_CHECK)
+    gServoStatus.checkArmed = armSyscallCheck();
+#endif
+
+    gServoStatus.done.store(true);
+}
+
+void rtReport(FILE* stream)
+{
+    if (!gServoStatus.done.load())
+    {
+        return;
+    }
+
+    if (gServoStatus.pinError == 0)
+    {
+        fprintf(stream, "Real-time: servo thread pinned to core %d\n", gServoStatus.cpu);
+    }
+    else
+    {
+        fprintf(stream, "Real-time: cannot pin the servo thread to core %d (%s)\n",
+                gServoStatus.cpu, strerror(gServoStatus.pinError));
+    }
+    if (gServoStatus.fifoError == 0)
+    {
+        fprintf(stream, "Real-time: servo thread runs SCHED_FIFO\n");
+    }
+    else
+    {
+        fprintf(stream, "Real-time: cannot make the servo thread SCHED_FIFO (%s)\n",
+                strerror(gServoStatus.fifoError));
+    }
+
+#if defined(RT_SYSCALL_CHECK)
+    if (!gServoStatus.checkArmed)
+    {
+        fprintf(stream, "Real-time: the system call check is not supported by this kernel\n");
+        return;
+    }
+    const unsigned long total = gTrappedTotal.load();
+    if (total == 0)
+    {
+        fprintf(stream, "Real-time: the servo path made no system calls\n");
+        return;
+    }
+    fprintf(stream, "Real-time: the servo path made system calls on %lu ticks:\n", total);
+    const int count = gTrappedCallCount.load(std::memory_order_acquire);
+    for (int i = 0; i < count; ++i)
+    {
+        fprintf(stream, "  syscall %ld: %lu times\n", gTrappedCalls[i].number, gTrappedCalls[i].count);
+    }
+#endif
+}
+
+/******************************************************************************/
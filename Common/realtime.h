@@ -0,0 +1,81 @@
+/*****************************************************************************
+
+Module Name:
+
+  realtime.h
+
+Description:
+
+  Opt-in real-time setup for the servo loop (Linux). The process part
+  locks all memory and prefaults the heap, so the servo loop never waits
+  on a page fault. The servo thread part prefaults the thread's stack,
+  pins it to one core (an isolated one when the kernel has any) and gives
+  it SCHED_FIFO priority. Each step that the system refuses, usually for
+  lack of privileges, is reported and skipped; the rest still applies.
+
+  Builds without NDEBUG can also check that the servo path makes no
+  system calls. rtServoPathBegin()/rtServoPathEnd() mark the code that
+  must not make any. When the check is armed on the servo thread, Linux
+  syscall user dispatch traps every system call inside that code. The
+  call is still carried out, and rtReport() says which ones were made.
+
+*******************************************************************************/
+
+#ifndef Realtime_H_
+#define Realtime_H_
+
+#include <stddef.h>
+#include <stdio.h>
+
+struct RealtimeOptions
+{
+    // Whether to apply any of this.
+    bool enabled;
+
+    // Core to pin the servo thread to, or -1 to pick one.
+    int cpu;
+
+    // SCHED_FIFO priority of the servo thread (1-99).
+    int priority;
+
+    // Heap and servo stack touched up front (bytes).
+    size_t heapPrefault;
+    size_t stackPrefault;
+
+    RealtimeOptions();
+};
+
+/* Reads --rt, --rt-cpu=N and --rt-priority=N (either of the last two also
+   enables the mode) and removes them from argv. Prints a message and
+   returns false on a bad value. */
+bool parseRealtimeOptions(int& argc, char* argv[], RealtimeOptions& options);
+
+void printRealtimeOptionsUsage(FILE* stream);
+
+/* Process setup, from the main thread before the servo loop starts. */
+void rtSetupProcess(const RealtimeOptions& options);
+
+/* Servo thread setup. Call it on the servo thread itself, e.g. from the
+   servo callback's first tick. */
+void rtSetupServoThread(const RealtimeOptions& options);
+
+/* Prints what the servo thread setup did and, in builds with the syscall
+   check, the system calls made on the servo path. */
+void rtReport(FILE* stream);
+
+#if !defined(NDEBUG) && defined(__linux__) && defined(__x86_64__)
+#define RT_SYSCALL_CHECK 1
+
+// Syscall user dispatch selector of the calling thread.
+extern thread_local volatile char rtSyscallSelector;
+
+inline void rtServoPathBegin() { rtSyscallSelector = 1; }
+inline void rtServoPathEnd() { rtSyscallSelector = 0; }
+#else
+inline void rtServoPathBegin() {}
+inline void rtServoPathEnd() {}
+#endif
+
+#endif /* Realtime_H_ */
+
+/******************************************************************************/
@@ -0,0 +1,591 @@
+/*****************************************************************************
+
+Module Name:
+
+  sparseDistanceGrid.cpp
+
+Description:
+
+  Sparse brick distance field: baking, file format, lookup and prefetch.
+
+  File layout, native byte order: a SparseGridHeader, the stored bricks
+  (kBrickPoints quantized distances each, x fastest, then y, then z) and
+  the brick index (one int32 per brick of the whole box, x fastest).
+
+*******************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#if defined(WIN32)
+#include <stdlib.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "sparseDistanceGrid.h"
+
+namespace
+{
+
+const char kSparseGridMagic[8] = { 'S', 'D', 'F', 'B', 'R', 'I', 'C', 'K' };
+const uint32_t kSparseGridVersion = 1;
+
+// Grid points along each side of a brick, and the cells they span.
+const int kBrickSide = 8;
+const int kBrickCells = kBrickSide - 1;
+const int kBrickPoints = kBrickSide * kBrickSide * kBrickSide;
+
+// Index entries of the bricks that are not stored.
+const int32_t kBrickOutside = -1;
+const int32_t kBrickInside = -2;
+
+// How often the prefetcher looks at the HIP.
+const double kPrefetchPeriod = 0.002;
+
+struct SparseGridHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t bits;
+    int32_t brickCount[3];
+    int32_t storedBricks;
+    double origin[3];
+    double cellSize;
+    double band;
+    uint64_t brickOffset;
+    uint64_t indexOffset;
+};
+
+int quantizeMax(int bits)
+{
+    return bits == 8 ? 127 : 32767;
+}
+
+/******************************************************************************
+ Distance and gradient (per cell, unnormalized) at fraction t of the cell
+ whose low corner is point (x, y, z) of the brick.
+******************************************************************************/
+template <typename Q>
+double trilinear(const Q* brick, int x, int y, int z, const double t[3], double gradient[3])
+{
+    const int dy = kBrickSide;
+    const int dz = kBrickSide * kBrickSide;
+    const Q* c = brick + (z * kBrickSide + y) * kBrickSide + x;
+    const double c000 = c[0], c100 = c[1], c010 = c[dy], c110 = c[dy + 1];
+    const double c001 = c[dz], c101 = c[dz + 1], c011 = c[dz + dy], c111 = c[dz + dy + 1];
+
+    const double u = t[0], v = t[1], w = t[2];
+    const double x00 = c000 + (c100 - c000) * u;
+    const double x10 = c010 + (c110 - c010) * u;
+    const double x01 = c001 + (c101 - c001) * u;
+    const double x11 = c011 + (c111 - c011) * u;
+    const double y0 = x00 + (x10 - x00) * v;
+    const double y1 = x01 + (x11 - x01) * v;
+
+    gradient[0] = ((c100 - c000) * (1 - v) + (c110 - c010) * v) * (1 - w) +
+                  ((c101 - c001) * (1 - v) + (c111 - c011) * v) * w;
+    gradient[1] = (x10 - x00) * (1 - w) + (x11 - x01) * w;
+    gradient[2] = y1 - y0;
+    return y0 + (y1 - y0) * w;
+}
+
+/******************************************************************************
+ Bakes one brick into out. Returns kBrickOutside or kBrickInside if every
+ point of it lies beyond the band on that side, or 0 if it must be stored.
+******************************************************************************/
+template <typename Q>
+int32_t bakeBrick(const hduVector3Dd& corner, double cellSize, double band, int bits,
+                  const std::function<double(const hduVector3Dd&)>& distance, Q* out)
+{
+    // An exact distance changes by at most the distance moved, so the center
+    // decides for the whole brick when the surface is farther than its corners.
+    const double halfDiagonal = 0.5 * kBrickCells * cellSize * sqrt(3.0);
+    const double half = 0.5 * kBrickCells * cellSize;
+    const double center = distance(corner + hduVector3Dd(half, half, half));
+    if (center > halfDiagonal + band)
+    {
+        return kBrickOutside;
+    }
+    if (center < -halfDiagonal - band)
+    {
+        return kBrickInside;
+    }
+
+    const int qmax = quantizeMax(bits);
+    const double scale = qmax / band;
+    bool allOutside = true;
+    bool allInside = true;
+    for (int z = 0; z < kBrickSide; ++z)
+    {
+        for (int y = 0; y < kBrickSide; ++y)
+        {
+            for (int x = 0; x < kBrickSide; ++x)
+            {
+                double q = distance(corner + hduVector3Dd(x, y, z) * cellSize) * scale;
+                q = q > qmax ? qmax : (q < -qmax ? -qmax : q);
+                const Q value = (Q) lround(q);
+                out[(z * kBrickSide + y) * kBrickSide + x] = value;
+                allOutside = allOutside && value == qmax;
+                allInside = allInside && value == -qmax;
+            }
+        }
+    }
+    return allOutside ? kBrickOutside : (allInside ? kBrickInside : 0);
+}
+
+} // namespace
+
+SparseDistanceGrid::SparseDistanceGrid()
+    : m_data(NULL),
+      m_size(0),
+      m_index(NULL),
+      m_bricks(NULL),
+      m_brickBytes(0),
+      m_cellSize(0),
+      m_inverseCell(0),
+      m_band(0),
+      m_dequantize(0),
+      m_bits(0),
+      m_storedBricks(0),
+      m_lookups(0),
+      m_coldLookups(0),
+      m_pass(0),
+      m_prefetchStop(false),
+      m_prefetchRadius(0),
+      m_prefetchLookahead(0)
+{
+    m_brickCount[0] = m_brickCount[1] = m_brickCount[2] = 0;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        m_hip[axis].store(0);
+    }
+}
+
+SparseDistanceGrid::~SparseDistanceGrid()
+{
+    close();
+}
+
+/******************************************************************************
+ Bakes one z slab of bricks at a time, spread over the available cores,
+ and appends its stored bricks to the file; only the brick index of the
+ whole box is kept in memory. The header is written last, so a bake that
+ fails part way leaves a file that does not load.
+******************************************************************************/
+bool SparseDistanceGrid::bake(const char* path, const hduVector3Dd& lo, const hduVector3Dd& hi, double cellSize,
+                              double band, int bits, const std::function<double(const hduVector3Dd&)>& distance)
+{
+    if ((bits != 8 && bits != 16) || cellSize <= 0 || band <= 0)
+    {
+        fprintf(stderr, "Bad sparse distance grid settings: %d bits, %g mm cells, %g mm band.\n",
+                bits, cellSize, band);
+        return false;
+    }
+
+    SparseGridHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kSparseGridMagic, sizeof(header.magic));
+    header.version = kSparseGridVersion;
+    header.bits = bits;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const int cells = (int) ceil((hi[axis] - lo[axis]) / cellSize);
+        header.brickCount[axis] = cells > kBrickCells ? (cells + kBrickCells - 1) / kBrickCells : 1;
+        header.origin[axis] = lo[axis];
+    }
+    header.cellSize = cellSize;
+    header.band = band;
+    header.brickOffset = sizeof(SparseGridHeader);
+
+    FILE* file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Cannot create sparse distance grid '%s'.\n", path);
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    const int nx = header.brickCount[0];
+    const int ny = header.brickCount[1];
+    const int nz = header.brickCount[2];
+    const size_t brickBytes = kBrickPoints * (bits / 8);
+    std::vector<int32_t> index((size_t) nx * ny * nz);
+    std::vector<char> slab((size_t) nx * ny * brickBytes);
+    int32_t stored = 0;
+
+    unsigned threadCount = std::thread::hardware_concurrency();
+    if (threadCount == 0)
+    {
+        threadCount = 1;
+    }
+    const hduVector3Dd origin(header.origin[0], header.origin[1], header.origin[2]);
+    const double brickSize = kBrickCells * cellSize;
+
+    for (int bz = 0; bz < nz && ok; ++bz)
+    {
+        int32_t* slabIndex = &index[(size_t) bz * nx * ny];
+        std::vector<std::thread> threads;
+        for (unsigned t = 0; t < threadCount; ++t)
+        {
+            threads.push_back(std::thread([&, t]()
+            {
+                for (int i = (int) t; i < nx * ny; i += (int) threadCount)
+                {
+                    const hduVector3Dd corner = origin + hduVector3Dd(i % nx, i / nx, bz) * brickSize;
+                    char* out = &slab[(size_t) i * brickBytes];
+                    slabIndex[i] = bits == 8
+                        ? bakeBrick(corner, cellSize, band, bits, distance, (int8_t*) out)
+                        : bakeBrick(corner, cellSize, band, bits, distance, (int16_t*) out);
+                }
+            }));
+        }
+        for (size_t t = 0; t < threads.size(); ++t)
+        {
+            threads[t].join();
+        }
+
+        for (int i = 0; i < nx * ny && ok; ++i)
+        {
+            if (slabIndex[i] == 0)
+            {
+                slabIndex[i] = stored++;
+                ok = fwrite(&slab[(size_t) i * brickBytes], brickBytes, 1, file) == 1;
+            }
+        }
+    }
+
+    header.storedBricks = stored;
+    header.indexOffset = header.brickOffset + (uint64_t) stored * brickBytes;
+    ok = ok && fwrite(&index[0], sizeof(int32_t), index.size(), file) == index.size();
+    ok = ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = fclose(file) == 0 && ok;
+    if (!ok)
+    {
+        fprintf(stderr, "Cannot write sparse distance grid '%s'.\n", path);
+        remove(path);
+    }
+    return ok;
+}
+
+bool SparseDistanceGrid::isSparseGrid(const char* path)
+{
+    char magic[8];
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return false;
+    }
+    const bool sparse = fread(magic, sizeof(magic), 1, file) == 1 &&
+                        memcmp(magic, kSparseGridMagic, sizeof(magic)) == 0;
+    fclose(file);
+    return sparse;
+}
+
+bool SparseDistanceGrid::load(const char* path)
+{
+    close();
+
+#if defined(WIN32)
+    // No mapping here: the file is read whole.
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Cannot open sparse distance grid '%s'.\n", path);
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    const size_t size = (size_t) ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* data = (char*) malloc(size > 0 ? size : 1);
+    const bool read = data != NULL && fread(data, 1, size, file) == size;
+    fclose(file);
+    if (!read)
+    {
+        fprintf(stderr, "Cannot read sparse distance grid '%s'.\n", path);
+        free(data);
+        return false;
+    }
+#else
+    const int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0)
+    {
+        fprintf(stderr, "Cannot open sparse distance grid '%s'.\n", path);
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        return false;
+    }
+    const size_t size = (size_t) info.st_size;
+    void* data = size > 0 ? mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        fprintf(stderr, "Cannot map sparse distance grid '%s'.\n", path);
+        return false;
+    }
+#endif
+    m_data = (const char*) data;
+    m_size = size;
+
+    const SparseGridHeader* header = (const SparseGridHeader*) m_data;
+    bool valid = size >= sizeof(SparseGridHeader) &&
+        memcmp(header->magic, kSparseGridMagic, sizeof(header->magic)) == 0 &&
+        header->version == kSparseGridVersion &&
+        (header->bits == 8 || header->bits == 16) &&
+        header->brickCount[0] > 0 && header->brickCount[1] > 0 && header->brickCount[2] > 0 &&
+        header->storedBricks >= 0 && header->cellSize > 0 && header->band > 0;
+    if (valid)
+    {
+        const uint64_t brickBytes = kBrickPoints * (header->bits / 8);
+        const uint64_t indexCount = (uint64_t) header->brickCount[0] * header->brickCount[1] * header->brickCount[2];
+        valid = header->brickOffset == sizeof(SparseGridHeader) &&
+                header->indexOffset == header->brickOffset + header->storedBricks * brickBytes &&
+                size == header->indexOffset + indexCount * sizeof(int32_t);
+    }
+    if (!valid)
+    {
+        fprintf(stderr, "'%s' is not a sparse distance grid.\n", path);
+        close();
+        return false;
+    }
+
+    m_bits = (int) header->bits;
+    m_brickBytes = kBrickPoints * (m_bits / 8);
+    m_bricks = m_data + header->brickOffset;
+    m_index = (const int32_t*) (m_data + header->indexOffset);
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        m_brickCount[axis] = header->brickCount[axis];
+        m_origin[axis] = header->origin[axis];
+    }
+    m_cellSize = header->cellSize;
+    m_inverseCell = 1 / m_cellSize;
+    m_band = header->band;
+    m_dequantize = m_band / quantizeMax(m_bits);
+    m_storedBricks = header->storedBricks;
+
+    m_touched.reset(new std::atomic<uint32_t>[m_storedBricks > 0 ? m_storedBricks : 1]);
+    for (int i = 0; i < m_storedBricks; ++i)
+    {
+        m_touched[i].store(0, std::memory_order_relaxed);
+    }
+    m_pass.store(0);
+    m_lookups.store(0);
+    m_coldLookups.store(0);
+    return true;
+}
+
+void SparseDistanceGrid::close()
+{
+    stopPrefetch();
+    if (m_data != NULL)
+    {
+#if defined(WIN32)
+        free((void*) m_data);
+#else
+        munmap((void*) m_data, m_size);
+#endif
+    }
+    m_data = NULL;
+    m_size = 0;
+    m_index = NULL;
+    m_bricks = NULL;
+    m_storedBricks = 0;
+    m_touched.reset();
+}
+
+/******************************************************************************
+ Finds the brick and cell holding p and interpolates its eight corners.
+ Points outside the box use the nearest point on its boundary, plus the
+ distance between the two, like DistanceGrid.
+******************************************************************************/
+double SparseDistanceGrid::sample(const hduVector3Dd& p, hduVector3Dd& normal) const
+{
+    int brick[3];
+    int local[3];
+    double t[3];
+    double outside2 = 0;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        double x = (p[axis] - m_origin[axis]) * m_inverseCell;
+        const double last = m_brickCount[axis] * kBrickCells;
+        if (x < 0)
+        {
+            outside2 += x * x;
+            x = 0;
+        }
+        else if (x > last)
+        {
+            outside2 += (x - last) * (x - last);
+            x = last;
+        }
+        int cell = (int) x;
+        if (cell > last - 1)
+        {
+            cell = (int) last - 1;
+        }
+        brick[axis] = cell / kBrickCells;
+        local[axis] = cell - brick[axis] * kBrickCells;
+        t[axis] = x - cell;
+    }
+
+    const int32_t slot = m_index[((size_t) brick[2] * m_brickCount[1] + brick[1]) * m_brickCount[0] + brick[0]];
+    double distance;
+    if (slot < 0)
+    {
+        distance = slot == kBrickInside ? -m_band : m_band;
+        normal.set(0, 0, 0);
+    }
+    else
+    {
+        m_lookups.store(m_lookups.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        // A pass may still be on its way to this brick, so the previous one counts too.
+        const uint32_t touched = m_touched[slot].load(std::memory_order_relaxed);
+        if (touched == 0 || m_pass.load(std::memory_order_relaxed) - touched > 1)
+        {
+            m_coldLookups.store(m_coldLookups.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        const char* data = m_bricks + (size_t) slot * m_brickBytes;
+        double gradient[3];
+        const double q = m_bits == 8
+            ? trilinear((const int8_t*) data, local[0], local[1], local[2], t, gradient)
+            : trilinear((const int16_t*) data, local[0], local[1], local[2], t, gradient);
+        distance = q * m_dequantize;
+        normal.set(gradient[0], gradient[1], gradient[2]);
+        const double length = normal.magnitude();
+        if (length > 1e-12)
+        {
+            normal /= length;
+        }
+    }
+
+    if (outside2 > 0)
+    {
+        distance += sqrt(outside2) * m_cellSize;
+    }
+    return distance;
+}
+
+void SparseDistanceGrid::startPrefetch(double radius, double lookahead)
+{
+    stopPrefetch();
+    if (empty())
+    {
+        return;
+    }
+    m_prefetchRadius = radius;
+    m_prefetchLookahead = lookahead;
+
+    double lo[3], hi[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        lo[axis] = m_hip[axis].load(std::memory_order_relaxed) - radius;
+        hi[axis] = m_hip[axis].load(std::memory_order_relaxed) + radius;
+    }
+    m_pass.fetch_add(1, std::memory_order_relaxed);
+    prefetchBox(lo, hi);
+    m_prefetchStop.store(false);
+    m_prefetchThread = std::thread(&SparseDistanceGrid::prefetchRun, this);
+}
+
+void SparseDistanceGrid::stopPrefetch()
+{
+    if (m_prefetchThread.joinable())
+    {
+        m_prefetchStop.store(true);
+        m_prefetchThread.join();
+    }
+}
+
+void SparseDistanceGrid::track(const hduVector3Dd& position)
+{
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        m_hip[axis].store(position[axis], std::memory_order_relaxed);
+    }
+}
+
+/******************************************************************************
+ Prefetch loop. The HIP velocity is estimated from successive positions;
+ the bricks around the segment from the HIP to its predicted position are
+ touched again on every pass. Pages of the shared mapping the kernel has
+ evicted since are faulted back in here rather than in the servo loop, and
+ resident bricks cost one load per page.
+******************************************************************************/
+void SparseDistanceGrid::prefetchRun()
+{
+    typedef std::chrono::steady_clock Clock;
+    const Clock::duration period =
+        std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(kPrefetchPeriod));
+
+    double previous[3];
+    bool first = true;
+    while (!m_prefetchStop.load(std::memory_order_relaxed))
+    {
+        double lo[3], hi[3];
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            const double x = m_hip[axis].load(std::memory_order_relaxed);
+            const double velocity = first ? 0 : (x - previous[axis]) / kPrefetchPeriod;
+            const double ahead = x + velocity * m_prefetchLookahead;
+            lo[axis] = (x < ahead ? x : ahead) - m_prefetchRadius;
+            hi[axis] = (x > ahead ? x : ahead) + m_prefetchRadius;
+            previous[axis] = x;
+        }
+        first = false;
+        m_pass.fetch_add(1, std::memory_order_relaxed);
+        prefetchBox(lo, hi);
+        std::this_thread::sleep_for(period);
+    }
+}
+
+void SparseDistanceGrid::prefetchBox(const double lo[3], const double hi[3])
+{
+    const uint32_t pass = m_pass.load(std::memory_order_relaxed);
+
+    int from[3], to[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const double brickSize = kBrickCells * m_cellSize;
+        from[axis] = (int) floor((lo[axis] - m_origin[axis]) / brickSize);
+        to[axis] = (int) floor((hi[axis] - m_origin[axis]) / brickSize);
+        from[axis] = from[axis] < 0 ? 0 : from[axis];
+        to[axis] = to[axis] >= m_brickCount[axis] ? m_brickCount[axis] - 1 : to[axis];
+    }
+
+    for (int z = from[2]; z <= to[2]; ++z)
+    {
+        for (int y = from[1]; y <= to[1]; ++y)
+        {
+            for (int x = from[0]; x <= to[0]; ++x)
+            {
+                // Reading the index entry brings its page in too.
+                const int32_t slot = m_index[((size_t) z * m_brickCount[1] + y) * m_brickCount[0] + x];
+                if (slot < 0)
+                {
+                    continue;
+                }
+                const volatile char* data = m_bricks + (size_t) slot * m_brickBytes;
+                for (size_t offset = 0; offset < m_brickBytes; offset += 512)
+                {
+                    (void) data[offset];
+                }
+                (void) data[m_brickBytes - 1];
+                m_touched[slot].store(pass, std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+/******************************************************************************/
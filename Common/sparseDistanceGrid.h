@@ -0,0 +1,133 @@
+/*****************************************************************************
+
+Module Name:
+
+  sparseDistanceGrid.h
+
+Description:
+
+  Sparse signed distance field for large workspaces at fine resolution.
+  Space is cut into bricks of 8 x 8 x 8 grid points (7 cells a side, the
+  last layer of points shared with the next brick). Only the bricks the
+  surface passes near are stored; every other brick is recorded as wholly
+  outside or wholly inside. Distances are quantized to 8 or 16 bits over a
+  narrow band around the surface, and gradients are not stored but taken
+  from the eight corners of the cell at query time, so a 0.25 mm field
+  costs a few bytes per square millimetre of surface instead of 16 bytes
+  per grid point of the workspace.
+
+  The field is baked straight to a file, one slab of bricks at a time, and
+  memory mapped for rendering, so neither baking nor rendering needs the
+  whole field in memory. A prefetch thread follows the HIP and touches the
+  bricks around where it is heading on every pass, so the servo loop finds
+  them resident instead of faulting them in, even after the kernel evicted
+  pages of the mapping; the servo loop counts any lookup of a brick the
+  prefetcher has not touched in its last two passes.
+
+  Outside the band the distance saturates at +-band and the normal is
+  zero, so the band has to cover the deepest the HIP sphere can go. With
+  --rt all memory is locked, the mapping included, so the whole file must
+  then fit in memory.
+
+*******************************************************************************/
+
+#ifndef SparseDistanceGrid_H_
+#define SparseDistanceGrid_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+
+#include <HDU/hduVector.h>
+
+class SparseDistanceGrid
+{
+public:
+    SparseDistanceGrid();
+    ~SparseDistanceGrid();
+
+    /* Bakes distance(p) on the box from lo to hi, cellSize apart, to the
+       file at path, keeping the bricks within band (mm) of the surface with
+       bits (8 or 16) per distance. distance must be an exact signed
+       distance, negative inside, and safe to call from several threads at
+       once; whole bricks far from the surface are skipped after a single
+       call. Prints a message and returns false on failure. */
+    static bool bake(const char* path, const hduVector3Dd& lo, const hduVector3Dd& hi, double cellSize,
+                     double band, int bits, const std::function<double(const hduVector3Dd&)>& distance);
+
+    /* Whether the file at path holds a sparse grid. */
+    static bool isSparseGrid(const char* path);
+
+    /* Maps a baked file. Prints a message and returns false on failure,
+       leaving the grid empty. */
+    bool load(const char* path);
+    void close();
+
+    bool empty() const { return m_data == NULL; }
+
+    /* Signed distance at p, and the unit normal there (zero outside the
+       band). Servo loop side; never blocks. */
+    double sample(const hduVector3Dd& p, hduVector3Dd& normal) const;
+
+    /* Prefetching: the servo loop reports the HIP position every tick with
+       track(); the thread touches every brick within radius (mm) of the
+       path from the HIP to where it will be lookahead seconds later. The
+       bricks around the last tracked position are touched before
+       startPrefetch returns. */
+    void startPrefetch(double radius, double lookahead);
+    void stopPrefetch();
+    void track(const hduVector3Dd& position);
+
+    int brickCount(int axis) const { return m_brickCount[axis]; }
+    int storedBricks() const { return m_storedBricks; }
+    double cellSize() const { return m_cellSize; }
+    int bits() const { return m_bits; }
+    size_t bytes() const { return m_size; }
+
+    /* Servo lookups so far, and those of them on a brick the prefetcher had
+       not touched in its current or previous pass. */
+    uint64_t lookups() const { return m_lookups.load(std::memory_order_relaxed); }
+    uint64_t coldLookups() const { return m_coldLookups.load(std::memory_order_relaxed); }
+
+private:
+    void prefetchRun();
+    void prefetchBox(const double lo[3], const double hi[3]);
+
+    const char* m_data; // the mapped file
+    size_t m_size;
+    const int32_t* m_index; // per brick: stored brick number, or kBrickOutside / kBrickInside
+    const char* m_bricks;
+    size_t m_brickBytes;
+
+    hduVector3Dd m_origin;
+    double m_cellSize;
+    double m_inverseCell;
+    double m_band;
+    double m_dequantize; // mm per quantization step
+    int m_bits;
+    int m_brickCount[3];
+    int m_storedBricks;
+
+    // Prefetch pass that last touched each stored brick, 0 for none yet.
+    std::unique_ptr<std::atomic<uint32_t>[]> m_touched;
+    std::atomic<uint32_t> m_pass;
+    mutable std::atomic<uint64_t> m_lookups;
+    mutable std::atomic<uint64_t> m_coldLookups;
+
+    std::atomic<double> m_hip[3];
+    std::thread m_prefetchThread;
+    std::atomic<bool> m_prefetchStop;
+    double m_prefetchRadius;
+    double m_prefetchLookahead;
+
+    SparseDistanceGrid(const SparseDistanceGrid&);
+    SparseDistanceGrid& operator=(const SparseDistanceGrid&);
+};
+
+#endif /* SparseDistanceGrid_H_ */
+
+/******************************************************************************/
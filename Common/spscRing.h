@@ -0,0 +1,138 @@
+/*****************************************************************************
+
+Module Name:
+
+  spscRing.h
+
+Description:
+
+  Bounded wait-free queue between exactly one producer thread and one
+  consumer thread. The servo loop uses it to hand data to slower threads
+  (file writers, loggers) without ever blocking: a push into a full ring
+  fails immediately and the caller decides what to drop.
+
+  The capacity is rounded up to a power of two and allocated once, before
+  the threads start.
+
+*******************************************************************************/
+
+#ifndef SpscRing_H_
+#define SpscRing_H_
+
+#include <stddef.h>
+
+#include <atomic>
+#include <vector>
+
+template <typename T>
+class SpscRing
+{
+public:
+    SpscRing()
+        : m_mask(0), m_head(0), m_cachedTail(0), m_tail(0), m_cachedHead(0)
+    {
+    }
+
+    explicit SpscRing(size_t capacity)
+        : m_mask(0), m_head(0), m_cachedTail(0), m_tail(0), m_cachedHead(0)
+    {
+        init(capacity);
+    }
+
+    /* Allocates room for at least capacity items and empties the ring.
+       Not thread safe; call before the producer and consumer start. */
+    void init(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+        {
+            size *= 2;
+        }
+        m_items.assign(size, T());
+        m_mask = size - 1;
+        m_head.store(0);
+        m_tail.store(0);
+        m_cachedTail = 0;
+        m_cachedHead = 0;
+    }
+
+    size_t capacity() const { return m_items.size(); }
+
+    /* Producer side. Returns false, without waiting, if the ring is full. */
+    bool push(const T& item)
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_cachedTail > m_mask)
+        {
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+            if (head - m_cachedTail > m_mask)
+            {
+                return false;
+            }
+        }
+        m_items[head & m_mask] = item;
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* Consumer side. Returns false if the ring is empty. */
+    bool pop(T& item)
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail == m_cachedHead)
+        {
+            m_cachedHead = m_head.load(std::memory_order_acquire);
+            if (tail == m_cachedHead)
+            {
+                return false;
+            }
+        }
+        item = m_items[tail & m_mask];
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* Consumer side. Moves up to maxCount items into out and returns how
+       many were moved. */
+    size_t popBatch(T* out, size_t maxCount)
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        m_cachedHead = m_head.load(std::memory_order_acquire);
+        size_t count = m_cachedHead - tail;
+        if (count > maxCount)
+        {
+            count = maxCount;
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            out[i] = m_items[(tail + i) & m_mask];
+        }
+        m_tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    /* Consumer side. */
+    bool empty() const
+    {
+        return m_tail.load(std::memory_order_relaxed) == m_head.load(std::memory_order_acquire);
+    }
+
+private:
+    std::vector<T> m_items;
+    size_t m_mask;
+
+    // Producer owned, plus its cached copy of the consumer's index.
+    alignas(64) std::atomic<size_t> m_head;
+    size_t m_cachedTail;
+
+    // Consumer owned, plus its cached copy of the producer's index.
+    alignas(64) std::atomic<size_t> m_tail;
+    size_t m_cachedHead;
+
+    SpscRing(const SpscRing&);
+    SpscRing& operator=(const SpscRing&);
+};
+
+#endif /* SpscRing_H_ */
+
+/******************************************************************************/
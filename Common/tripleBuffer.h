@@ -0,0 +1,86 @@
+/*****************************************************************************
+
+Module Name:
+
+  tripleBuffer.h
+
+Description:
+
+  Wait-free hand-off of a value from one writer thread to one reader
+  thread. The writer fills its private slot and publishes it by swapping it
+  with the shared middle slot; the reader takes the middle slot when it
+  holds something newer than what it has. Neither side ever blocks or
+  waits for the other, and each always has a complete value to work with.
+
+  T is copied by neither side, so it may hold preallocated storage (for
+  example std::vector members sized before the threads start). The writer
+  gets back an old slot after every publish and must overwrite all of it.
+
+*******************************************************************************/
+
+#ifndef TripleBuffer_H_
+#define TripleBuffer_H_
+
+#include <atomic>
+
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer()
+        : m_write(0), m_middle(1), m_read(2)
+    {
+    }
+
+    /* All three slots, for sizing storage before the threads start. */
+    T& slot(int i) { return m_slots[i].value; }
+
+    /* Writer side: the slot being filled, and publishing it. */
+    T& writeBuffer() { return m_slots[m_write].value; }
+
+    void publish()
+    {
+        m_write = m_middle.exchange(m_write | kFresh, std::memory_order_acq_rel) & kIndexMask;
+    }
+
+    /* Reader side: whether a value newer than the read slot is waiting. */
+    bool fresh() const
+    {
+        return (m_middle.load(std::memory_order_relaxed) & kFresh) != 0;
+    }
+
+    /* Reader side: takes the latest published value if there is one newer
+       than the current read slot. Returns true if the read slot changed. */
+    bool update()
+    {
+        if (!fresh())
+        {
+            return false;
+        }
+        m_read = m_middle.exchange(m_read, std::memory_order_acq_rel) & kIndexMask;
+        return true;
+    }
+
+    const T& readBuffer() const { return m_slots[m_read].value; }
+
+private:
+    enum { kIndexMask = 3, kFresh = 4 };
+
+    // Each slot on its own cache lines so the two threads never share one.
+    struct alignas(64) Slot
+    {
+        T value;
+    };
+
+    Slot m_slots[3];
+    alignas(64) unsigned m_write;
+    alignas(64) std::atomic<unsigned> m_middle;
+    alignas(64) unsigned m_read;
+
+    TripleBuffer(const TripleBuffer&);
+    TripleBuffer& operator=(const TripleBuffer&);
+};
+
+#endif /* TripleBuffer_H_ */
+
+/******************************************************************************/
@@ -0,0 +1,225 @@
+/*****************************************************************************
+
+Module Name:
+
+  bodies.cpp
+
+Description:
+
+  Storage and time integration for the dynamic spheres.
+
+*******************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+
+#include "bodies.h"
+
+/******************************************************************************
+ Reserves storage for capacity bodies in every attribute array.
+******************************************************************************/
+void BodyWorld::reserve(int capacity)
+{
+    px.reserve(capacity); py.reserve(capacity); pz.reserve(capacity);
+    vx.reserve(capacity); vy.reserve(capacity); vz.reserve(capacity);
+    fx.reserve(capacity); fy.reserve(capacity); fz.reserve(capacity);
+    mass.reserve(capacity);
+    invMass.reserve(capacity);
+    radius.reserve(capacity);
+    damping.reserve(capacity);
+    kxx.reserve(capacity); kyy.reserve(capacity); kzz.reserve(capacity);
+    kxy.reserve(capacity); kxz.reserve(capacity); kyz.reserve(capacity);
+}
+
+/******************************************************************************
+ Appends a body and returns its index.
+******************************************************************************/
+int BodyWorld::addBody(const hduVector3Dd& position,
+                       const hduVector3Dd& velocity,
+                       double bodyMass,
+                       double bodyRadius,
+                       double bodyDamping)
+{
+    px.push_back(position[0]); py.push_back(position[1]); pz.push_back(position[2]);
+    vx.push_back(velocity[0]); vy.push_back(velocity[1]); vz.push_back(velocity[2]);
+    fx.push_back(0); fy.push_back(0); fz.push_back(0);
+    mass.push_back(bodyMass);
+    invMass.push_back(1.0 / bodyMass);
+    radius.push_back(bodyRadius);
+    damping.push_back(bodyDamping);
+    kxx.push_back(0); kyy.push_back(0); kzz.push_back(0);
+    kxy.push_back(0); kxz.push_back(0); kyz.push_back(0);
+    return count() - 1;
+}
+
+/******************************************************************************
+ Zeroes the force (and stiffness) accumulators.
+******************************************************************************/
+void BodyWorld::clearForces()
+{
+    const int n = count();
+    for (int i = 0; i < n; ++i)
+    {
+        fx[i] = 0;
+        fy[i] = 0;
+        fz[i] = 0;
+    }
+
+    if (trackStiffness)
+    {
+        for (int i = 0; i < n; ++i)
+        {
+            kxx[i] = 0; kyy[i] = 0; kzz[i] = 0;
+            kxy[i] = 0; kxz[i] = 0; kyz[i] = 0;
+        }
+    }
+}
+
+/******************************************************************************
+ Integrates all bodies over one time step. Acceleration is the applied force
+ over mass less a velocity proportional damping term; the velocity is updated
+ first and the new velocity is used to advance the position.
+******************************************************************************/
+void BodyWorld::integrate(double dt)
+{
+    const int n = count();
+    for (int i = 0; i < n; ++i)
+    {
+        const double ax = fx[i] * invMass[i] - damping[i] * vx[i];
+        const double ay = fy[i] * invMass[i] - damping[i] * vy[i];
+        const double az = fz[i] * invMass[i] - damping[i] * vz[i];
+
+        vx[i] += ax * dt;
+        vy[i] += ay * dt;
+        vz[i] += az * dt;
+
+        px[i] += vx[i] * dt;
+        py[i] += vy[i] * dt;
+        pz[i] += vz[i] * dt;
+    }
+}
+
+/******************************************************************************
+ Largest body radius.
+******************************************************************************/
+double BodyWorld::maxRadius() const
+{
+    double r = 0;
+    for (int i = 0; i < count(); ++i)
+    {
+        if (radius[i] > r)
+        {
+            r = radius[i];
+        }
+    }
+    return r;
+}
+
+namespace
+{
+
+/* Center of lattice site (i, j, k) of a perAxis^3 lattice filling the box. */
+hduVector3Dd latticeSite(int i, int j, int k, int perAxis, double side_length)
+{
+    const double spacing = side_length / perAxis;
+    return hduVector3Dd(-side_length / 2 + (i + 0.5) * spacing,
+                        -side_length / 2 + (j + 0.5) * spacing,
+                        -side_length / 2 + (k + 0.5) * spacing);
+}
+
+/* True when a body of bodyRadius at site would start inside one of the
+   first existing bodies of world. */
+bool siteOverlaps(const BodyWorld& world, int existing, const hduVector3Dd& site, double bodyRadius)
+{
+    for (int b = 0; b < existing; ++b)
+    {
+        const hduVector3Dd r = world.position(b) - site;
+        if (r.magnitude() < world.radius[b] + bodyRadius)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+/******************************************************************************
+ Places bodies on a cubic lattice centered in the box. Sites that overlap the
+ existing bodies are skipped, and the lattice is refined until enough free
+ sites remain for the whole request, but never so far that neighbouring
+ bodies would start inside each other. A request that does not fit is placed
+ as far as it goes, with a warning.
+******************************************************************************/
+int spawnBodyLattice(BodyWorld& world,
+                     int count,
+                     double bodyMass,
+                     double bodyRadius,
+                     double bodyDamping,
+                     double side_length)
+{
+    if (count <= 0)
+    {
+        return 0;
+    }
+
+    const int existing = world.count();
+    const int finest = (int) floor(side_length / (2 * bodyRadius));
+    int perAxis = (int) ceil(pow((double) count, 1.0 / 3.0));
+    if (perAxis > finest)
+    {
+        perAxis = finest;
+    }
+    for (;;)
+    {
+        int freeSites = 0;
+        for (int k = 0; k < perAxis; ++k)
+        {
+            for (int j = 0; j < perAxis; ++j)
+            {
+                for (int i = 0; i < perAxis; ++i)
+                {
+                    if (!siteOverlaps(world, existing, latticeSite(i, j, k, perAxis, side_length), bodyRadius))
+                    {
+                        ++freeSites;
+                    }
+                }
+            }
+        }
+        if (freeSites >= count || perAxis >= finest)
+        {
+            break;
+        }
+        ++perAxis;
+    }
+
+    world.reserve(existing + count);
+
+    int added = 0;
+    for (int k = 0; k < perAxis && added < count; ++k)
+    {
+        for (int j = 0; j < perAxis && added < count; ++j)
+        {
+            for (int i = 0; i < perAxis && added < count; ++i)
+            {
+                const hduVector3Dd site = latticeSite(i, j, k, perAxis, side_length);
+                if (siteOverlaps(world, existing, site, bodyRadius))
+                {
+                    continue;
+                }
+
+                world.addBody(site, hduVector3Dd(0, 0, 0),
+                              bodyMass, bodyRadius, bodyDamping);
+                ++added;
+            }
+        }
+    }
+
+    if (added < count)
+    {
+        fprintf(stderr, "Only %d of %d spheres fit on the lattice without overlapping.\n", added, count);
+    }
+    return added;
+}
+
+/******************************************************************************/
@@ -0,0 +1,116 @@
+/*****************************************************************************
+
+Module Name:
+
+  bodies.h
+
+Description:
+
+  Storage for the dynamic spheres simulated by the haptic loop. Bodies are
+  kept as a structure of arrays: every attribute (position, velocity, mass,
+  radius, damping, ...) lives in its own contiguous array so a pass over one
+  attribute for all bodies walks memory linearly.
+
+*******************************************************************************/
+
+#ifndef Bodies_H_
+#define Bodies_H_
+
+#include <vector>
+
+#include <HDU/hduVector.h>
+
+struct BodyWorld
+{
+    BodyWorld() : trackStiffness(false) {}
+
+    // State of each body.
+    std::vector<double> px, py, pz;
+    std::vector<double> vx, vy, vz;
+
+    // Net force on each body, accumulated during the current tick.
+    std::vector<double> fx, fy, fz;
+
+    // Per body parameters.
+    std::vector<double> mass;
+    std::vector<double> invMass;
+    std::vector<double> radius;
+    std::vector<double> damping;
+
+    // Contact stiffness of each body, the symmetric 3x3 matrix -df/dx of the
+    // contact springs acting on it. Only filled in alongside the forces when
+    // trackStiffness is set, which the implicit integrator does.
+    bool trackStiffness;
+    std::vector<double> kxx, kyy, kzz;
+    std::vector<double> kxy, kxz, kyz;
+
+    /* Number of bodies in the world. */
+    int count() const { return (int) px.size(); }
+
+    /* Reserves storage so that adding up to capacity bodies does not
+       reallocate. Call before the servo loop starts. */
+    void reserve(int capacity);
+
+    /* Appends a body and returns its index. */
+    int addBody(const hduVector3Dd& position,
+                const hduVector3Dd& velocity,
+                double bodyMass,
+                double bodyRadius,
+                double bodyDamping);
+
+    hduVector3Dd position(int i) const { return hduVector3Dd(px[i], py[i], pz[i]); }
+    hduVector3Dd velocity(int i) const { return hduVector3Dd(vx[i], vy[i], vz[i]); }
+    hduVector3Dd force(int i) const { return hduVector3Dd(fx[i], fy[i], fz[i]); }
+
+    void addForce(int i, const hduVector3Dd& f)
+    {
+        fx[i] += f[0];
+        fy[i] += f[1];
+        fz[i] += f[2];
+    }
+
+    /* Adds a spring of stiffness k acting along the unit vector n. */
+    void addStiffness(int i, double k, const hduVector3Dd& n)
+    {
+        kxx[i] += k * n[0] * n[0];
+        kyy[i] += k * n[1] * n[1];
+        kzz[i] += k * n[2] * n[2];
+        kxy[i] += k * n[0] * n[1];
+        kxz[i] += k * n[0] * n[2];
+        kyz[i] += k * n[1] * n[2];
+    }
+
+    /* Adds independent springs along the x, y and z axes. */
+    void addAxisStiffness(int i, const hduVector3Dd& k)
+    {
+        kxx[i] += k[0];
+        kyy[i] += k[1];
+        kzz[i] += k[2];
+    }
+
+    /* Zeroes the force accumulators of all bodies, and the stiffness
+       accumulators when they are tracked. */
+    void clearForces();
+
+    /* Advances every body by dt using the accumulated forces, in a single
+       pass over the arrays. */
+    void integrate(double dt);
+
+    /* Largest body radius, or 0 when the world is empty. */
+    double maxRadius() const;
+};
+
+/* Fills the box of the given side length with count bodies placed on a
+   regular lattice, skipping lattice sites that overlap bodies already in
+   the world. The lattice is refined to fit all count bodies as long as
+   the bodies do not overlap. Returns the number of bodies added. */
+int spawnBodyLattice(BodyWorld& world,
+                     int count,
+                     double bodyMass,
+                     double bodyRadius,
+                     double bodyDamping,
+                     double side_length);
+
+#endif /* Bodies_H_ */
+
+/******************************************************************************/
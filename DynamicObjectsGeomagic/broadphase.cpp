@@ -0,0 +1,251 @@
+/*****************************************************************************
+
+Module Name:
+
+  broadphase.cpp
+
+Description:
+
+  Uniform grid spatial hash broadphase for the dynamic spheres.
+
+*******************************************************************************/
+
+#include <math.h>
+
+#include "broadphase.h"
+
+namespace
+{
+const unsigned int kUnassigned = 0xFFFFFFFF;
+}
+
+SpatialHash::SpatialHash()
+    : m_cellSize(1.0),
+      m_invCellSize(1.0),
+      m_bucketMask(0),
+      m_droppedPairs(0)
+{
+}
+
+/******************************************************************************
+ Sizes the bucket table to the next power of two of at least twice the body
+ count, which keeps the lists short without hashing every cell of the box.
+******************************************************************************/
+void SpatialHash::init(int bodyCount, double cellSize)
+{
+    m_cellSize = cellSize;
+    m_invCellSize = 1.0 / cellSize;
+
+    unsigned int bucketCount = 64;
+    while (bucketCount < 2 * (unsigned int) bodyCount)
+    {
+        bucketCount *= 2;
+    }
+    m_bucketMask = bucketCount - 1;
+    m_bucketHead.assign(bucketCount, -1);
+
+    m_cellX.assign(bodyCount, 0);
+    m_cellY.assign(bodyCount, 0);
+    m_cellZ.assign(bodyCount, 0);
+    m_bucket.assign(bodyCount, kUnassigned);
+    m_next.assign(bodyCount, -1);
+    m_prev.assign(bodyCount, -1);
+    m_droppedPairs.store(0);
+}
+
+int SpatialHash::cellCoord(double p) const
+{
+    return (int) floor(p * m_invCellSize);
+}
+
+unsigned int SpatialHash::bucketOf(int cx, int cy, int cz) const
+{
+    const unsigned int h = ((unsigned int) cx * 73856093u) ^
+                           ((unsigned int) cy * 19349663u) ^
+                           ((unsigned int) cz * 83492791u);
+    return h & m_bucketMask;
+}
+
+void SpatialHash::link(int body, unsigned int bucket)
+{
+    const int head = m_bucketHead[bucket];
+    m_next[body] = head;
+    m_prev[body] = -1;
+    if (head >= 0)
+    {
+        m_prev[head] = body;
+    }
+    m_bucketHead[bucket] = body;
+    m_bucket[body] = bucket;
+}
+
+void SpatialHash::unlink(int body)
+{
+    const int next = m_next[body];
+    const int prev = m_prev[body];
+    if (prev >= 0)
+    {
+        m_next[prev] = next;
+    }
+    else
+    {
+        m_bucketHead[m_bucket[body]] = next;
+    }
+    if (next >= 0)
+    {
+        m_prev[next] = prev;
+    }
+    m_bucket[body] = kUnassigned;
+}
+
+/******************************************************************************
+ Incremental rebuild. Only bodies that crossed a cell boundary since the last
+ tick are relinked, so a scene at rest costs one cell computation per body.
+******************************************************************************/
+void SpatialHash::update(const BodyWorld& world)
+{
+    const int n = world.count();
+    for (int i = 0; i < n; ++i)
+    {
+        const int cx = cellCoord(world.px[i]);
+        const int cy = cellCoord(world.py[i]);
+        const int cz = cellCoord(world.pz[i]);
+
+        if (m_bucket[i] != kUnassigned &&
+            cx == m_cellX[i] && cy == m_cellY[i] && cz == m_cellZ[i])
+        {
+            continue;
+        }
+
+        if (m_bucket[i] != kUnassigned)
+        {
+            unlink(i);
+        }
+        m_cellX[i] = cx;
+        m_cellY[i] = cy;
+        m_cellZ[i] = cz;
+        link(i, bucketOf(cx, cy, cz));
+    }
+}
+
+/******************************************************************************
+ Spheres that do not overlap are at least twice the smallest radius apart, so
+ a cell holds at most (cellSize / 2r + 1)^3 of them, and each body looks at
+ 14 cells in findPairs. Few bodies are bounded by the count of all pairs.
+******************************************************************************/
+size_t SpatialHash::pairBound(const BodyWorld& world) const
+{
+    const int n = world.count();
+    if (n < 2)
+    {
+        return 0;
+    }
+
+    double minRadius = world.radius[0];
+    for (int i = 1; i < n; ++i)
+    {
+        minRadius = world.radius[i] < minRadius ? world.radius[i] : minRadius;
+    }
+
+    const size_t allPairs = (size_t) n * (n - 1) / 2;
+    if (minRadius <= 0)
+    {
+        return allPairs;
+    }
+    const size_t perAxis = (size_t) floor(m_cellSize / (2 * minRadius)) + 1;
+    const size_t perBody = 14 * perAxis * perAxis * perAxis - 1;
+    const size_t bound = (size_t) n * perBody;
+    return bound < allPairs ? bound : allPairs;
+}
+
+/******************************************************************************
+ Every body looks at its own cell and the 13 neighbours that come after it in
+ (z, y, x) order; the other 13 are covered when those neighbours look back.
+ Bodies hashed into the same bucket from a different cell are filtered out by
+ comparing cell coordinates, and within a cell only partners with a higher
+ index are kept, so each pair appears once.
+******************************************************************************/
+void SpatialHash::findPairs(std::vector<BodyPair>& pairs)
+{
+    static const int kForward[14][3] = {
+        { 0, 0, 0 },
+        { 1, 0, 0 },
+        { -1, 1, 0 }, { 0, 1, 0 }, { 1, 1, 0 },
+        { -1, -1, 1 }, { 0, -1, 1 }, { 1, -1, 1 },
+        { -1, 0, 1 }, { 0, 0, 1 }, { 1, 0, 1 },
+        { -1, 1, 1 }, { 0, 1, 1 }, { 1, 1, 1 }
+    };
+
+    pairs.clear();
+    unsigned long dropped = 0;
+
+    const int n = (int) m_bucket.size();
+    for (int i = 0; i < n; ++i)
+    {
+        if (m_bucket[i] == kUnassigned)
+        {
+            continue;
+        }
+
+        for (int d = 0; d < 14; ++d)
+        {
+            const int cx = m_cellX[i] + kForward[d][0];
+            const int cy = m_cellY[i] + kForward[d][1];
+            const int cz = m_cellZ[i] + kForward[d][2];
+
+            for (int j = m_bucketHead[bucketOf(cx, cy, cz)]; j >= 0; j = m_next[j])
+            {
+                if ((d == 0 && j <= i) ||
+                    m_cellX[j] != cx || m_cellY[j] != cy || m_cellZ[j] != cz)
+                {
+                    continue;
+                }
+                if (pairs.size() == pairs.capacity())
+                {
+                    ++dropped;
+                    continue;
+                }
+                BodyPair pair = { i < j ? i : j, i < j ? j : i };
+                pairs.push_back(pair);
+            }
+        }
+    }
+
+    if (dropped > 0)
+    {
+        m_droppedPairs.fetch_add(dropped, std::memory_order_relaxed);
+    }
+}
+
+/******************************************************************************
+ Collects the bodies in every cell overlapped by the cube of half size radius
+ around center.
+******************************************************************************/
+void SpatialHash::query(const hduVector3Dd& center, double radius,
+                        std::vector<int>& bodies) const
+{
+    bodies.clear();
+
+    const int x0 = cellCoord(center[0] - radius), x1 = cellCoord(center[0] + radius);
+    const int y0 = cellCoord(center[1] - radius), y1 = cellCoord(center[1] + radius);
+    const int z0 = cellCoord(center[2] - radius), z1 = cellCoord(center[2] + radius);
+
+    for (int cz = z0; cz <= z1; ++cz)
+    {
+        for (int cy = y0; cy <= y1; ++cy)
+        {
+            for (int cx = x0; cx <= x1; ++cx)
+            {
+                for (int j = m_bucketHead[bucketOf(cx, cy, cz)]; j >= 0; j = m_next[j])
+                {
+                    if (m_cellX[j] == cx && m_cellY[j] == cy && m_cellZ[j] == cz)
+                    {
+                        bodies.push_back(j);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/******************************************************************************/
@@ -0,0 +1,89 @@
+/*****************************************************************************
+
+Module Name:
+
+  broadphase.h
+
+Description:
+
+  Uniform grid spatial hash used to find candidate contacts between the
+  dynamic spheres, and between the HIP and the spheres, without testing
+  every pair. Bodies are threaded through intrusive linked lists hanging off
+  the hash buckets, so moving a body between cells is O(1) and the servo
+  loop never allocates.
+
+*******************************************************************************/
+
+#ifndef Broadphase_H_
+#define Broadphase_H_
+
+#include <atomic>
+#include <vector>
+
+#include <HDU/hduVector.h>
+
+#include "bodies.h"
+
+/* A candidate contact between bodies a and b, with a < b. */
+struct BodyPair
+{
+    int a;
+    int b;
+};
+
+class SpatialHash
+{
+public:
+    SpatialHash();
+
+    /* Sizes the grid for bodyCount bodies. cellSize must be at least twice
+       the largest body radius so that touching bodies are always in the same
+       or neighbouring cells. */
+    void init(int bodyCount, double cellSize);
+
+    /* Moves bodies whose cell has changed since the last update. Bodies that
+       stay inside their cell are not touched. */
+    void update(const BodyWorld& world);
+
+    /* Most pairs findPairs can report for the bodies of world while they do
+       not overlap. Reserve this much before the servo loop starts. */
+    size_t pairBound(const BodyWorld& world) const;
+
+    /* Replaces pairs with every pair of bodies in the same or neighbouring
+       cells. Each unordered pair is reported once. Pairs past the capacity
+       of the vector are dropped and counted rather than reallocating. */
+    void findPairs(std::vector<BodyPair>& pairs);
+
+    unsigned long droppedPairs() const { return m_droppedPairs.load(); }
+
+    /* Replaces bodies with every body whose center may lie within radius
+       of center. The result is a superset; callers still test distances. */
+    void query(const hduVector3Dd& center, double radius,
+               std::vector<int>& bodies) const;
+
+    double cellSize() const { return m_cellSize; }
+
+private:
+    int cellCoord(double p) const;
+    unsigned int bucketOf(int cx, int cy, int cz) const;
+    void link(int body, unsigned int bucket);
+    void unlink(int body);
+
+    double m_cellSize;
+    double m_invCellSize;
+    unsigned int m_bucketMask;
+
+    // Head of the body list in each bucket, -1 when empty.
+    std::vector<int> m_bucketHead;
+
+    // Per body cell coordinates, bucket, and list links.
+    std::vector<int> m_cellX, m_cellY, m_cellZ;
+    std::vector<unsigned int> m_bucket;
+    std::vector<int> m_next, m_prev;
+
+    std::atomic<unsigned long> m_droppedPairs;
+};
+
+#endif /* Broadphase_H_ */
+
+/******************************************************************************/
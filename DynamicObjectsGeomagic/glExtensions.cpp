@@ -0,0 +1,130 @@
+/*****************************************************************************
+
+Module Name:
+
+  glExtensions.cpp
+
+Description:
+
+  Entry points past OpenGL 1.1, looked up at run time.
+
+*******************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "glExtensions.h"
+
+#if defined(linux)
+# include <GL/glx.h>
+#endif
+
+namespace
+{
+
+void* getProc(const char* name)
+{
+#if defined(WIN32)
+    return (void*) wglGetProcAddress(name);
+#elif defined(linux)
+    return (void*) glXGetProcAddressARB((const GLubyte*) name);
+#else
+    (void) name;
+    return NULL;
+#endif
+}
+
+/* GL_VERSION as major * 10 + minor. */
+int glVersion()
+{
+    const char* version = (const char*) glGetString(GL_VERSION);
+    int major = 0;
+    int minor = 0;
+    if (version == NULL || sscanf(version, "%d.%d", &major, &minor) != 2)
+    {
+        return 0;
+    }
+    return major * 10 + minor;
+}
+
+bool hasExtension(const char* name)
+{
+    const char* extensions = (const char*) glGetString(GL_EXTENSIONS);
+    const size_t length = strlen(name);
+    for (const char* p = extensions; p != NULL && (p = strstr(p, name)) != NULL; p += length)
+    {
+        if ((p == extensions || p[-1] == ' ') && (p[length] == ' ' || p[length] == '\0'))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* glXGetProcAddress answers for any name, so the version and extensions
+   decide what may be used. */
+void load(GLExtensions& gl)
+{
+    const int version = glVersion();
+
+    gl.buffers = version >= 15;
+    if (gl.buffers)
+    {
+        gl.genBuffers = (GenBuffersProc) getProc("glGenBuffers");
+        gl.bindBuffer = (BindBufferProc) getProc("glBindBuffer");
+        gl.bufferData = (BufferDataProc) getProc("glBufferData");
+        gl.buffers = gl.genBuffers && gl.bindBuffer && gl.bufferData;
+    }
+
+    gl.instancing = gl.buffers && version >= 20;
+    if (gl.instancing)
+    {
+        gl.createShader = (CreateShaderProc) getProc("glCreateShader");
+        gl.shaderSource = (ShaderSourceProc) getProc("glShaderSource");
+        gl.compileShader = (CompileShaderProc) getProc("glCompileShader");
+        gl.getShaderiv = (GetShaderivProc) getProc("glGetShaderiv");
+        gl.createProgram = (CreateProgramProc) getProc("glCreateProgram");
+        gl.attachShader = (AttachShaderProc) getProc("glAttachShader");
+        gl.linkProgram = (LinkProgramProc) getProc("glLinkProgram");
+        gl.getProgramiv = (GetProgramivProc) getProc("glGetProgramiv");
+        gl.useProgram = (UseProgramProc) getProc("glUseProgram");
+        gl.getAttribLocation = (GetAttribLocationProc) getProc("glGetAttribLocation");
+        gl.enableVertexAttribArray = (EnableVertexAttribArrayProc) getProc("glEnableVertexAttribArray");
+        gl.disableVertexAttribArray = (DisableVertexAttribArrayProc) getProc("glDisableVertexAttribArray");
+        gl.vertexAttribPointer = (VertexAttribPointerProc) getProc("glVertexAttribPointer");
+        if (version >= 33)
+        {
+            gl.vertexAttribDivisor = (VertexAttribDivisorProc) getProc("glVertexAttribDivisor");
+            gl.drawElementsInstanced = (DrawElementsInstancedProc) getProc("glDrawElementsInstanced");
+        }
+        else if (hasExtension("GL_ARB_instanced_arrays") && hasExtension("GL_ARB_draw_instanced"))
+        {
+            gl.vertexAttribDivisor = (VertexAttribDivisorProc) getProc("glVertexAttribDivisorARB");
+            gl.drawElementsInstanced = (DrawElementsInstancedProc) getProc("glDrawElementsInstancedARB");
+        }
+        gl.instancing = gl.createShader && gl.shaderSource && gl.compileShader && gl.getShaderiv && gl.createProgram &&
+                        gl.attachShader && gl.linkProgram && gl.getProgramiv && gl.useProgram && gl.getAttribLocation &&
+                        gl.enableVertexAttribArray && gl.disableVertexAttribArray && gl.vertexAttribPointer &&
+                        gl.vertexAttribDivisor && gl.drawElementsInstanced;
+    }
+}
+
+} // namespace
+
+/******************************************************************************
+ The entry points, looked up on the first call.
+******************************************************************************/
+const GLExtensions& glExtensions()
+{
+    static GLExtensions gl;
+    static bool loaded = false;
+    if (!loaded)
+    {
+        memset(&gl, 0, sizeof(gl));
+        load(gl);
+        loaded = true;
+    }
+    return gl;
+}
+
+/******************************************************************************/
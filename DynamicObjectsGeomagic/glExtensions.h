@@ -0,0 +1,103 @@
+/*****************************************************************************
+
+Module Name:
+
+  glExtensions.h
+
+Description:
+
+  Entry points past OpenGL 1.1, which the Windows and Linux GL libraries do
+  not export directly, looked up at run time once there is a context.
+
+*******************************************************************************/
+
+#ifndef GLExtensions_H_
+#define GLExtensions_H_
+
+#include <stddef.h>
+
+#if defined(WIN32)
+# include <windows.h>
+#endif
+#if defined(WIN32) || defined(linux)
+# include <GL/gl.h>
+#elif defined(__APPLE__)
+# include <OpenGL/gl.h>
+#endif
+
+#ifndef APIENTRY
+# define APIENTRY
+#endif
+
+#ifndef GL_ARRAY_BUFFER
+# define GL_ARRAY_BUFFER 0x8892
+# define GL_ELEMENT_ARRAY_BUFFER 0x8893
+# define GL_STATIC_DRAW 0x88E4
+# define GL_STREAM_DRAW 0x88E0
+#endif
+#ifndef GL_VERTEX_SHADER
+# define GL_FRAGMENT_SHADER 0x8B30
+# define GL_VERTEX_SHADER 0x8B31
+# define GL_COMPILE_STATUS 0x8B81
+# define GL_LINK_STATUS 0x8B82
+#endif
+
+typedef void (APIENTRY *GenBuffersProc)(GLsizei n, GLuint* buffers);
+typedef void (APIENTRY *BindBufferProc)(GLenum target, GLuint buffer);
+typedef void (APIENTRY *BufferDataProc)(GLenum target, ptrdiff_t size, const void* data, GLenum usage);
+typedef GLuint (APIENTRY *CreateShaderProc)(GLenum type);
+typedef void (APIENTRY *ShaderSourceProc)(GLuint shader, GLsizei count, const char* const* strings, const GLint* lengths);
+typedef void (APIENTRY *CompileShaderProc)(GLuint shader);
+typedef void (APIENTRY *GetShaderivProc)(GLuint shader, GLenum name, GLint* value);
+typedef GLuint (APIENTRY *CreateProgramProc)();
+typedef void (APIENTRY *AttachShaderProc)(GLuint program, GLuint shader);
+typedef void (APIENTRY *LinkProgramProc)(GLuint program);
+typedef void (APIENTRY *GetProgramivProc)(GLuint program, GLenum name, GLint* value);
+typedef void (APIENTRY *UseProgramProc)(GLuint program);
+typedef GLint (APIENTRY *GetAttribLocationProc)(GLuint program, const char* name);
+typedef void (APIENTRY *EnableVertexAttribArrayProc)(GLuint index);
+typedef void (APIENTRY *DisableVertexAttribArrayProc)(GLuint index);
+typedef void (APIENTRY *VertexAttribPointerProc)(GLuint index, GLint size, GLenum type, GLboolean normalized,
+                                                GLsizei stride, const void* pointer);
+typedef void (APIENTRY *VertexAttribDivisorProc)(GLuint index, GLuint divisor);
+typedef void (APIENTRY *DrawElementsInstancedProc)(GLenum mode, GLsizei count, GLenum type, const void* indices,
+                                                  GLsizei instances);
+
+struct GLExtensions
+{
+    bool buffers;    // buffer objects (OpenGL 1.5)
+    bool instancing; // shaders (OpenGL 2.0) and instanced arrays (OpenGL 3.3 or ARB_instanced_arrays)
+
+    GenBuffersProc genBuffers;
+    BindBufferProc bindBuffer;
+    BufferDataProc bufferData;
+    CreateShaderProc createShader;
+    ShaderSourceProc shaderSource;
+    CompileShaderProc compileShader;
+    GetShaderivProc getShaderiv;
+    CreateProgramProc createProgram;
+    AttachShaderProc attachShader;
+    LinkProgramProc linkProgram;
+    GetProgramivProc getProgramiv;
+    UseProgramProc useProgram;
+    GetAttribLocationProc getAttribLocation;
+    EnableVertexAttribArrayProc enableVertexAttribArray;
+    DisableVertexAttribArrayProc disableVertexAttribArray;
+    VertexAttribPointerProc vertexAttribPointer;
+    VertexAttribDivisorProc vertexAttribDivisor;
+    DrawElementsInstancedProc drawElementsInstanced;
+};
+
+/* The entry points, looked up on the first call, which needs a current GL
+   context. Only those of the features found are set. */
+const GLExtensions& glExtensions();
+
+/* Offset into the bound buffer object, as GL takes it in place of a pointer. */
+inline const void* bufferOffset(size_t bytes)
+{
+    return (const void*) bytes;
+}
+
+#endif /* GLExtensions_H_ */
+
+/******************************************************************************/
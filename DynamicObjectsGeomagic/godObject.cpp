@@ -0,0 +1,266 @@
+/*****************************************************************************
+
+Module Name:
+
+  godObject.cpp
+
+Description:
+
+  God-object proxy for triangle meshes.
+
+*******************************************************************************/
+
+#include <math.h>
+
+#include "godObject.h"
+
+namespace
+{
+
+// Gap (mm) the proxy keeps from the triangles it touches; a triangle closer
+// than the radius plus this counts as touching.
+const double kProxySkin = 0.01;
+
+// Move and slide passes per tick. Each pass either reaches its goal or
+// stops at one more triangle, so this bounds how many new contacts the
+// proxy picks up in a tick.
+const int kMaxProxyPasses = 4;
+
+
+// Constraint planes tried together when solving for the goal: at most three
+// are ever active at one point, among the few the goal violates most.
+const int kMaxSolvePlanes = 4;
+
+// Constraint planes closer than this in direction are merged.
+const double kParallelCos = 0.9999;
+
+bool projectOntoPlanes(const hduVector3Dd& goal, const ProxyConstraint* planes[], int count, hduVector3Dd& x)
+{
+    if (count == 1)
+    {
+        x = goal + planes[0]->normal * (planes[0]->offset - dotProduct(planes[0]->normal, goal));
+        return true;
+    }
+    if (count == 2)
+    {
+        const hduVector3Dd& n1 = planes[0]->normal;
+        const hduVector3Dd& n2 = planes[1]->normal;
+        const double c = dotProduct(n1, n2);
+        const double det = 1 - c * c;
+        if (det < 1e-9)
+        {
+            return false;
+        }
+        const double r1 = planes[0]->offset - dotProduct(n1, goal);
+        const double r2 = planes[1]->offset - dotProduct(n2, goal);
+        x = goal + n1 * ((r1 - c * r2) / det) + n2 * ((r2 - c * r1) / det);
+        return true;
+    }
+
+    const hduVector3Dd& n1 = planes[0]->normal;
+    const hduVector3Dd& n2 = planes[1]->normal;
+    const hduVector3Dd& n3 = planes[2]->normal;
+    const hduVector3Dd n23 = crossProduct(n2, n3);
+    const double det = dotProduct(n1, n23);
+    if (fabs(det) < 1e-9)
+    {
+        return false;
+    }
+    x = (n23 * planes[0]->offset +
+         crossProduct(n3, n1) * planes[1]->offset +
+         crossProduct(n1, n2) * planes[2]->offset) / det;
+    return true;
+}
+
+} // namespace
+
+MeshProxy::MeshProxy()
+    : m_mesh(0),
+      m_radius(0),
+      m_started(false),
+      m_contactCount(0),
+      m_constraintCount(0),
+      m_activeCount(0)
+{
+}
+
+void MeshProxy::init(const TriangleMesh* mesh, double radius)
+{
+    m_mesh = mesh;
+    m_radius = radius;
+    m_started = false;
+    m_contactCount = 0;
+    m_constraintCount = 0;
+    m_activeCount = 0;
+}
+
+/******************************************************************************
+ Collects the triangles touching the proxy and turns each into the plane
+ through its nearest point, facing the proxy center. Such a plane supports
+ the triangle grown by the radius, so a proxy that stays on its positive
+ side cannot enter that triangle, whether it touches a face, an edge or a
+ vertex. The planes the goal is behind are moved to the front.
+******************************************************************************/
+void MeshProxy::findContacts(const hduVector3Dd& goal)
+{
+    m_contactCount = m_mesh->near(m_position, m_radius + kProxySkin, m_hits, kMaxProxyContacts);
+    m_constraintCount = 0;
+    for (int i = 0; i < m_contactCount; ++i)
+    {
+        const MeshHit& hit = m_hits[i];
+        m_touching[i] = hit.triangle;
+
+        hduVector3Dd normal = m_position - hit.point;
+        if (hit.distance > 1e-9)
+        {
+            normal /= hit.distance;
+        }
+        else
+        {
+            normal = m_mesh->triangle(hit.triangle).normal;
+        }
+        const double offset = dotProduct(normal, hit.point) + m_radius;
+
+        int j = 0;
+        while (j < m_constraintCount && dotProduct(m_constraints[j].normal, normal) < kParallelCos)
+        {
+            ++j;
+        }
+        if (j < m_constraintCount)
+        {
+            if (offset > m_constraints[j].offset)
+            {
+                m_constraints[j].offset = offset;
+            }
+            continue;
+        }
+        m_constraints[m_constraintCount].normal = normal;
+        m_constraints[m_constraintCount].offset = offset;
+        ++m_constraintCount;
+    }
+
+    // Selection sort on how far the goal is behind each plane; the planes it is in front of are left at the end.
+    double violation[kMaxProxyContacts];
+    for (int i = 0; i < m_constraintCount; ++i)
+    {
+        violation[i] = m_constraints[i].offset - dotProduct(m_constraints[i].normal, goal);
+    }
+    for (m_activeCount = 0; m_activeCount < m_constraintCount; ++m_activeCount)
+    {
+        int worst = m_activeCount;
+        for (int i = m_activeCount + 1; i < m_constraintCount; ++i)
+        {
+            if (violation[i] > violation[worst])
+            {
+                worst = i;
+            }
+        }
+        if (violation[worst] <= 0)
+        {
+            break;
+        }
+        const ProxyConstraint c = m_constraints[worst];
+        m_constraints[worst] = m_constraints[m_activeCount];
+        m_constraints[m_activeCount] = c;
+        violation[worst] = violation[m_activeCount];
+    }
+}
+
+/******************************************************************************
+ Point nearest to goal on the positive side of every constraint plane. The
+ answer lies on some set of at most three of the planes the goal violates,
+ so it is found by projecting the goal onto each such set and keeping the
+ nearest projection that satisfies all the planes. If none does, the proxy
+ stays where it is.
+******************************************************************************/
+hduVector3Dd MeshProxy::solve(const hduVector3Dd& goal) const
+{
+    if (m_activeCount == 0)
+    {
+        return goal;
+    }
+
+    const int n = m_activeCount < kMaxSolvePlanes ? m_activeCount : kMaxSolvePlanes;
+    hduVector3Dd best = m_position;
+    double bestDistance2 = -1;
+    for (int mask = 1; mask < (1 << n); ++mask)
+    {
+        const ProxyConstraint* planes[3];
+        int count = 0;
+        for (int i = 0; i < n && count <= 3; ++i)
+        {
+            if (mask & (1 << i))
+            {
+                if (count < 3)
+                {
+                    planes[count] = &m_constraints[i];
+                }
+                ++count;
+            }
+        }
+        hduVector3Dd x;
+        if (count > 3 || !projectOntoPlanes(goal, planes, count, x))
+        {
+            continue;
+        }
+
+        bool feasible = true;
+        for (int i = 0; i < m_constraintCount && feasible; ++i)
+        {
+            feasible = dotProduct(m_constraints[i].normal, x) >= m_constraints[i].offset - 1e-9;
+        }
+        const hduVector3Dd d = x - goal;
+        const double distance2 = dotProduct(d, d);
+        if (feasible && (bestDistance2 < 0 || distance2 < bestDistance2))
+        {
+            best = x;
+            bestDistance2 = distance2;
+        }
+    }
+    return best;
+}
+
+/******************************************************************************
+ Move and slide. Each pass solves for the goal against the triangles the
+ proxy touches, then sweeps the proxy towards it against all the other
+ triangles, so it cannot tunnel through the mesh however fast the HIP
+ moves. A pass that runs into a new triangle hands over to the next pass,
+ which adds its plane and slides on.
+******************************************************************************/
+const hduVector3Dd& MeshProxy::update(const hduVector3Dd& hipPosition)
+{
+    if (!m_started)
+    {
+        m_position = hipPosition;
+        m_started = true;
+    }
+
+    for (int pass = 0; pass < kMaxProxyPasses; ++pass)
+    {
+        findContacts(hipPosition);
+        const hduVector3Dd target = solve(hipPosition);
+        const hduVector3Dd direction = target - m_position;
+        const double length = direction.magnitude();
+        if (length < 1e-9)
+        {
+            break;
+        }
+
+        const hduVector3Dd unit = direction / length;
+        const double travel = m_mesh->sweep(m_position, unit, length, m_radius, m_touching, m_contactCount);
+        if (travel >= length)
+        {
+            m_position = target;
+            break;
+        }
+        // Stopping half the skin short of the triangle hit leaves it touching, for the next pass.
+        if (travel > kProxySkin / 2)
+        {
+            m_position += unit * (travel - kProxySkin / 2);
+        }
+    }
+
+    return m_position;
+}
+
+/******************************************************************************/
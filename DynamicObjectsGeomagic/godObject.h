@@ -0,0 +1,83 @@
+/*****************************************************************************
+
+Module Name:
+
+  godObject.h
+
+Description:
+
+  God-object (constraint proxy) rendering of a triangle mesh for the HIP
+  sphere. The proxy is a sphere of the HIP's radius that follows the HIP
+  but never passes through the mesh: each tick it moves to the point
+  nearest the HIP that keeps it on the outer side of every triangle it is
+  touching, sliding along them, and stops at the first new triangle it
+  meets on the way. The force is a spring from the HIP to the proxy, so
+  thin features and sharp edges are felt without the pop-through of
+  penalty forces.
+
+*******************************************************************************/
+
+#ifndef GodObject_H_
+#define GodObject_H_
+
+#include <HDU/hduVector.h>
+
+#include "mesh.h"
+
+/* Plane the proxy center must stay on the positive side of:
+   normal . x >= offset. */
+struct ProxyConstraint
+{
+    hduVector3Dd normal;
+    double offset;
+};
+
+// Triangles the proxy can touch at once, e.g. around a vertex of a fine mesh.
+const int kMaxProxyContacts = 16;
+
+class MeshProxy
+{
+public:
+    MeshProxy();
+
+    /* Renders mesh for a HIP sphere of the given radius. The proxy starts at
+       the HIP on the first update. */
+    void init(const TriangleMesh* mesh, double radius);
+
+    /* Servo loop side: moves the proxy towards the HIP at hipPosition as
+       far as the mesh lets it and returns its new position. */
+    const hduVector3Dd& update(const hduVector3Dd& hipPosition);
+
+    /* Spring force from the HIP to the proxy. */
+    hduVector3Dd force(const hduVector3Dd& hipPosition, double k) const
+    {
+        return (m_position - hipPosition) * k;
+    }
+
+    const hduVector3Dd& position() const { return m_position; }
+
+    /* Triangles the proxy was sliding on in the last update. */
+    int contactCount() const { return m_contactCount; }
+
+private:
+    void findContacts(const hduVector3Dd& goal);
+    hduVector3Dd solve(const hduVector3Dd& goal) const;
+
+    const TriangleMesh* m_mesh;
+    double m_radius;
+    bool m_started;
+    hduVector3Dd m_position;
+
+    // Triangles touching the proxy at its current position, and the planes they constrain it to (nearly
+    // parallel planes merged); the first m_activeCount planes are the ones the goal violates, worst first.
+    int m_contactCount;
+    int m_constraintCount;
+    int m_activeCount;
+    MeshHit m_hits[kMaxProxyContacts];
+    int m_touching[kMaxProxyContacts];
+    ProxyConstraint m_constraints[kMaxProxyContacts];
+};
+
+#endif /* GodObject_H_ */
+
+/******************************************************************************/
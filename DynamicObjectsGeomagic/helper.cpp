@@ -24,6 +24,8 @@ Description:
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <vector>
 
 #if defined(WIN32) || defined(linux)
 # include <GL/glut.h>
@@ -33,9 +35,27 @@ Description:
 
 #include <HDU/hduMatrix.h>
 
+#include "helper.h"
+#include "mesh.h"
+#include "staticGeometry.h"
+
 extern void displayFunction(void);
 extern void handleIdle(void);
 
+// Last state set through setCapability and setColor, so that setting it
+// again costs no GL call.
+static const int kMaxCapabilities = 16;
+static GLenum known_capability[kMaxCapabilities];
+static bool capability_enabled[kMaxCapabilities];
+static int known_capabilities = 0;
+static float current_color[4];
+static bool current_color_known = false;
+
+// The unit wall drawWall scales, and the walls of the last box drawBox drew.
+static StaticGeometry wall_geometry;
+static StaticGeometry box_geometry;
+static double box_wall_length = 0;
+
 /******************************************************************************
  Initializes GLUT.
 ******************************************************************************/
@@ -94,22 +114,24 @@ void initGraphics(const hduVector3Dd &LLB, const hduVector3Dd &TRF)
 	  		  0.0,  0.0, -1.0,
 			  0.0f, 1.0f, 0.0f);
 
-	glDisable(GL_DEPTH_TEST);
+	// The lights are fixed in eye space, so they are set up once with the camera.
+	setupGraphicsState();
 }
 
 
 /******************************************************************************    
- Sets up graphics pipeline, lights etc.
+ Sets up graphics pipeline, lights etc. Called once, after the camera is
+ placed.
 ******************************************************************************/
 void setupGraphicsState()
 {
     glShadeModel(GL_SMOOTH);
 
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_LIGHTING);
-    glEnable(GL_NORMALIZE);
+    setCapability(GL_DEPTH_TEST, true);
+    setCapability(GL_LIGHTING, true);
+    setCapability(GL_NORMALIZE, true);
+    setCapability(GL_COLOR_MATERIAL, true);
     glEnable(GL_LIGHT_MODEL_TWO_SIDE);
-    glShadeModel(GL_SMOOTH);
     
     GLfloat lightZeroPosition[] = { 10.0, 4.0, 100.0, 0.0 };
     GLfloat lightZeroColor[] = { 0.6, 0.6, 0.6, 1.0 }; // green-tinted.
@@ -125,8 +147,56 @@ void setupGraphicsState()
     glLightfv(GL_LIGHT0, GL_DIFFUSE, lightZeroColor);
     glLightfv(GL_LIGHT1, GL_POSITION, lightOnePosition);
     glLightfv(GL_LIGHT1, GL_DIFFUSE, lightOneColor);
-    glEnable(GL_LIGHT0);
-    glEnable(GL_LIGHT1);
+    setCapability(GL_LIGHT0, true);
+    setCapability(GL_LIGHT1, true);
+}
+
+/******************************************************************************
+ Enables or disables a capability, unless it is already so.
+******************************************************************************/
+void setCapability(GLenum capability, bool enabled)
+{
+    int i = 0;
+    while (i < known_capabilities && known_capability[i] != capability)
+    {
+        ++i;
+    }
+    if (i < known_capabilities && capability_enabled[i] == enabled)
+    {
+        return;
+    }
+
+    if (enabled)
+    {
+        glEnable(capability);
+    }
+    else
+    {
+        glDisable(capability);
+    }
+
+    if (i == known_capabilities && known_capabilities < kMaxCapabilities)
+    {
+        known_capability[known_capabilities++] = capability;
+    }
+    if (i < known_capabilities)
+    {
+        capability_enabled[i] = enabled;
+    }
+}
+
+/******************************************************************************
+ Sets the current color, unless it is already that color.
+******************************************************************************/
+void setColor(const float color[4])
+{
+    if (current_color_known && memcmp(current_color, color, sizeof(current_color)) == 0)
+    {
+        return;
+    }
+    glColor4fv(color);
+    memcpy(current_color, color, sizeof(current_color));
+    current_color_known = true;
 }
 
 /******************************************************************************
@@ -134,16 +204,16 @@ void setupGraphicsState()
 ******************************************************************************/
 void drawAxes(double axisLength)
 {
-    glDisable(GL_LIGHTING);
-    glEnable(GL_COLOR_MATERIAL);
+    setCapability(GL_LIGHTING, false);
+    setCapability(GL_COLOR_MATERIAL, true);
     glLineWidth(2.0);
     
     glBegin(GL_LINES);
     for (int i = 0; i < 3; i++) 
     {
-        float color[3] = { 0, 0, 0 };
+        float color[4] = { 0, 0, 0, 1 };
         color[i] = 1.0;
-        glColor3fv(color);
+        setColor(color);
         
         float vertex[3] = {0, 0, 0};
         vertex[i] = axisLength;
@@ -163,8 +233,8 @@ void drawSphere(GLUquadricObj* pQuadObj,
 {
     glMatrixMode(GL_MODELVIEW); 
     glPushMatrix();
-    glEnable(GL_LIGHTING);
-    glColor4fv(color);
+    setCapability(GL_LIGHTING, true);
+    setColor(color);
     glTranslatef(position[0], position[1], position[2]);
     gluSphere(pQuadObj, sphereRadius, 20, 20); 
     glPopMatrix();
@@ -178,7 +248,7 @@ void drawForceVector(GLUquadricObj* pQuadObj,
                      const hduVector3Dd &forceVector,
                      double arrowThickness)
 {
-    glDisable(GL_LIGHTING);
+    setCapability(GL_LIGHTING, false);
     
     glPushMatrix();
 
@@ -199,14 +269,16 @@ void drawForceVector(GLUquadricObj* pQuadObj,
     glMultMatrixd((double*) rotVals);
 
     // The force arrow: composed of a cylinder and a cone.
-    glColor3f( 0.2, 0.7, 0.2 );
+    static const float shaftColor[4] = { 0.2f, 0.7f, 0.2f, 1.0f };
+    setColor(shaftColor);
     
     double strength = forceVector.magnitude();
     
     // Draw arrow shaft.
     gluCylinder(pQuadObj,arrowThickness, arrowThickness, strength, 16, 2); 
     glTranslatef(0, 0, strength);
-    glColor3f(0.2, 0.8, 0.3);
+    static const float headColor[4] = { 0.2f, 0.8f, 0.3f, 1.0f };
+    setColor(headColor);
     
     // Draw arrow head.
     gluCylinder(pQuadObj, arrowThickness*2, 0.0, strength*.15, 16, 2); 
@@ -214,6 +286,44 @@ void drawForceVector(GLUquadricObj* pQuadObj,
     glPopMatrix();
 }
 
+/******************************************************************************
+ Rotates v the way drawWall turns its wall, from facing z to facing normal.
+******************************************************************************/
+static hduVector3Dd rotateToNormal(const hduVector3Dd &v, const hduVector3Dd &normal)
+{
+	// the axis is the cross product of the z axis and the normal, the angle comes from their dot product
+	hduVector3Dd axis(-normal[1], normal[0], 0);
+	if (axis.magnitude() == 0) return v;
+	axis.normalize();
+	const double angle = acos(normal[2]);
+	return v*cos(angle) + crossProduct(axis, v)*sin(angle) + axis*(dotProduct(axis, v)*(1 - cos(angle)));
+}
+
+/******************************************************************************
+ Appends a square wall as two triangles: x y z and the normal per vertex.
+******************************************************************************/
+static void appendWall(std::vector<float> &vertices,
+                       const hduVector3Dd &centerPosition,
+                       const hduVector3Dd &normal,
+                       double wallLength)
+{
+	const double h = wallLength/2.0;
+	const hduVector3Dd corners[4] = {
+		hduVector3Dd( h, -h, 0),
+		hduVector3Dd( h,  h, 0),
+		hduVector3Dd(-h,  h, 0),
+		hduVector3Dd(-h, -h, 0)
+	};
+	const int order[6] = { 0, 1, 2, 0, 2, 3 };
+	const hduVector3Dd n = rotateToNormal(hduVector3Dd(0, 0, 1), normal);
+	for (int i = 0; i < 6; i++)
+	{
+		const hduVector3Dd p = rotateToNormal(corners[order[i]], normal) + centerPosition;
+		for (int k = 0; k < 3; k++) vertices.push_back((float) p[k]);
+		for (int k = 0; k < 3; k++) vertices.push_back((float) n[k]);
+	}
+}
+
 /******************************************************************************
  Draws a wall
 ******************************************************************************/
@@ -222,9 +332,18 @@ void drawWall(const hduVector3Dd &centerPosition,
 				double wallLength,
                 const float color[4])
 {
+	// a unit wall facing z, uploaded once, moved into place by the modelview
+	if (wall_geometry.empty())
+	{
+		std::vector<float> vertices;
+		appendWall(vertices, hduVector3Dd(0, 0, 0), hduVector3Dd(0, 0, 1), 1.0);
+		wall_geometry.set(vertices);
+	}
+
     glMatrixMode(GL_MODELVIEW); 
     glPushMatrix();
-    glEnable(GL_LIGHTING);
+    setCapability(GL_LIGHTING, true);
+    setColor(color);
 
 	// translate wall
     glTranslatef(centerPosition[0], centerPosition[1], centerPosition[2]);
@@ -244,46 +363,74 @@ void drawWall(const hduVector3Dd &centerPosition,
 	// only rotate if the cross product is not zero
 	if (!((x == 0) && (y == 0) && (z == 0))) glRotatef(angle, x, y, z);
 
-	glBegin( GL_QUADS );
-	    glColor4fv(color);
-		glVertex3f( wallLength/2.0, -wallLength/2.0, 0);
-		glVertex3f( wallLength/2.0,  wallLength/2.0, 0);
-		glVertex3f(-wallLength/2.0,  wallLength/2.0, 0);
-		glVertex3f(-wallLength/2.0, -wallLength/2.0, 0);
-	glEnd();
+	glScalef(wallLength, wallLength, 1);
+	wall_geometry.draw();
     glPopMatrix();
 }
 
 
 /******************************************************************************
- Draws a box
+ Draws a box. The walls are uploaded once and drawn with a single call
+ until the wall length changes.
 ******************************************************************************/
 void drawBox(double wallLength, const float color[4])
 {
-	// right wall
-	const hduVector3Dd wallPosition1(wallLength/2, 0, 0);
-	const hduVector3Dd normal1(1, 0, 0);
-	drawWall(wallPosition1, normal1, wallLength, color);
-
-	// left wall
-	const hduVector3Dd wallPosition2(-wallLength/2, 0, 0);
-	const hduVector3Dd normal2(1, 0, 0);
-	drawWall(wallPosition2, normal2, wallLength, color);
-
-	// top wall
-	const hduVector3Dd wallPosition3(0, wallLength/2, 0);
-	const hduVector3Dd normal3(0, 1, 0);
-	drawWall(wallPosition3, normal3, wallLength, color);
-
-	// bottom wall
-	const hduVector3Dd wallPosition4(0, -wallLength/2, 0);
-	const hduVector3Dd normal4(0, 1, 0);
-	drawWall(wallPosition4, normal4, wallLength, color);
-
-	// back wall
-	const hduVector3Dd wallPosition5(0, 0, -wallLength/2);
-	const hduVector3Dd normal5(0, 0, 1);
-	drawWall(wallPosition5, normal5, wallLength, color);
+	if (box_geometry.empty() || wallLength != box_wall_length)
+	{
+		std::vector<float> vertices;
+
+		// right wall
+		appendWall(vertices, hduVector3Dd(wallLength/2, 0, 0), hduVector3Dd(1, 0, 0), wallLength);
+
+		// left wall
+		appendWall(vertices, hduVector3Dd(-wallLength/2, 0, 0), hduVector3Dd(1, 0, 0), wallLength);
+
+		// top wall
+		appendWall(vertices, hduVector3Dd(0, wallLength/2, 0), hduVector3Dd(0, 1, 0), wallLength);
+
+		// bottom wall
+		appendWall(vertices, hduVector3Dd(0, -wallLength/2, 0), hduVector3Dd(0, 1, 0), wallLength);
+
+		// back wall
+		appendWall(vertices, hduVector3Dd(0, 0, -wallLength/2), hduVector3Dd(0, 0, 1), wallLength);
+
+		box_geometry.set(vertices);
+		box_wall_length = wallLength;
+	}
+
+	setCapability(GL_LIGHTING, true);
+	setColor(color);
+	box_geometry.draw();
+}
+
+/******************************************************************************
+ Draws a triangle mesh, from a display list compiled on the first call.
+******************************************************************************/
+void drawMesh(const TriangleMesh& mesh, const float color[4])
+{
+    static GLuint list = 0;
+    if (list == 0)
+    {
+        list = glGenLists(1);
+        glNewList(list, GL_COMPILE);
+        glBegin(GL_TRIANGLES);
+        for (int i = 0; i < mesh.triangleCount(); ++i)
+        {
+            const MeshTriangle& t = mesh.triangle(i);
+            const hduVector3Dd b = t.a + t.ab;
+            const hduVector3Dd c = t.a + t.ac;
+            glNormal3d(t.normal[0], t.normal[1], t.normal[2]);
+            glVertex3d(t.a[0], t.a[1], t.a[2]);
+            glVertex3d(b[0], b[1], b[2]);
+            glVertex3d(c[0], c[1], c[2]);
+        }
+        glEnd();
+        glEndList();
+    }
+
+    setCapability(GL_LIGHTING, true);
+    setColor(color);
+    glCallList(list);
 }
 
 /******************************************************************************/
@@ -31,6 +31,8 @@ Description:
 #include <HD/hd.h>
 #include <HDU/hduVector.h>
 
+#include "mesh.h"
+
 void initGlut(int argc, char* argv[]);
 
 void initGraphics(const hduVector3Dd &LLB, const hduVector3Dd &TRF);
@@ -44,23 +46,36 @@ void drawSphere(GLUquadricObj* pQuadObj,
                 const float color[4],
                 double sphereRadius);
 
-/* Draws a wall. */
+/* Draws a wall, from a unit wall kept in a vertex buffer. */
 void drawWall(const hduVector3Dd &centerPosition,
 				const hduVector3Dd &Normal,
 				double wallLength,
                 const float color[4]);
 
-/* Draws a box. */
+/* Draws a box. Its walls are kept in a vertex buffer while the length
+   stays the same. */
 void drawBox(double wallLength, const float color[4]);
 
+/* Draws a triangle mesh. The mesh never changes, so it is compiled into a
+   display list the first time. */
+void drawMesh(const TriangleMesh& mesh, const float color[4]);
+
 /* Draws the force vector. */
 void drawForceVector(GLUquadricObj* pQuadObj,
                      const hduVector3Dd &position,
                      const hduVector3Dd &forceVector,
                      double arrowThickness);
 
+/* Sets the lights and the fixed pipeline state. initGraphics calls it
+   once the camera is placed; the lights stay put in eye space after. */
 void setupGraphicsState();
 
+/* Enable or disable a capability and set the current color, skipping the
+   GL call when the last call through here already set the same. State
+   changed directly with glEnable or glColor is not seen by these. */
+void setCapability(GLenum capability, bool enabled);
+void setColor(const float color[4]);
+
 #endif /* HelperHD_H_ */
 
 /******************************************************************************/
@@ -0,0 +1,325 @@
+/*****************************************************************************
+
+Module Name:
+
+  integrator.cpp
+
+Description:
+
+  Time integration schemes for the dynamic spheres.
+
+  All schemes use the acceleration model of the original haptic loop,
+
+      a = f / m - damping * v
+
+  where f is the applied force returned by the scene.
+
+*******************************************************************************/
+
+#include <string.h>
+
+#include "integrator.h"
+
+namespace
+{
+
+struct IntegratorName
+{
+    IntegratorType type;
+    const char* name;
+};
+
+const IntegratorName kIntegratorNames[] = {
+    { INTEGRATOR_EXPLICIT_EULER, "euler" },
+    { INTEGRATOR_SEMI_IMPLICIT_EULER, "semi-implicit" },
+    { INTEGRATOR_VELOCITY_VERLET, "verlet" },
+    { INTEGRATOR_RK4, "rk4" },
+    { INTEGRATOR_IMPLICIT_EULER, "implicit" }
+};
+
+const int kIntegratorNameCount = sizeof(kIntegratorNames) / sizeof(kIntegratorNames[0]);
+
+} // namespace
+
+bool parseIntegratorType(const char* name, IntegratorType* type)
+{
+    for (int i = 0; i < kIntegratorNameCount; ++i)
+    {
+        if (strcmp(name, kIntegratorNames[i].name) == 0)
+        {
+            *type = kIntegratorNames[i].type;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* integratorName(IntegratorType type)
+{
+    for (int i = 0; i < kIntegratorNameCount; ++i)
+    {
+        if (kIntegratorNames[i].type == type)
+        {
+            return kIntegratorNames[i].name;
+        }
+    }
+    return "unknown";
+}
+
+Integrator::Integrator()
+    : m_type(INTEGRATOR_SEMI_IMPLICIT_EULER)
+{
+}
+
+/******************************************************************************
+ Selects the scheme and sizes the scratch arrays.
+******************************************************************************/
+void Integrator::init(IntegratorType type, int bodyCount)
+{
+    m_type = type;
+
+    m_x0.assign(bodyCount, 0); m_y0.assign(bodyCount, 0); m_z0.assign(bodyCount, 0);
+    m_vx0.assign(bodyCount, 0); m_vy0.assign(bodyCount, 0); m_vz0.assign(bodyCount, 0);
+    m_dx.assign(bodyCount, 0); m_dy.assign(bodyCount, 0); m_dz.assign(bodyCount, 0);
+    m_dvx.assign(bodyCount, 0); m_dvy.assign(bodyCount, 0); m_dvz.assign(bodyCount, 0);
+}
+
+int Integrator::forceEvaluationsPerStep() const
+{
+    switch (m_type)
+    {
+    case INTEGRATOR_VELOCITY_VERLET:
+        return 2;
+    case INTEGRATOR_RK4:
+        return 4;
+    default:
+        return 1;
+    }
+}
+
+/******************************************************************************
+ Advances every body by dt with the selected scheme.
+******************************************************************************/
+void Integrator::step(BodyWorld& world, double dt,
+                      BodyForceFunction computeForces, void* pUserData)
+{
+    switch (m_type)
+    {
+    case INTEGRATOR_EXPLICIT_EULER:
+        computeForces(world, pUserData);
+        stepExplicitEuler(world, dt);
+        break;
+
+    case INTEGRATOR_SEMI_IMPLICIT_EULER:
+        computeForces(world, pUserData);
+        world.integrate(dt);
+        break;
+
+    case INTEGRATOR_VELOCITY_VERLET:
+        stepVelocityVerlet(world, dt, computeForces, pUserData);
+        break;
+
+    case INTEGRATOR_RK4:
+        stepRK4(world, dt, computeForces, pUserData);
+        break;
+
+    case INTEGRATOR_IMPLICIT_EULER:
+        stepImplicitEuler(world, dt, computeForces, pUserData);
+        break;
+    }
+}
+
+/******************************************************************************
+ Forward Euler: both position and velocity use the start of step values.
+ Only conditionally stable for the wall springs; kept for comparison.
+******************************************************************************/
+void Integrator::stepExplicitEuler(BodyWorld& world, double dt)
+{
+    const int n = world.count();
+    for (int i = 0; i < n; ++i)
+    {
+        const double ax = world.fx[i] * world.invMass[i] - world.damping[i] * world.vx[i];
+        const double ay = world.fy[i] * world.invMass[i] - world.damping[i] * world.vy[i];
+        const double az = world.fz[i] * world.invMass[i] - world.damping[i] * world.vz[i];
+
+        world.px[i] += world.vx[i] * dt;
+        world.py[i] += world.vy[i] * dt;
+        world.pz[i] += world.vz[i] * dt;
+
+        world.vx[i] += ax * dt;
+        world.vy[i] += ay * dt;
+        world.vz[i] += az * dt;
+    }
+}
+
+/******************************************************************************
+ Velocity Verlet in kick-drift-kick form. The second force evaluation sees
+ the new positions and the half step velocities, which is also the velocity
+ the damping term uses for the closing half kick.
+******************************************************************************/
+void Integrator::stepVelocityVerlet(BodyWorld& world, double dt,
+                                    BodyForceFunction computeForces, void* pUserData)
+{
+    const int n = world.count();
+    const double halfDt = 0.5 * dt;
+
+    // Half kick with the start of step acceleration, then drift.
+    computeForces(world, pUserData);
+    for (int i = 0; i < n; ++i)
+    {
+        world.vx[i] += (world.fx[i] * world.invMass[i] - world.damping[i] * world.vx[i]) * halfDt;
+        world.vy[i] += (world.fy[i] * world.invMass[i] - world.damping[i] * world.vy[i]) * halfDt;
+        world.vz[i] += (world.fz[i] * world.invMass[i] - world.damping[i] * world.vz[i]) * halfDt;
+
+        world.px[i] += world.vx[i] * dt;
+        world.py[i] += world.vy[i] * dt;
+        world.pz[i] += world.vz[i] * dt;
+    }
+
+    // Closing half kick with the end of step forces.
+    computeForces(world, pUserData);
+    for (int i = 0; i < n; ++i)
+    {
+        world.vx[i] += (world.fx[i] * world.invMass[i] - world.damping[i] * world.vx[i]) * halfDt;
+        world.vy[i] += (world.fy[i] * world.invMass[i] - world.damping[i] * world.vy[i]) * halfDt;
+        world.vz[i] += (world.fz[i] * world.invMass[i] - world.damping[i] * world.vz[i]) * halfDt;
+    }
+}
+
+/******************************************************************************
+ Backward Euler with the contact springs linearized about the start of the
+ step. With f(x, v) ~ f0 - K (x - x0) - m c v and x1 = x0 + h v1, solving
+ m (v1 - v0) = h f(x1, v1) for the velocity change dv = v1 - v0 gives
+
+     (m (1 + h c) I + h^2 K) dv = h (f0 - h K v0 - m c v0)
+
+ which is a 3x3 symmetric positive definite system per body. Contacts
+ between two bodies only contribute to each body's own block, so the bodies
+ are solved independently.
+******************************************************************************/
+void Integrator::stepImplicitEuler(BodyWorld& world, double dt,
+                                   BodyForceFunction computeForces, void* pUserData)
+{
+    world.trackStiffness = true;
+    computeForces(world, pUserData);
+
+    const int n = world.count();
+    const double h2 = dt * dt;
+    for (int i = 0; i < n; ++i)
+    {
+        const double m = world.mass[i];
+        const double diag = m * (1.0 + dt * world.damping[i]);
+
+        // System matrix A, symmetric.
+        const double a00 = diag + h2 * world.kxx[i];
+        const double a11 = diag + h2 * world.kyy[i];
+        const double a22 = diag + h2 * world.kzz[i];
+        const double a01 = h2 * world.kxy[i];
+        const double a02 = h2 * world.kxz[i];
+        const double a12 = h2 * world.kyz[i];
+
+        // Right hand side.
+        const double vx = world.vx[i], vy = world.vy[i], vz = world.vz[i];
+        const double mc = m * world.damping[i];
+        const double b0 = dt * (world.fx[i] - dt * (world.kxx[i] * vx + world.kxy[i] * vy + world.kxz[i] * vz) - mc * vx);
+        const double b1 = dt * (world.fy[i] - dt * (world.kxy[i] * vx + world.kyy[i] * vy + world.kyz[i] * vz) - mc * vy);
+        const double b2 = dt * (world.fz[i] - dt * (world.kxz[i] * vx + world.kyz[i] * vy + world.kzz[i] * vz) - mc * vz);
+
+        // Solve with the adjugate; A is positive definite so det > 0.
+        const double c00 = a11 * a22 - a12 * a12;
+        const double c01 = a02 * a12 - a01 * a22;
+        const double c02 = a01 * a12 - a02 * a11;
+        const double c11 = a00 * a22 - a02 * a02;
+        const double c12 = a01 * a02 - a00 * a12;
+        const double c22 = a00 * a11 - a01 * a01;
+        const double invDet = 1.0 / (a00 * c00 + a01 * c01 + a02 * c02);
+
+        world.vx[i] += (c00 * b0 + c01 * b1 + c02 * b2) * invDet;
+        world.vy[i] += (c01 * b0 + c11 * b1 + c12 * b2) * invDet;
+        world.vz[i] += (c02 * b0 + c12 * b1 + c22 * b2) * invDet;
+
+        world.px[i] += world.vx[i] * dt;
+        world.py[i] += world.vy[i] * dt;
+        world.pz[i] += world.vz[i] * dt;
+    }
+}
+
+void Integrator::accumulateDerivative(const BodyWorld& world, double weight)
+{
+    const int n = world.count();
+    for (int i = 0; i < n; ++i)
+    {
+        m_dx[i] += weight * world.vx[i];
+        m_dy[i] += weight * world.vy[i];
+        m_dz[i] += weight * world.vz[i];
+
+        m_dvx[i] += weight * (world.fx[i] * world.invMass[i] - world.damping[i] * world.vx[i]);
+        m_dvy[i] += weight * (world.fy[i] * world.invMass[i] - world.damping[i] * world.vy[i]);
+        m_dvz[i] += weight * (world.fz[i] * world.invMass[i] - world.damping[i] * world.vz[i]);
+    }
+}
+
+/******************************************************************************
+ Classic RK4. The world arrays hold each trial state in turn so the force
+ callback always sees an ordinary BodyWorld; the weighted derivative sum is
+ built up in the scratch arrays and applied to the saved start state.
+******************************************************************************/
+void Integrator::stepRK4(BodyWorld& world, double dt,
+                         BodyForceFunction computeForces, void* pUserData)
+{
+    const int n = world.count();
+
+    for (int i = 0; i < n; ++i)
+    {
+        m_x0[i] = world.px[i]; m_y0[i] = world.py[i]; m_z0[i] = world.pz[i];
+        m_vx0[i] = world.vx[i]; m_vy0[i] = world.vy[i]; m_vz0[i] = world.vz[i];
+        m_dx[i] = 0; m_dy[i] = 0; m_dz[i] = 0;
+        m_dvx[i] = 0; m_dvy[i] = 0; m_dvz[i] = 0;
+    }
+
+    // Stage weights of the derivative sum, and where the next trial state is.
+    const double weight[4] = { 1.0 / 6.0, 2.0 / 6.0, 2.0 / 6.0, 1.0 / 6.0 };
+    const double nextOffset[3] = { 0.5 * dt, 0.5 * dt, dt };
+
+    for (int stage = 0; stage < 4; ++stage)
+    {
+        computeForces(world, pUserData);
+        accumulateDerivative(world, weight[stage]);
+
+        if (stage == 3)
+        {
+            break;
+        }
+
+        // Trial state for the next stage: start state plus this stage's
+        // derivative times the stage offset.
+        const double h = nextOffset[stage];
+        for (int i = 0; i < n; ++i)
+        {
+            const double ax = world.fx[i] * world.invMass[i] - world.damping[i] * world.vx[i];
+            const double ay = world.fy[i] * world.invMass[i] - world.damping[i] * world.vy[i];
+            const double az = world.fz[i] * world.invMass[i] - world.damping[i] * world.vz[i];
+
+            world.px[i] = m_x0[i] + h * world.vx[i];
+            world.py[i] = m_y0[i] + h * world.vy[i];
+            world.pz[i] = m_z0[i] + h * world.vz[i];
+
+            world.vx[i] = m_vx0[i] + h * ax;
+            world.vy[i] = m_vy0[i] + h * ay;
+            world.vz[i] = m_vz0[i] + h * az;
+        }
+    }
+
+    for (int i = 0; i < n; ++i)
+    {
+        world.px[i] = m_x0[i] + dt * m_dx[i];
+        world.py[i] = m_y0[i] + dt * m_dy[i];
+        world.pz[i] = m_z0[i] + dt * m_dz[i];
+
+        world.vx[i] = m_vx0[i] + dt * m_dvx[i];
+        world.vy[i] = m_vy0[i] + dt * m_dvy[i];
+        world.vz[i] = m_vz0[i] + dt * m_dvz[i];
+    }
+}
+
+/******************************************************************************/
@@ -0,0 +1,85 @@
+/*****************************************************************************
+
+Module Name:
+
+  integrator.h
+
+Description:
+
+  Time integration schemes for the dynamic spheres. The scheme is chosen at
+  startup; every scheme advances all bodies of a BodyWorld and calls back
+  into the scene to evaluate forces as many times as it needs.
+
+*******************************************************************************/
+
+#ifndef Integrator_H_
+#define Integrator_H_
+
+#include <vector>
+
+#include "bodies.h"
+
+enum IntegratorType
+{
+    INTEGRATOR_EXPLICIT_EULER,      // x += v dt, then v += a dt
+    INTEGRATOR_SEMI_IMPLICIT_EULER, // v += a dt, then x += v dt (symplectic)
+    INTEGRATOR_VELOCITY_VERLET,     // kick, drift, kick (symplectic, 2nd order)
+    INTEGRATOR_RK4,                 // classic 4th order Runge-Kutta
+    INTEGRATOR_IMPLICIT_EULER       // backward Euler on the linearized contact springs
+};
+
+/* Looks up a scheme by its short name ("euler", "semi-implicit", "verlet",
+   "rk4", "implicit"). Returns false for unknown names. */
+bool parseIntegratorType(const char* name, IntegratorType* type);
+
+const char* integratorName(IntegratorType type);
+
+/* Fills world.fx/fy/fz with the net applied force on every body for the
+   current positions and velocities. Damping is applied by the integrator
+   and must not be included. When world.trackStiffness is set, the contact
+   stiffness of every body must be filled in as well. */
+typedef void (*BodyForceFunction)(BodyWorld& world, void* pUserData);
+
+class Integrator
+{
+public:
+    Integrator();
+
+    /* Selects the scheme and sizes its scratch storage for bodyCount bodies
+       so that step() never allocates. */
+    void init(IntegratorType type, int bodyCount);
+
+    IntegratorType type() const { return m_type; }
+
+    /* Number of force evaluations one step makes. */
+    int forceEvaluationsPerStep() const;
+
+    /* Advances every body in world by dt. */
+    void step(BodyWorld& world, double dt,
+              BodyForceFunction computeForces, void* pUserData);
+
+private:
+    void stepExplicitEuler(BodyWorld& world, double dt);
+    void stepVelocityVerlet(BodyWorld& world, double dt,
+                            BodyForceFunction computeForces, void* pUserData);
+    void stepRK4(BodyWorld& world, double dt,
+                 BodyForceFunction computeForces, void* pUserData);
+    void stepImplicitEuler(BodyWorld& world, double dt,
+                           BodyForceFunction computeForces, void* pUserData);
+
+    /* Adds weight times the current derivative (velocity and acceleration)
+       of every body to the RK4 accumulators. */
+    void accumulateDerivative(const BodyWorld& world, double weight);
+
+    IntegratorType m_type;
+
+    // Scratch storage: start of step state and RK4 derivative sums.
+    std::vector<double> m_x0, m_y0, m_z0;
+    std::vector<double> m_vx0, m_vy0, m_vz0;
+    std::vector<double> m_dx, m_dy, m_dz;
+    std::vector<double> m_dvx, m_dvy, m_dvz;
+};
+
+#endif /* Integrator_H_ */
+
+/******************************************************************************/
@@ -0,0 +1,79 @@
+/*****************************************************************************
+
+Module Name:
+
+  localModel.cpp
+
+Description:
+
+  Construction and evaluation of the local contact plane model.
+
+*******************************************************************************/
+
+#include "localModel.h"
+
+void addContactPlane(LocalModel& model, const hduVector3Dd& normal, double offset, double k)
+{
+    if (model.planeCount >= kMaxContactPlanes)
+    {
+        ++model.droppedPlanes;
+        return;
+    }
+    ContactPlane& plane = model.planes[model.planeCount++];
+    plane.normal = normal;
+    plane.offset = offset;
+    plane.k = k;
+}
+
+/******************************************************************************
+ The wall at +h along an axis pushes back once x + r > h, i.e. once
+ -x < r - h, so its plane has normal -axis and offset r - h; the wall at -h
+ mirrors it.
+******************************************************************************/
+void addWallPlanes(LocalModel& model, double radius, double k, double side_length)
+{
+    const double offset = radius - side_length / 2;
+    for (int i = 0; i < 3; ++i)
+    {
+        hduVector3Dd normal(0, 0, 0);
+        normal[i] = -1;
+        addContactPlane(model, normal, offset, k);
+        normal[i] = 1;
+        addContactPlane(model, normal, offset, k);
+    }
+}
+
+/******************************************************************************
+ The plane touches the sphere where the HIP would first meet it coming from
+ its current position, offset outwards by the HIP radius.
+******************************************************************************/
+void addSpherePlane(LocalModel& model, const hduVector3Dd& hipPosition, double hipRadius,
+                    const hduVector3Dd& center, double radius, double k)
+{
+    hduVector3Dd normal = hipPosition - center;
+    const double distance = normal.magnitude();
+    if (distance <= 0)
+    {
+        // No direction to push along; the HIP sits on the sphere center.
+        return;
+    }
+    normal /= distance;
+    addContactPlane(model, normal, dotProduct(normal, center) + radius + hipRadius, k);
+}
+
+hduVector3Dd evaluateLocalModel(const LocalModel& model, const hduVector3Dd& position)
+{
+    hduVector3Dd force(0, 0, 0);
+    for (int i = 0; i < model.planeCount; ++i)
+    {
+        const ContactPlane& plane = model.planes[i];
+        const double depth = plane.offset - dotProduct(plane.normal, position);
+        if (depth > 0)
+        {
+            force += plane.normal * (plane.k * depth);
+        }
+    }
+    return force;
+}
+
+/******************************************************************************/
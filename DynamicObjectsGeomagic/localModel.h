@@ -0,0 +1,65 @@
+/*****************************************************************************
+
+Module Name:
+
+  localModel.h
+
+Description:
+
+  Local intermediate model of the scene around the HIP. The physics thread
+  reduces everything the HIP may touch before its next update to a short
+  list of penalty planes; the haptic loop evaluates that list at the servo
+  rate, which costs the same however many spheres are in the scene.
+
+*******************************************************************************/
+
+#ifndef LocalModel_H_
+#define LocalModel_H_
+
+#include <HDU/hduVector.h>
+
+/* A one sided spring: a HIP center x with normal . x < offset is pushed
+   along normal with force k * (offset - normal . x). */
+struct ContactPlane
+{
+    hduVector3Dd normal;
+    double offset;
+    double k;
+};
+
+/* Six box walls plus the nearest spheres. */
+const int kMaxContactPlanes = 32;
+
+struct LocalModel
+{
+    LocalModel() : planeCount(0), droppedPlanes(0), publishTime(0) {}
+
+    int planeCount;
+    ContactPlane planes[kMaxContactPlanes];
+
+    // Planes that did not fit in planes.
+    int droppedPlanes;
+
+    // monotonicSeconds() time at which the model was published.
+    double publishTime;
+};
+
+/* Adds a plane; planes past kMaxContactPlanes are dropped and counted in
+   droppedPlanes. */
+void addContactPlane(LocalModel& model, const hduVector3Dd& normal, double offset, double k);
+
+/* The six walls of the cubic box, as seen by a HIP of the given radius.
+   Same springs as Interaction_Wall. */
+void addWallPlanes(LocalModel& model, double radius, double k, double side_length);
+
+/* Tangent plane of a sphere facing the HIP at hipPosition. To first order
+   in the HIP motion it gives the same force as the sphere spring. */
+void addSpherePlane(LocalModel& model, const hduVector3Dd& hipPosition, double hipRadius,
+                    const hduVector3Dd& center, double radius, double k);
+
+/* Force on a HIP centered at position. */
+hduVector3Dd evaluateLocalModel(const LocalModel& model, const hduVector3Dd& position);
+
+#endif /* LocalModel_H_ */
+
+/******************************************************************************/
@@ -23,62 +23,92 @@ position and constructs graphics elements (e.g. force vector).
  *******************************************************************************/
 
 #include <stdlib.h>
+#include <chrono>
+#include <csignal>
 #include <iostream>
 #include <cstdio>
 #include <cassert>
+#include <thread>
 
 #include <HD/hd.h>
 
+#include "distanceGrid.h"
 #include "helper.h"
+#include "godObject.h"
+#include "sparseDistanceGrid.h"
+#include "mesh.h"
+#include "monotonicClock.h"
+#include "scene.h"
+#include "simulation.h"
+#include "physicsThread.h"
+#include "recorder.h"
+#include "telemetry.h"
+#include "snapshot.h"
+#include "sphereRenderer.h"
+#include "tripleBuffer.h"
+#include "wallForce.h"
+#include "options.h"
+#include "realtime.h"
+
+#ifdef SERVO_BENCH
+#include "servoBench.h"
+#endif
 
 #include <HDU/hduError.h>
 #include <HDU/hduVector.h>
 
-#define throttle_debug(r,x) { static int k=0; if(k++%r==0) { std::cout<<x<<std::endl; } }
-
  /////////////////////////////////START///////////////////////////////////////
  /////////////////////////////////////////////////////////////////////////////
  /////////////////////////////////////////////////////////////////////////////
 
  //These are global variables to get you started. You can also define your own variables to use.
 
- // HIP Parameters
-const double proxy_radius = 5.0;
-const float proxy_color[4] = { .8, .2, .2, .8 };
-
-// Box surface Parameters
-const double wall_hip_k = 0.48;  // Surface stiffness with HIP (N/mm)
-const double wall_sphere_k = 4.00;  // Surface stiffness with sphere (N/mm)
-const double side_length = 200; // Length of the sides of the box (mm)
-const hduVector3Dd side_lengths(side_length, side_length, side_length);
-const float box_color[4] = { .2, .2, .8, .2 };
-
-// Object (big sphere) Parameters.  Note that for remote testing purposes, object may spawn on hip to provide force / have intial velocity / force components.
-const double sphere_k = 0.48;  // Surface stiffness with HIP (N/mm)
-const double sphere_damping = 0.002; // Sphere damping (N-s/mm)
-const double sphere_mass = 0.005; // Sphere mass (Kg)
-const double sphere_radius = 10.0; // Radius of sphere (mm)
-const float sphere_color[4] = { .2, .8, .8, .8 };
-
-// State parameters 
-//Note that HIP tool is at 0, -65, -88).
-hduVector3Dd sphere_pos(0, -60, -88); // center of the object sphere
-hduVector3Dd sphere_vel(-20, 0, 0);
-hduVector3Dd sphere_acc(0, 0, 0); //velocity and acceleration of the big sphere
-
-//Calculate wall interactions based on radius and position.  Return force vector.  For cube (if want different side lengths take side_lengths as arg).
-hduVector3Dd Interaction_Wall(const hduVector3Dd& position, const double& radius, const double& k, const double& side_length) {
-    hduVector3Dd wallForce;
-	for (int i = 0; i < 3; ++i){
-		if (position[i] + radius > side_length / 2) {
-        wallForce[i] += k * (side_length / 2 - position[i] - radius);
-		}
-		if (position[i] - radius < -side_length / 2) {
-			wallForce[i] += k * (-side_length / 2 - position[i] + radius);
-		}
-	}
-    return wallForce;
-}
+ //The scene parameters (HIP, box and sphere constants) are in scene.h, and can be loaded from a scene file with --scene.
+
+// Startup options.
+RunOptions run_options;
+
+// Steps the spheres when --physics-hz is set; otherwise the haptic loop does.
+PhysicsThread physics_thread;
+
+// State of the HIP and spheres, published by the haptic loop every tick for the graphics.
+TripleBuffer<WorldSnapshot> world_snapshot;
+
+// Session recording (--record) and replay (--replay).
+Recorder recorder;
+Replayer replayer;
+
+// Per tick diagnostics (--telemetry), written out by a background thread.
+Telemetry telemetry;
+
+// Triangle mesh (--mesh) and the god-object proxy the HIP touches it through.
+TriangleMesh mesh;
+MeshProxy mesh_proxy;
+
+// Signed distance grid (--sdf), dense or sparse, rendered instead of the mesh proxy when loaded.
+DistanceGrid sdf_grid;
+SparseDistanceGrid sparse_sdf;
+
+// How far ahead (s) the sparse grid's bricks are prefetched along the HIP's motion.
+const double sdf_prefetch_lookahead = 0.05;
+
+// Draws the spheres each frame from cached meshes, instanced where the driver allows.
+SphereRenderer sphere_renderer;
+
+// The proxies last drawn, so that with --fps a frame is only drawn when they move.
+hduVector3Dd drawn_hip_proxy;
+std::vector<hduVector3Dd> drawn_body_proxies;
+
+// When the next paced frame is due (--fps).
+std::chrono::steady_clock::time_point next_frame_time;
+
+// How often (ms) the graphics check that the haptic loop is still running.
+const int scheduler_check_period = 100;
+
+// Set by SIGINT or SIGTERM to end a headless run.
+volatile std::sig_atomic_t quit_requested = 0;
+
+//Wall interactions (Interaction_Wall for one sphere, Interaction_WallBatch for all dynamic spheres) are in wallForce.cpp.
 
 
 /////////////////////////////////////////////////////////////////////////////
@@ -97,32 +127,9 @@ static HDSchedulerHandle gSchedulerCallback = HD_INVALID_HANDLE;
 void displayFunction(void);
 void handleIdle(void);
 
-/* Haptic device record. */
-struct DeviceDisplayState
-{
-    HHD m_hHD;
-    hduVector3Dd position;
-    hduVector3Dd force;
-};
-
-/*******************************************************************************
-  Client callback used by the graphics main loop function.
-  Use this callback synchronously.
-  Gets data, in a thread safe manner, that is constantly being modified by the
-  haptics thread.
- *******************************************************************************/
-HDCallbackCode HDCALLBACK DeviceStateCallback(void* pUserData)
-{
-    DeviceDisplayState* pDisplayState =
-        static_cast<DeviceDisplayState*>(pUserData);
-
-    hdGetDoublev(HD_CURRENT_POSITION, pDisplayState->position);
-    hdGetDoublev(HD_CURRENT_FORCE, pDisplayState->force);
-
-    // execute this only once.
-    return HD_CALLBACK_DONE;
-}
-
+/* Glut timer callbacks */
+void handleFrameTimer(int value);
+void handleSchedulerCheck(int value);
 
 /*******************************************************************************
   Graphics main loop function. Insert your graphic edits in here.
@@ -136,9 +143,7 @@ void displayFunction(void)
     glPushMatrix();
     //glTranslatef(0,0,-200); %Move the box linearly
 
-    setupGraphicsState();
-    // enable color
-    glEnable(GL_COLOR_MATERIAL);
+    // The lights and color material were set up once by initGraphics.
     //drawAxes(sphere_radius*3.0);
 
 
@@ -151,76 +156,34 @@ void displayFunction(void)
     //// No need to modify this part////////////////////////////////////////////
     // Draw a cubic box 
     drawBox(side_length, box_color);
-
-    // Get the current position of end effector and save in the 'state' variable.
-    DeviceDisplayState state;
-    hdScheduleSynchronous(DeviceStateCallback, &state,
-        HD_MIN_SCHEDULER_PRIORITY);
-    ////////////////////////////////////////////////////////////////////////////
-
-    // The big sphere (object) center is determined and updated from the haptic loop as a global "sphere_pos" variable that you computed
-    // Make a copy of the sphere_pos to a local variable, called proxy_object, for use in the graphic loop 
-    hduVector3Dd proxy_object(sphere_pos);
-
-    // Update the "proxy_object" variable such that the big sphere does not appear to pass the walls visually.
-    // when the big sphere is not touching the walls, proxy_object is the same as sphere_pos
-    
-	//We could combine these for loops with the ones for the hip proxy, but I am seperating them for consistency with the given comments layout.
-	//Note that because we define the proxy_object position first, it is given priority over the hip proxy position.
-    for (int i = 0; i < 3; ++i) {
-        if (proxy_object[i] + sphere_radius > side_length / 2) {
-            proxy_object[i] = side_length / 2 - sphere_radius;
-        }
-        else if (proxy_object[i] - sphere_radius < -side_length / 2) {
-            proxy_object[i] = -side_length / 2 + sphere_radius;
-        }
+    if (!mesh.empty()) {
+        drawMesh(mesh, mesh_color);
     }
 
-
-    // Draw the big sphere using the drawSphere fucntion using the sphere center and parameters defined above
-    GLUquadricObj* pQuadObj = gluNewQuadric();
-    drawSphere(pQuadObj, proxy_object, sphere_color, sphere_radius);
-    gluDeleteQuadric(pQuadObj);
+    // Get the latest state published by the haptic loop.  This never waits for the haptic loop, and it never waits for us.
+    world_snapshot.update();
+    const WorldSnapshot& state = world_snapshot.readBuffer();
+    ////////////////////////////////////////////////////////////////////////////
 
     // Note that the current state of the HIP is saved in the variable called "state" from the method above
-    // To get the position of the HIP, use state.position. This represents the center of the HIP sphere
+    // To get the position of the HIP, use state.hipPosition. This represents the center of the HIP sphere
     // For example, to find the distance between the current user position and an object
-    // you can use: hduVector3Dd var = state.position - object_pos;
-    hduVector3Dd proxy_pos(state.position);
-
+    // you can use: hduVector3Dd var = state.hipPosition - object_pos;
 
-    // Proxy position variable defined from state variable of the HIP position to be used for graphic display of the user's position
-    // Update the "proxy_pos" variable such that the user's HIP sphere does not penetrate into other surfaces graphically
-    // when the HIP sphere is not touching any objects, proxy_pos is the same as current user's position
+    // The haptic loop has already held the HIP and the spheres out of the walls, the mesh and each other
+    // (WorldSnapshot::solveProxies), so the proxies are drawn as they are.
 
-    // Consider if HIP sphere enters the walls. Find the proxy_pos.
-    for (int i = 0; i < 3; ++i) {
-        if (proxy_pos[i] + proxy_radius > side_length / 2) {
-            proxy_pos[i] = side_length / 2 - proxy_radius;
-        }
-        else if (proxy_pos[i] - proxy_radius < -side_length / 2) {
-            proxy_pos[i] = -side_length / 2 + proxy_radius;
-        }
-    }
-
-
-    // Consider if HIP sphere enters the big sphere. Find the proxy_pos. Current big sphere position is the global variable sphere_pos, but we compare to proxy_obj in
-	//case we are already offsetting the dynamic sphere's location.
-    hduVector3Dd rSphereHIP = proxy_object - state.position;
-    //If the distance vector has less magnitude than sum of radii, then we have collision.
-    const double deltaDist = rSphereHIP.magnitude() - sphere_radius - proxy_radius;
-    if (deltaDist < 0) {
-        //Calculate force onto dynamic sphere based on its k value.  Apply this force to both the user and the sphere.
-        //The force is in the opposite direction to rSphereHIP (the vector between the centers of the two spheres).  This vector points from the proxy to the dynamic sphere.
-        rSphereHIP.normalize();
-        proxy_pos = proxy_object - rSphereHIP * (sphere_radius + proxy_radius);
+    // The spheres are queued and drawn together, a few draw calls for all of them.
+    for (int b = 0; b < state.bodies.count(); ++b) {
+        sphere_renderer.add(state.bodyProxies[b], bodies.radius[b], sphere_color);
     }
 
+    // Draw HIP sphere at its proxy
+    sphere_renderer.add(state.hipProxy, proxy_radius, proxy_color);
+    sphere_renderer.draw();
 
-    // Draw HIP sphere using the updated "proxy_pos" variable
-    pQuadObj = gluNewQuadric();
-    drawSphere(pQuadObj, proxy_pos, proxy_color, proxy_radius);
-    gluDeleteQuadric(pQuadObj);
+    drawn_hip_proxy = state.hipProxy;
+    drawn_body_proxies = state.bodyProxies;
 
     /////////////////////////////////////////////////////////////////////////////
     /////////////////////////////////////////////////////////////////////////////
@@ -234,11 +197,51 @@ void displayFunction(void)
 }
 
 /*******************************************************************************
-  Called periodically by the GLUT framework.
+  Called periodically by the GLUT framework when frames are not paced (--fps=0).
  *******************************************************************************/
 void handleIdle(void)
 {
     glutPostRedisplay();
+}
+
+/*******************************************************************************
+  Paced frames (--fps): GLUT sleeps until the next frame is due, and the frame
+  is only drawn if the haptic loop has published proxies that moved since the
+  last one drawn.
+ *******************************************************************************/
+void handleFrameTimer(int value)
+{
+    if (world_snapshot.update()) {
+        const WorldSnapshot& state = world_snapshot.readBuffer();
+        bool moved = state.hipProxy != drawn_hip_proxy || state.bodyProxies.size() != drawn_body_proxies.size();
+        for (size_t b = 0; b < state.bodyProxies.size() && !moved; ++b) {
+            moved = state.bodyProxies[b] != drawn_body_proxies[b];
+        }
+        if (moved) {
+            glutPostRedisplay();
+        }
+    }
+
+    // Deadlines advance by whole periods so the rate holds on average; after a stall the next frame is due now.
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    next_frame_time += std::chrono::nanoseconds(1000000000LL / run_options.frameRate);
+    if (next_frame_time < now) {
+        next_frame_time = now;
+    }
+    const long long wait_us = std::chrono::duration_cast<std::chrono::microseconds>(next_frame_time - now).count();
+    glutTimerFunc((unsigned int) ((wait_us + 500) / 1000), handleFrameTimer, value);
+}
+
+/*******************************************************************************
+  Checks a few times a second that the haptic loop is still running.
+ *******************************************************************************/
+void handleSchedulerCheck(int value)
+{
+    static bool replay_reported = false;
+    if (replayer.active() && replayer.finished() && !replay_reported) {
+        printf("Replay finished after %lu ticks\n", (unsigned long) replayer.recordCount());
+        replay_reported = true;
+    }
 
     if (!hdWaitForCompletion(gSchedulerCallback, HD_WAIT_CHECK_STATUS))
     {
@@ -247,6 +250,8 @@ void handleIdle(void)
         getchar();
         exit(-1);
     }
+
+    glutTimerFunc(scheduler_check_period, handleSchedulerCheck, value);
 }
 
 /******************************************************************************
@@ -286,6 +291,9 @@ hduVector3Dd Interaction_WallHIP(hduVector3Dd position, double HIPRadius, double
  *******************************************************************************/
 HDCallbackCode HDCALLBACK DynamicObjectsCallback(void* data)
 {
+    // With --rt, the first tick pins this thread and raises its priority; later ticks only check a flag.
+    rtSetupServoThread(run_options.realtime);
+
     hdBeginFrame(hdGetCurrentDevice());
 
 
@@ -299,18 +307,26 @@ HDCallbackCode HDCALLBACK DynamicObjectsCallback(void* data)
     hduVector3Dd position;
     hdGetDoublev(HD_CURRENT_POSITION, position);
 
+    // When replaying a recording, the recorded HIP position replaces the device position, tick by tick.
+    if (replayer.active()) {
+        position = replayer.next();
+    }
+
+    // From here to the end of the frame the servo loop must not make system calls (checked in debug builds with --rt).
+    rtServoPathBegin();
+
     // Local variables for you to use. Add more variables as needed.
     hduVector3Dd f(0, 0, 0); //force on the HIP sphere to be outputted to user
-    double timeStep = 0.001; //update rate for numerical integration
-	//Define some force on the sphere for testing.
-	hduVector3Dd sphere_f(0, 0, 0); //net force on the big sphere
+    double timeStep = 1.0 / run_options.servoRate; //update rate for numerical integration
 
-	//Track the loop iterations so that we can limit print rate.
-	static int ticker = 0;
-	++ticker;
-    
+	//Count the ticks for the snapshot and the recording.
+	static unsigned long tick_count = 0;
+	++tick_count;
 
-    //std::cout<< position[0] << std::endl; //can uncomment this and use the command to output values on the screen for debugging
+	//Time the tick for the telemetry.
+	const double tick_start = telemetry.active() ? monotonicSeconds() : 0;
+
+    //Printing from the haptic loop stalls it; run with --telemetry=- to see positions and forces on the console instead.
 
     // Determine the net forces on the big sphere and HIP
     // Compute sphere_f which is the resultant force acting on the big sphere and f which is force on HIP sphere to be outputted to user
@@ -320,26 +336,42 @@ HDCallbackCode HDCALLBACK DynamicObjectsCallback(void* data)
     //The simulation is contained within a box, surrounding (0, 0, 0) with lengths side_length.
     //We model these walls simple spring system.
 
-    //Check for wall collision.  We use a penetration method for both the hip and dynamic sphere, though in a previous version we used a perfect reflection method
-	//for the dynamic sphere.  Both function approximately the same.
-    f = f + Interaction_Wall(position, proxy_radius, wall_hip_k, side_length);
-	sphere_f = sphere_f + Interaction_Wall(sphere_pos, sphere_radius, wall_sphere_k, side_length); 
-
-    //Calculate collision forces between the HIP and dynamic sphere.  Normally this would require the mass of both points to calculate energy balance.
-    //We are given a stiffness coefficient, so it is possible we assume infinite mass for HIP.
+    if (physics_thread.running()) {
+        //The spheres are stepped on the physics thread, which keeps a local model of the walls and the spheres near the HIP up to date.
+        //Rendering that model is all the haptic loop does, so its cost does not grow with the scene.
+        f = physics_thread.hapticForce(position);
+    }
+    else {
+        //Check for wall collision.  We use a penetration method for both the hip and dynamic sphere, though in a previous version we used a perfect reflection method
+        //for the dynamic sphere.  Both function approximately the same.
+        f = f + Interaction_Wall(position, proxy_radius, wall_hip_k, side_length);
 
-    //Check if the HIP has collided with the dynamic sphere.
-    hduVector3Dd rSphereHIP = sphere_pos - position;
-    //If the distance vector has less magnitude than sum of radii, then we have collision.
-    const double deltaDist = rSphereHIP.magnitude() - sphere_radius - proxy_radius;
-    if (deltaDist < 0) {
-        //Calculate force onto dynamic sphere based on its k value.  Apply this force to both the user and the sphere.
-        //The force is in the opposite direction to rSphereHIP (the vector between the centers of the two spheres).  This vector points from the proxy to the dynamic sphere.
-        rSphereHIP.normalize();
-        hduVector3Dd collisionForce = rSphereHIP * deltaDist * sphere_k;
+        //The spheres are moved by the integrator chosen at startup (see simulation.cpp), split into the requested number of substeps.
+        f = f + StepSimulation(position, timeStep, run_options.substeps);
+    }
 
-        f = f + collisionForce;
-        sphere_f = sphere_f - collisionForce;
+    //The mesh is static, so its proxy is updated here in either mode.  The BVH keeps that to a few dozen triangle tests a tick.
+    //A baked distance grid costs a single lookup instead, and pushes the HIP sphere straight out along the surface normal.
+    hduVector3Dd mesh_proxy_pos(position);
+    if (!sdf_grid.empty() || !sparse_sdf.empty()) {
+        hduVector3Dd normal;
+        double distance;
+        if (!sdf_grid.empty()) {
+            distance = sdf_grid.sample(position, normal);
+        }
+        else {
+            sparse_sdf.track(position);
+            distance = sparse_sdf.sample(position, normal);
+        }
+        const double depth = proxy_radius - distance;
+        if (depth > 0) {
+            mesh_proxy_pos = position + normal * depth;
+            f = f + normal * (mesh_k * depth);
+        }
+    }
+    else if (!mesh.empty()) {
+        mesh_proxy_pos = mesh_proxy.update(position);
+        f = f + mesh_proxy.force(position, mesh_k);
     }
 
 	//std::cout << position[0] << ", " << position[1] << ", " << position[2] << "\n";
@@ -348,43 +380,39 @@ HDCallbackCode HDCALLBACK DynamicObjectsCallback(void* data)
     //sphere_f.set(0.001,0,0); //force pushing the big sphere along +x direction
 
 
-    // Knowing sphere_f, compute big sphere dynamics to update its position variable, sphere_pos. This is used in the graphic display function
-    // Velocity and acceleration of the sphere (sphere_vel and sphere_acc) are already defined globally
-    // sphere_pos = ??;
-
-    //Integrate the effects of sphere_f onto its motion.
-    //Callback looping at 1 kHz, so dt = 0.001 s.
-    const double dt = 0.001;
-
-    //Update accel.  Account for damping to prevent infinite movement.
-    sphere_acc = sphere_f / sphere_mass - sphere_damping * sphere_vel;
-
-    //Integrate for velocity.  Is += defined for hd vector?  Don't have libraries.  
-    sphere_vel = sphere_vel + sphere_acc * dt;
-
-    //Integrate for position.
-    sphere_pos = sphere_pos + sphere_vel * dt;
-
-	//Print some info for debugging.  Printing every step will slow the simulation, so print every 300ms.
-	if (ticker == 300 && false){
-		ticker = 0;
-		std::cout << "-------\ndynamic sphere:\n";
-		for (int i = 0; i < 3; ++i){
-			std::cout << i << " - f: " << sphere_f[i] << ", a: " << sphere_acc[i] << ", v: " << sphere_vel[i] << ", p: " << sphere_pos[i] << '\n';
-		}
-		std::cout << "||v||: " << sphere_vel.magnitude() << "\n\n";
-		std::cout << "hip sphere:\n";
-		for (int i = 0; i < 3; ++i){
-			std::cout << i << " - f: " << f[i] << ", p: " << position[i] << '\n';
-		}
-	}
-
+    //Record the force the scene rendered, before the safety override below.
+    if (recorder.active()) {
+        recorder.record((uint32_t) tick_count, position, f);
+    }
+    const hduVector3Dd scene_f = f;
 
     f.set(0, 0, 0); //keep f to zero to keep the force output to remote device to 0 for safety.
 
     // Set the output force on HIP, assuming the force output variable is f. You can change the variable.
     hdSetDoublev(HD_CURRENT_FORCE, f);
 
+    // Publish this tick's state for the graphics.  The snapshot storage was sized in main, so this only copies.
+    WorldSnapshot& snapshot = world_snapshot.writeBuffer();
+    snapshot.tick = tick_count;
+    snapshot.hipPosition = position;
+    snapshot.force = scene_f;
+    if (physics_thread.running()) {
+        snapshot.bodies = physics_thread.bodyStates();
+    }
+    else {
+        snapshot.bodies.capture(bodies);
+    }
+    //The proxies are solved here once, from the same state, so the graphics draw exactly what was rendered.
+    snapshot.solveProxies(mesh_proxy_pos, bodies);
+
+    // Telemetry only copies a few values into its buffer; the file or console is written from another thread.
+    if (telemetry.active()) {
+        telemetry.record((uint32_t) tick_count, tick_start, position, scene_f, snapshot.bodies);
+    }
+    world_snapshot.publish();
+
+    rtServoPathEnd();
+
 
     /////////////////////////////////////////////////////////////////////////////
     /////////////////////////////////////////////////////////////////////////////
@@ -406,10 +434,17 @@ HDCallbackCode HDCALLBACK DynamicObjectsCallback(void* data)
 }
 
 /*******************************************************************************
-  Schedules the force callback.
+  Schedules the force callback, and starts the physics thread if the spheres
+  run on one.
  *******************************************************************************/
-void DynamicObjectsRendering()
+void startSimulation()
 {
+    // The physics thread starts first, so the callback sees it running from its first tick and never steps the
+    // spheres itself. It waits for the haptic loop to report the HIP before its first update.
+    if (run_options.physicsRate > 0) {
+        physics_thread.start(run_options.physicsRate, run_options.substeps);
+    }
+
     std::cout << "haptics callback" << std::endl;
     gSchedulerCallback = hdScheduleAsynchronous(
         DynamicObjectsCallback, 0, HD_DEFAULT_SCHEDULER_PRIORITY);
@@ -422,12 +457,116 @@ void DynamicObjectsRendering()
         getchar();
         exit(-1);
     }
+}
+
+/*******************************************************************************
+  Starts the simulation and runs the graphics.
+ *******************************************************************************/
+void DynamicObjectsRendering()
+{
+    startSimulation();
 
     std::cout << "graphics callback" << std::endl;
 
+    // With paced frames GLUT has no idle callback, so it sleeps between timers instead of spinning.
+    if (run_options.frameRate > 0) {
+        glutIdleFunc(NULL);
+        next_frame_time = std::chrono::steady_clock::now();
+        glutTimerFunc(0, handleFrameTimer, 0);
+    }
+    glutTimerFunc(scheduler_check_period, handleSchedulerCheck, 0);
+
     glutMainLoop(); // Enter GLUT main loop.
 }
 
+/*******************************************************************************
+  Ends a headless run (SIGINT, SIGTERM).
+ *******************************************************************************/
+void handleQuitSignal(int)
+{
+    quit_requested = 1;
+}
+
+/*******************************************************************************
+  Prints one status line of a headless run from the latest published state.
+  The force is the one the scene rendered, as in telemetry and recordings,
+  not the zeroed device output.
+ *******************************************************************************/
+void printHeadlessStats(const char* label, double elapsed, unsigned long& last_tick, double& last_time)
+{
+    world_snapshot.update();
+    const WorldSnapshot& state = world_snapshot.readBuffer();
+
+    double max_speed = 0;
+    for (int b = 0; b < state.bodies.count(); ++b) {
+        const double speed = state.bodies.velocity(b).magnitude();
+        max_speed = speed > max_speed ? speed : max_speed;
+    }
+    const double rate = elapsed > last_time ? (state.tick - last_tick) / (elapsed - last_time) : 0;
+
+    printf("%st=%.1f s  tick %lu (%.0f Hz)  HIP (%.1f, %.1f, %.1f) mm  rendered force %.2f N  %d spheres, fastest %.1f mm/s",
+           label, elapsed, state.tick, rate, state.hipPosition[0], state.hipPosition[1], state.hipPosition[2],
+           state.force.magnitude(), state.bodies.count(), max_speed);
+    if (telemetry.active()) {
+        printf("  telemetry dropped %lu", telemetry.dropped());
+    }
+    printf("\n");
+    fflush(stdout);
+
+    last_tick = state.tick;
+    last_time = elapsed;
+}
+
+/*******************************************************************************
+  Headless run (--headless): the haptic loop and physics thread run as with a
+  window, and this thread only prints status lines and checks that the haptic
+  loop is still running, until --duration, a quit signal or the end of a
+  replay. Telemetry and recording work as usual.
+ *******************************************************************************/
+int DynamicObjectsHeadless()
+{
+    startSimulation();
+
+    std::signal(SIGINT, handleQuitSignal);
+    std::signal(SIGTERM, handleQuitSignal);
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    double next_stats = run_options.statsEvery;
+    unsigned long last_tick = 0;
+    double last_time = 0;
+    int status = 0;
+
+    while (!quit_requested) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(scheduler_check_period));
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (run_options.statsEvery > 0 && elapsed >= next_stats) {
+            printHeadlessStats("", elapsed, last_tick, last_time);
+            next_stats += run_options.statsEvery;
+        }
+
+        if (run_options.duration > 0 && elapsed >= run_options.duration) {
+            break;
+        }
+        if (replayer.active() && replayer.finished() && run_options.duration == 0) {
+            printf("Replay finished after %lu ticks\n", (unsigned long) replayer.recordCount());
+            break;
+        }
+        if (!hdWaitForCompletion(gSchedulerCallback, HD_WAIT_CHECK_STATUS)) {
+            fprintf(stderr, "The main scheduler callback has exited\n");
+            status = -1;
+            break;
+        }
+    }
+
+    // A last line for the whole run, so a soak test has its totals even with --stats-every=0.
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    last_tick = 0;
+    last_time = 0;
+    printHeadlessStats("Run: ", elapsed, last_tick, last_time);
+    return status;
+}
+
 /******************************************************************************
   This handler gets called when the process is exiting. Ensures that HDAPI is
   properly shutdown
@@ -436,6 +575,23 @@ void exitHandler()
 {
     hdStopScheduler();
     hdUnschedule(gSchedulerCallback);
+    physics_thread.stop();
+    if (physics_thread.droppedPlanes() > 0) {
+        fprintf(stderr, "Local model dropped %lu contact planes; it holds %d.\n",
+                physics_thread.droppedPlanes(), kMaxContactPlanes);
+    }
+    if (broadphase.droppedPairs() > 0) {
+        fprintf(stderr, "Broadphase dropped %lu sphere pairs past its capacity of %lu.\n",
+                broadphase.droppedPairs(), (unsigned long) body_pairs.capacity());
+    }
+    if (!sparse_sdf.empty()) {
+        sparse_sdf.stopPrefetch();
+        fprintf(stderr, "Distance bricks: %llu servo lookups, %llu before the prefetcher reached them\n",
+                (unsigned long long) sparse_sdf.lookups(), (unsigned long long) sparse_sdf.coldLookups());
+    }
+    recorder.close();
+    telemetry.close();
+    rtReport(stderr);
 
     if (ghHD != HD_INVALID_HANDLE)
     {
@@ -445,13 +601,110 @@ void exitHandler()
 }
 
 /******************************************************************************
-  Main function.
+  Reads the options, opens the device and creates the scene. Everything the
+  haptic loop needs is set up, but the scheduler is not started. Returns
+  false on a bad option or file; device errors exit.
  ******************************************************************************/
-int main(int argc, char* argv[])
+bool initDynamicObjects(int& argc, char* argv[])
 {
     HDErrorInfo error;
 
-    printf("Starting application\n");
+    if (!parseRunOptions(argc, argv, run_options)) {
+        return false;
+    }
+    if (run_options.scenePath != NULL) {
+        if (!loadScene(run_options.scenePath)) {
+            return false;
+        }
+    }
+    if (run_options.meshPath != NULL) {
+        const double start = monotonicSeconds();
+        if (!mesh.loadObj(run_options.meshPath, mesh_scale, mesh_offset)) {
+            return false;
+        }
+        mesh_proxy.init(&mesh, proxy_radius);
+        printf("Mesh %s: %d triangles, loaded in %.1f ms\n", run_options.meshPath, mesh.triangleCount(),
+               (monotonicSeconds() - start) * 1000);
+    }
+    if (run_options.bakeSdfPath != NULL) {
+        if (mesh.empty()) {
+            fprintf(stderr, "--bake-sdf needs a --mesh to bake.\n");
+            return false;
+        }
+        hduVector3Dd lo, hi;
+        mesh.bounds(lo, hi);
+        const hduVector3Dd margin(sdf_margin, sdf_margin, sdf_margin);
+        const double start = monotonicSeconds();
+        if (sdf_bits == 0) {
+            DistanceGrid grid;
+            grid.bake(lo - margin, hi + margin, sdf_cell, [](const hduVector3Dd& p) { return mesh.signedDistance(p); });
+            const double seconds = monotonicSeconds() - start;
+            if (!grid.save(run_options.bakeSdfPath)) {
+                return false;
+            }
+            printf("Distance grid %s: %d x %d x %d points, %.1f MB, baked in %.2f s\n", run_options.bakeSdfPath,
+                   grid.size(0), grid.size(1), grid.size(2), grid.bytes() / 1048576.0, seconds);
+        }
+        else {
+            //The sparse grid is written to the file as it is baked, so its size is only bounded by the disk.
+            if (!SparseDistanceGrid::bake(run_options.bakeSdfPath, lo - margin, hi + margin, sdf_cell, sdf_band, sdf_bits,
+                                          [](const hduVector3Dd& p) { return mesh.signedDistance(p); })) {
+                return false;
+            }
+            const double seconds = monotonicSeconds() - start;
+            SparseDistanceGrid grid;
+            if (!grid.load(run_options.bakeSdfPath)) {
+                return false;
+            }
+            printf("Sparse distance grid %s: %d of %d x %d x %d bricks stored, %.1f MB, baked in %.2f s\n",
+                   run_options.bakeSdfPath, grid.storedBricks(), grid.brickCount(0), grid.brickCount(1),
+                   grid.brickCount(2), grid.bytes() / 1048576.0, seconds);
+        }
+        exit(0);
+    }
+    if (run_options.sdfPath != NULL && SparseDistanceGrid::isSparseGrid(run_options.sdfPath)) {
+        if (!sparse_sdf.load(run_options.sdfPath)) {
+            return false;
+        }
+        printf("Sparse distance grid %s: %d bricks at %.2f mm, %d bit, %.1f MB mapped\n", run_options.sdfPath,
+               sparse_sdf.storedBricks(), sparse_sdf.cellSize(), sparse_sdf.bits(), sparse_sdf.bytes() / 1048576.0);
+        //The prefetcher starts around the origin and follows the HIP once the haptic loop reports it.
+        sparse_sdf.startPrefetch(local_model_margin, sdf_prefetch_lookahead);
+    }
+    else if (run_options.sdfPath != NULL) {
+        const double start = monotonicSeconds();
+        if (!sdf_grid.load(run_options.sdfPath)) {
+            return false;
+        }
+        printf("Distance grid %s: %d x %d x %d points at %.2f mm, loaded in %.1f ms\n", run_options.sdfPath,
+               sdf_grid.size(0), sdf_grid.size(1), sdf_grid.size(2), sdf_grid.cellSize(),
+               (monotonicSeconds() - start) * 1000);
+    }
+    if (run_options.replayPath != NULL) {
+        if (!replayer.open(run_options.replayPath)) {
+            return false;
+        }
+        run_options.servoRate = replayer.servoRate();
+        printf("Replaying %lu ticks from %s\n", (unsigned long) replayer.recordCount(), run_options.replayPath);
+    }
+    if (run_options.recordPath != NULL) {
+        if (!recorder.open(run_options.recordPath, run_options.servoRate)) {
+            return false;
+        }
+        printf("Recording to %s\n", run_options.recordPath);
+    }
+    if (run_options.telemetryPath != NULL) {
+        if (!telemetry.open(run_options.telemetryPath, run_options.telemetryEvery)) {
+            return false;
+        }
+    }
+    printf("Integrator: %s, %d substep(s) per step\n", integratorName(run_options.integrator), run_options.substeps);
+    if (run_options.physicsRate > 0) {
+        printf("Servo loop at %d Hz, physics thread at %d Hz\n", run_options.servoRate, run_options.physicsRate);
+    }
+    else {
+        printf("Servo loop at %d Hz, physics in the servo loop\n", run_options.servoRate);
+    }
 
     atexit(exitHandler);
 
@@ -471,6 +724,51 @@ int main(int argc, char* argv[])
     hdEnable(HD_FORCE_OUTPUT);
     hdEnable(HD_MAX_FORCE_CLAMPING);
 
+    // Create the dynamic spheres before the haptic loop starts so their arrays are never resized while it runs.
+    InitSimulation(run_options);
+
+    // Size the snapshots the same way, and start them all at the initial state so the first frames have something to draw.
+    for (int i = 0; i < 3; ++i) {
+        world_snapshot.slot(i).resize(bodies.count());
+        world_snapshot.slot(i).bodies.capture(bodies);
+        world_snapshot.slot(i).solveProxies(world_snapshot.slot(i).hipPosition, bodies);
+    }
+
+    // With --rt, lock and prefault memory now that everything the haptic loop uses is allocated.
+    if (run_options.realtime.enabled) {
+        printf("Real-time mode\n");
+        rtSetupProcess(run_options.realtime);
+    }
+
+    if (run_options.servoRate != 1000) {
+        hdSetSchedulerRate(run_options.servoRate);
+        if (HD_DEVICE_ERROR(error = hdGetError()))
+        {
+            hduPrintError(stderr, &error, "Failed to set the servo loop rate");
+            fprintf(stderr, "\nPress any key to quit.\n");
+            getchar();
+            exit(-1);
+        }
+    }
+
+    return true;
+}
+
+/******************************************************************************
+  Main function.
+ ******************************************************************************/
+#ifndef SERVO_BENCH
+
+int main(int argc, char* argv[])
+{
+    HDErrorInfo error;
+
+    printf("Starting application\n");
+
+    if (!initDynamicObjects(argc, argv)) {
+        return -1;
+    }
+
     hdStartScheduler();
     if (HD_DEVICE_ERROR(error = hdGetError()))
     {
@@ -480,6 +778,13 @@ int main(int argc, char* argv[])
         exit(-1);
     }
 
+    // Without a window nothing below touches GLUT or OpenGL, so this runs on machines with no display.
+    if (run_options.headless) {
+        const int status = DynamicObjectsHeadless();
+        printf("Done\n");
+        return status;
+    }
+
     initGlut(argc, argv);
 
     // Get the workspace dimensions.
@@ -499,4 +804,23 @@ int main(int argc, char* argv[])
     return 0;
 }
 
+#else
+
+// Servo loop benchmark: runs DynamicObjectsCallback on the simulated device without graphics.
+int main(int argc, char* argv[])
+{
+    ServoBenchOptions bench;
+    if (!parseServoBenchOptions(argc, argv, bench) || !initDynamicObjects(argc, argv)) {
+        return -1;
+    }
+
+    if (run_options.physicsRate > 0) {
+        physics_thread.start(run_options.physicsRate, run_options.substeps);
+    }
+
+    return runServoBench(bench, DynamicObjectsCallback, 0);
+}
+
+#endif
+
 /******************************************************************************/
\ No newline at end of file
@@ -0,0 +1,694 @@
+/*****************************************************************************
+
+Module Name:
+
+  mesh.cpp
+
+Description:
+
+  Triangle mesh loading, BVH construction and proximity queries.
+
+*******************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "mesh.h"
+
+namespace
+{
+
+// Triangles per leaf. Small leaves keep the exact tests few; the tree is
+// shallow enough either way for the traversal stack below.
+const int kLeafSize = 4;
+
+// Deep enough for a median split tree of any mesh that fits in memory.
+const int kBvhStackSize = 64;
+
+struct BuildItem
+{
+    float lo[3], hi[3];
+    float centroid[3];
+    int triangle;
+};
+
+struct CentroidLess
+{
+    int axis;
+    bool operator()(const BuildItem& a, const BuildItem& b) const
+    {
+        return a.centroid[axis] < b.centroid[axis];
+    }
+};
+
+/* Squared distance from p to the box, 0 inside. */
+double boxDistanceSquared(const BvhNode& node, const hduVector3Dd& p)
+{
+    double d2 = 0;
+    for (int i = 0; i < 3; ++i)
+    {
+        double d = 0;
+        if (p[i] < node.lo[i])
+        {
+            d = node.lo[i] - p[i];
+        }
+        else if (p[i] > node.hi[i])
+        {
+            d = p[i] - node.hi[i];
+        }
+        d2 += d * d;
+    }
+    return d2;
+}
+
+bool excluded(int triangle, const int* exclude, int excludeCount)
+{
+    for (int i = 0; i < excludeCount; ++i)
+    {
+        if (exclude[i] == triangle)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Distance along the ray o + t d (d unit) at which it enters the box grown
+   by radius, or a negative value if it misses it. */
+double rayBoxEntry(const BvhNode& node, const hduVector3Dd& o, const hduVector3Dd& d, double radius)
+{
+    double enter = 0, leave = 1e300;
+    for (int i = 0; i < 3; ++i)
+    {
+        const double lo = node.lo[i] - radius;
+        const double hi = node.hi[i] + radius;
+        if (fabs(d[i]) < 1e-12)
+        {
+            if (o[i] < lo || o[i] > hi)
+            {
+                return -1;
+            }
+            continue;
+        }
+        double t0 = (lo - o[i]) / d[i];
+        double t1 = (hi - o[i]) / d[i];
+        if (t0 > t1)
+        {
+            std::swap(t0, t1);
+        }
+        enter = std::max(enter, t0);
+        leave = std::min(leave, t1);
+        if (enter > leave)
+        {
+            return -1;
+        }
+    }
+    return enter;
+}
+
+/* First t >= 0 at which the ray o + t d (d unit), starting outside, comes
+   within radius of the point v; best if it never does before best. */
+double sweepPoint(const hduVector3Dd& o, const hduVector3Dd& d, double radius, const hduVector3Dd& v, double best)
+{
+    const hduVector3Dd m = o - v;
+    const double b = dotProduct(m, d);
+    const double c = dotProduct(m, m) - radius * radius;
+    if (b >= 0)
+    {
+        return best;
+    }
+    const double disc = b * b - c;
+    if (disc < 0)
+    {
+        return best;
+    }
+    const double t = -b - sqrt(disc);
+    return t >= 0 && t < best ? t : best;
+}
+
+/* Same for the segment from p to p + e, through its side; its ends are left
+   to sweepPoint. */
+double sweepEdge(const hduVector3Dd& o, const hduVector3Dd& d, double radius,
+                 const hduVector3Dd& p, const hduVector3Dd& e, double best)
+{
+    const hduVector3Dd m = o - p;
+    const double md = dotProduct(m, e);
+    const double nd = dotProduct(d, e);
+    const double ee = dotProduct(e, e);
+    const double a = ee - nd * nd;
+    if (a < 1e-12 * ee)
+    {
+        return best; // moving along the edge: only its ends can be hit
+    }
+    const double b = ee * dotProduct(m, d) - nd * md;
+    const double c = ee * (dotProduct(m, m) - radius * radius) - md * md;
+    const double disc = b * b - a * c;
+    if (b >= 0 || disc < 0)
+    {
+        return best;
+    }
+    const double t = (-b - sqrt(disc)) / a;
+    const double s = md + t * nd;
+    return t >= 0 && t < best && s >= 0 && s <= ee ? t : best;
+}
+
+/******************************************************************************
+ First t >= 0 at which a sphere of the given radius at o + t d touches the
+ triangle, or best if that is not before best: the ray against the triangle
+ grown by the radius, which is bounded by the two offset faces, three edge
+ cylinders and three vertex spheres.
+******************************************************************************/
+double sweepTriangle(const MeshTriangle& tri, const hduVector3Dd& o, const hduVector3Dd& d, double radius, double best)
+{
+    // Faces: only the side the sphere starts on, and only when moving towards it.
+    const double height = dotProduct(tri.normal, o - tri.a);
+    const double side = height >= 0 ? 1 : -1;
+    const double approach = dotProduct(tri.normal, d) * side;
+    if (approach < 0)
+    {
+        const double t = (height * side - radius) / -approach;
+        if (t >= 0 && t < best)
+        {
+            // Where the sphere touches the plane, in the triangle's barycentric coordinates.
+            const hduVector3Dd q = o + d * t - tri.normal * (radius * side) - tri.a;
+            const double d00 = dotProduct(tri.ab, tri.ab);
+            const double d01 = dotProduct(tri.ab, tri.ac);
+            const double d11 = dotProduct(tri.ac, tri.ac);
+            const double d20 = dotProduct(q, tri.ab);
+            const double d21 = dotProduct(q, tri.ac);
+            const double denom = d00 * d11 - d01 * d01;
+            const double v = (d11 * d20 - d01 * d21) / denom;
+            const double w = (d00 * d21 - d01 * d20) / denom;
+            if (v >= 0 && w >= 0 && v + w <= 1)
+            {
+                return t;
+            }
+        }
+    }
+
+    const hduVector3Dd b = tri.a + tri.ab;
+    const hduVector3Dd c = tri.a + tri.ac;
+    best = sweepEdge(o, d, radius, tri.a, tri.ab, best);
+    best = sweepEdge(o, d, radius, tri.a, tri.ac, best);
+    best = sweepEdge(o, d, radius, b, c - b, best);
+    best = sweepPoint(o, d, radius, tri.a, best);
+    best = sweepPoint(o, d, radius, b, best);
+    return sweepPoint(o, d, radius, c, best);
+}
+
+/* Parses the vertex index of an OBJ face corner ("7", "7/2", "7//3", or
+   negative, counting back from the last vertex). Returns -1 if bad. */
+int objVertexIndex(const char* token, int vertexCount)
+{
+    char* end = NULL;
+    const long index = strtol(token, &end, 10);
+    if (end == token || (*end != '\0' && *end != '/'))
+    {
+        return -1;
+    }
+    const long resolved = index > 0 ? index - 1 : vertexCount + index;
+    return resolved >= 0 && resolved < vertexCount ? (int) resolved : -1;
+}
+
+} // namespace
+
+/******************************************************************************
+ Closest point of a triangle (Ericson, Real-Time Collision Detection 5.1.5).
+******************************************************************************/
+hduVector3Dd closestPointOnTriangle(const MeshTriangle& t, const hduVector3Dd& p)
+{
+    const hduVector3Dd ap = p - t.a;
+    const double d1 = dotProduct(t.ab, ap);
+    const double d2 = dotProduct(t.ac, ap);
+    if (d1 <= 0 && d2 <= 0)
+    {
+        return t.a;
+    }
+
+    const hduVector3Dd bp = ap - t.ab;
+    const double d3 = dotProduct(t.ab, bp);
+    const double d4 = dotProduct(t.ac, bp);
+    if (d3 >= 0 && d4 <= d3)
+    {
+        return t.a + t.ab;
+    }
+
+    const double vc = d1 * d4 - d3 * d2;
+    if (vc <= 0 && d1 >= 0 && d3 <= 0)
+    {
+        return t.a + t.ab * (d1 / (d1 - d3));
+    }
+
+    const hduVector3Dd cp = ap - t.ac;
+    const double d5 = dotProduct(t.ab, cp);
+    const double d6 = dotProduct(t.ac, cp);
+    if (d6 >= 0 && d5 <= d6)
+    {
+        return t.a + t.ac;
+    }
+
+    const double vb = d5 * d2 - d1 * d6;
+    if (vb <= 0 && d2 >= 0 && d6 <= 0)
+    {
+        return t.a + t.ac * (d2 / (d2 - d6));
+    }
+
+    const double va = d3 * d6 - d5 * d4;
+    if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0)
+    {
+        const double w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+        return t.a + t.ab + (t.ac - t.ab) * w;
+    }
+
+    const double denom = 1 / (va + vb + vc);
+    return t.a + t.ab * (vb * denom) + t.ac * (vc * denom);
+}
+
+TriangleMesh::TriangleMesh()
+{
+}
+
+bool TriangleMesh::loadObj(const char* path, double scale, const hduVector3Dd& offset)
+{
+    FILE* file = fopen(path, "r");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Cannot open mesh '%s'.\n", path);
+        return false;
+    }
+
+    std::vector<hduVector3Dd> vertices;
+    std::vector<int> indices;
+    char line[1024];
+    int lineNumber = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file) != NULL)
+    {
+        ++lineNumber;
+        if (line[0] == 'v' && (line[1] == ' ' || line[1] == '\t'))
+        {
+            double x, y, z;
+            if (sscanf(line + 2, "%lf %lf %lf", &x, &y, &z) != 3)
+            {
+                fprintf(stderr, "%s:%d: bad vertex.\n", path, lineNumber);
+                ok = false;
+                break;
+            }
+            vertices.push_back(hduVector3Dd(x, y, z) * scale + offset);
+        }
+        else if (line[0] == 'f' && (line[1] == ' ' || line[1] == '\t'))
+        {
+            int corners[3];
+            int cornerCount = 0;
+            for (char* token = strtok(line + 2, " \t\r\n"); token != NULL; token = strtok(NULL, " \t\r\n"))
+            {
+                const int index = objVertexIndex(token, (int) vertices.size());
+                if (index < 0)
+                {
+                    fprintf(stderr, "%s:%d: bad face.\n", path, lineNumber);
+                    ok = false;
+                    break;
+                }
+                // Triangle fan around the first corner.
+                if (cornerCount < 3)
+                {
+                    corners[cornerCount++] = index;
+                }
+                else
+                {
+                    corners[1] = corners[2];
+                    corners[2] = index;
+                }
+                if (cornerCount == 3)
+                {
+                    indices.push_back(corners[0]);
+                    indices.push_back(corners[1]);
+                    indices.push_back(corners[2]);
+                }
+            }
+        }
+    }
+    fclose(file);
+    if (!ok)
+    {
+        return false;
+    }
+
+    create(vertices, indices);
+    if (m_triangles.empty())
+    {
+        fprintf(stderr, "Mesh '%s' has no triangles.\n", path);
+        return false;
+    }
+    return true;
+}
+
+/******************************************************************************
+ Top down median split on the longest axis of the centroid bounds. The
+ triangles are stored in leaf order, so each leaf is a contiguous run.
+ Degenerate triangles are dropped.
+******************************************************************************/
+void TriangleMesh::create(const std::vector<hduVector3Dd>& vertices, const std::vector<int>& indices)
+{
+    std::vector<MeshTriangle> triangles;
+    std::vector<BuildItem> items;
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        MeshTriangle t;
+        t.a = vertices[indices[i]];
+        t.ab = vertices[indices[i + 1]] - t.a;
+        t.ac = vertices[indices[i + 2]] - t.a;
+        t.normal = crossProduct(t.ab, t.ac);
+        const double area = t.normal.magnitude();
+        if (area <= 1e-12)
+        {
+            continue;
+        }
+        t.normal /= area;
+
+        BuildItem item;
+        for (int k = 0; k < 3; ++k)
+        {
+            const double b = t.a[k] + t.ab[k];
+            const double c = t.a[k] + t.ac[k];
+            item.lo[k] = (float) std::min(t.a[k], std::min(b, c));
+            item.hi[k] = (float) std::max(t.a[k], std::max(b, c));
+            item.centroid[k] = (float) ((t.a[k] + b + c) / 3);
+        }
+        item.triangle = (int) triangles.size();
+        triangles.push_back(t);
+        items.push_back(item);
+    }
+
+    m_triangles.clear();
+    m_nodes.clear();
+    if (items.empty())
+    {
+        return;
+    }
+    m_triangles.reserve(items.size());
+    m_nodes.reserve(2 * items.size() / kLeafSize + 1);
+
+    struct Range
+    {
+        int node;
+        int begin, end;
+    };
+    std::vector<Range> pending;
+    m_nodes.push_back(BvhNode());
+    Range root = { 0, 0, (int) items.size() };
+    pending.push_back(root);
+    while (!pending.empty())
+    {
+        const Range range = pending.back();
+        pending.pop_back();
+
+        BvhNode node;
+        float clo[3], chi[3];
+        for (int k = 0; k < 3; ++k)
+        {
+            node.lo[k] = clo[k] = items[range.begin].lo[k];
+            node.hi[k] = chi[k] = items[range.begin].hi[k];
+        }
+        for (int i = range.begin; i < range.end; ++i)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                node.lo[k] = std::min(node.lo[k], items[i].lo[k]);
+                node.hi[k] = std::max(node.hi[k], items[i].hi[k]);
+                clo[k] = std::min(clo[k], items[i].centroid[k]);
+                chi[k] = std::max(chi[k], items[i].centroid[k]);
+            }
+        }
+
+        if (range.end - range.begin <= kLeafSize)
+        {
+            node.first = (int) m_triangles.size();
+            node.count = range.end - range.begin;
+            for (int i = range.begin; i < range.end; ++i)
+            {
+                m_triangles.push_back(triangles[items[i].triangle]);
+            }
+            m_nodes[range.node] = node;
+            continue;
+        }
+
+        CentroidLess less;
+        less.axis = 0;
+        for (int k = 1; k < 3; ++k)
+        {
+            if (chi[k] - clo[k] > chi[less.axis] - clo[less.axis])
+            {
+                less.axis = k;
+            }
+        }
+        const int middle = (range.begin + range.end) / 2;
+        std::nth_element(items.begin() + range.begin, items.begin() + middle, items.begin() + range.end, less);
+
+        // The children are allocated side by side, so a node only needs the index of the first.
+        const int left = (int) m_nodes.size();
+        const int right = left + 1;
+        m_nodes.push_back(BvhNode());
+        m_nodes.push_back(BvhNode());
+        node.first = left;
+        node.count = 0;
+        m_nodes[range.node] = node;
+
+        Range rightRange = { right, middle, range.end };
+        Range leftRange = { left, range.begin, middle };
+        pending.push_back(rightRange);
+        pending.push_back(leftRange);
+    }
+}
+
+/******************************************************************************
+ Depth first, nearer child first, pruning boxes farther than the best hit so
+ far.
+******************************************************************************/
+MeshHit TriangleMesh::closest(const hduVector3Dd& p, double maxDistance,
+                              const int* exclude, int excludeCount) const
+{
+    MeshHit hit;
+    hit.triangle = -1;
+    hit.distance = maxDistance;
+    if (m_nodes.empty())
+    {
+        return hit;
+    }
+
+    double best2 = maxDistance * maxDistance;
+    int stack[kBvhStackSize];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const BvhNode& node = m_nodes[stack[--top]];
+        if (boxDistanceSquared(node, p) > best2)
+        {
+            continue;
+        }
+
+        if (node.count > 0)
+        {
+            for (int i = node.first; i < node.first + node.count; ++i)
+            {
+                if (excludeCount > 0 && excluded(i, exclude, excludeCount))
+                {
+                    continue;
+                }
+                const hduVector3Dd q = closestPointOnTriangle(m_triangles[i], p);
+                const hduVector3Dd d = p - q;
+                const double d2 = dotProduct(d, d);
+                if (d2 <= best2)
+                {
+                    best2 = d2;
+                    hit.triangle = i;
+                    hit.point = q;
+                }
+            }
+            continue;
+        }
+
+        const int left = node.first;
+        const int right = node.first + 1;
+        const bool leftFirst = boxDistanceSquared(m_nodes[left], p) <= boxDistanceSquared(m_nodes[right], p);
+        if (top + 2 <= kBvhStackSize)
+        {
+            stack[top++] = leftFirst ? right : left;
+            stack[top++] = leftFirst ? left : right;
+        }
+    }
+
+    if (hit.triangle >= 0)
+    {
+        hit.distance = sqrt(best2);
+    }
+    return hit;
+}
+
+/******************************************************************************
+ Nearer boxes first, pruning boxes the sphere would reach after its best
+ hit so far.
+******************************************************************************/
+double TriangleMesh::sweep(const hduVector3Dd& origin, const hduVector3Dd& direction, double length, double radius,
+                           const int* exclude, int excludeCount, int* hitTriangle) const
+{
+    double best = length;
+    int hit = -1;
+    if (!m_nodes.empty())
+    {
+        int stack[kBvhStackSize];
+        int top = 0;
+        if (rayBoxEntry(m_nodes[0], origin, direction, radius) >= 0)
+        {
+            stack[top++] = 0;
+        }
+        while (top > 0)
+        {
+            const BvhNode& node = m_nodes[stack[--top]];
+            if (node.count > 0)
+            {
+                for (int i = node.first; i < node.first + node.count; ++i)
+                {
+                    if (excludeCount > 0 && excluded(i, exclude, excludeCount))
+                    {
+                        continue;
+                    }
+                    const double t = sweepTriangle(m_triangles[i], origin, direction, radius, best);
+                    if (t < best)
+                    {
+                        best = t;
+                        hit = i;
+                    }
+                }
+                continue;
+            }
+
+            const double tLeft = rayBoxEntry(m_nodes[node.first], origin, direction, radius);
+            const double tRight = rayBoxEntry(m_nodes[node.first + 1], origin, direction, radius);
+            const bool leftFirst = tRight < 0 || (tLeft >= 0 && tLeft <= tRight);
+            if (top + 2 <= kBvhStackSize)
+            {
+                if (leftFirst)
+                {
+                    if (tRight >= 0 && tRight <= best)
+                    {
+                        stack[top++] = node.first + 1;
+                    }
+                    if (tLeft >= 0 && tLeft <= best)
+                    {
+                        stack[top++] = node.first;
+                    }
+                }
+                else
+                {
+                    if (tLeft >= 0 && tLeft <= best)
+                    {
+                        stack[top++] = node.first;
+                    }
+                    if (tRight >= 0 && tRight <= best)
+                    {
+                        stack[top++] = node.first + 1;
+                    }
+                }
+            }
+        }
+    }
+
+    if (hitTriangle != 0)
+    {
+        *hitTriangle = hit;
+    }
+    return best;
+}
+
+void TriangleMesh::bounds(hduVector3Dd& lo, hduVector3Dd& hi) const
+{
+    lo.set(0, 0, 0);
+    hi.set(0, 0, 0);
+    if (!m_nodes.empty())
+    {
+        lo.set(m_nodes[0].lo[0], m_nodes[0].lo[1], m_nodes[0].lo[2]);
+        hi.set(m_nodes[0].hi[0], m_nodes[0].hi[1], m_nodes[0].hi[2]);
+    }
+}
+
+/******************************************************************************
+ The sign comes from the normals of the triangles nearest to p. When the
+ nearest point is on an edge or a vertex, every triangle sharing it is
+ equally near, and their summed normals decide.
+******************************************************************************/
+double TriangleMesh::signedDistance(const hduVector3Dd& p) const
+{
+    const MeshHit nearest = closest(p, 1e300);
+    if (nearest.triangle < 0)
+    {
+        return 1e300;
+    }
+
+    MeshHit hits[16];
+    const double tolerance = 1e-6 * (1 + nearest.distance);
+    const int count = near(p, nearest.distance + tolerance, hits, 16);
+    hduVector3Dd normal = m_triangles[nearest.triangle].normal;
+    for (int i = 0; i < count; ++i)
+    {
+        if (hits[i].triangle != nearest.triangle && (hits[i].point - nearest.point).magnitude() <= tolerance)
+        {
+            normal += m_triangles[hits[i].triangle].normal;
+        }
+    }
+    return dotProduct(p - nearest.point, normal) >= 0 ? nearest.distance : -nearest.distance;
+}
+
+int TriangleMesh::near(const hduVector3Dd& p, double maxDistance, MeshHit* hits, int maxHits) const
+{
+    if (m_nodes.empty())
+    {
+        return 0;
+    }
+
+    const double max2 = maxDistance * maxDistance;
+    int count = 0;
+    int stack[kBvhStackSize];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0 && count < maxHits)
+    {
+        const BvhNode& node = m_nodes[stack[--top]];
+        if (boxDistanceSquared(node, p) > max2)
+        {
+            continue;
+        }
+
+        if (node.count > 0)
+        {
+            for (int i = node.first; i < node.first + node.count && count < maxHits; ++i)
+            {
+                const hduVector3Dd q = closestPointOnTriangle(m_triangles[i], p);
+                const hduVector3Dd d = p - q;
+                const double d2 = dotProduct(d, d);
+                if (d2 <= max2)
+                {
+                    hits[count].triangle = i;
+                    hits[count].point = q;
+                    hits[count].distance = sqrt(d2);
+                    ++count;
+                }
+            }
+            continue;
+        }
+
+        if (top + 2 <= kBvhStackSize)
+        {
+            stack[top++] = node.first;
+            stack[top++] = node.first + 1;
+        }
+    }
+    return count;
+}
+
+/******************************************************************************/
@@ -0,0 +1,105 @@
+/*****************************************************************************
+
+Module Name:
+
+  mesh.h
+
+Description:
+
+  Static triangle mesh with a bounding volume hierarchy, for haptic
+  queries between the HIP sphere and the mesh. The BVH is built once at
+  load time; its nodes and the triangles are stored flat, in traversal
+  order, and a query only walks them with a small fixed stack, so the
+  servo loop never allocates and touches O(log n) nodes for a mesh of n
+  triangles.
+
+*******************************************************************************/
+
+#ifndef Mesh_H_
+#define Mesh_H_
+
+#include <vector>
+
+#include <HDU/hduVector.h>
+
+/* A triangle with its edges and unit normal precomputed for the queries. */
+struct MeshTriangle
+{
+    hduVector3Dd a;
+    hduVector3Dd ab, ac; // b - a, c - a
+    hduVector3Dd normal;
+};
+
+/* Axis aligned box around a subtree. Leaves hold count triangles starting at
+   first; inner nodes have count 0 and their two children at first and
+   first + 1. */
+struct BvhNode
+{
+    float lo[3], hi[3];
+    int first;
+    int count;
+};
+
+/* The point of a mesh nearest to a query point. */
+struct MeshHit
+{
+    int triangle;       // -1 if nothing was found
+    hduVector3Dd point; // on the triangle
+    double distance;
+};
+
+class TriangleMesh
+{
+public:
+    TriangleMesh();
+
+    /* Loads the v and f records of a Wavefront OBJ file; polygons are split
+       into triangle fans, and other records are ignored. Vertices are
+       scaled, then offset. Prints a message and returns false if the file
+       cannot be read or has no triangles. */
+    bool loadObj(const char* path, double scale, const hduVector3Dd& offset);
+
+    /* Builds the mesh from vertices and three vertex indices per triangle,
+       counterclockwise seen from outside. */
+    void create(const std::vector<hduVector3Dd>& vertices, const std::vector<int>& indices);
+
+    bool empty() const { return m_triangles.empty(); }
+    int triangleCount() const { return (int) m_triangles.size(); }
+    const MeshTriangle& triangle(int i) const { return m_triangles[i]; }
+
+    /* Bounding box of the whole mesh. */
+    void bounds(hduVector3Dd& lo, hduVector3Dd& hi) const;
+
+    /* Distance from p to the mesh, negative inside it. The mesh should be
+       closed, with its triangles facing out. */
+    double signedDistance(const hduVector3Dd& p) const;
+
+    /* Nearest point of the mesh to p within maxDistance, skipping the
+       triangles listed in exclude. */
+    MeshHit closest(const hduVector3Dd& p, double maxDistance,
+                    const int* exclude = 0, int excludeCount = 0) const;
+
+    /* Sweeps a sphere of the given radius from origin along the unit
+       direction for up to length, skipping the triangles listed in exclude,
+       and returns how far it gets before touching a triangle (length if it
+       touches none). The sphere must start clear of every triangle it does
+       not skip. If hitTriangle is given, it is set to the triangle touched,
+       or -1. */
+    double sweep(const hduVector3Dd& origin, const hduVector3Dd& direction, double length, double radius,
+                 const int* exclude = 0, int excludeCount = 0, int* hitTriangle = 0) const;
+
+    /* Nearest point on each triangle within maxDistance of p, up to
+       maxHits of them; returns how many were found. */
+    int near(const hduVector3Dd& p, double maxDistance, MeshHit* hits, int maxHits) const;
+
+private:
+    std::vector<MeshTriangle> m_triangles;
+    std::vector<BvhNode> m_nodes;
+};
+
+/* Point of triangle t nearest to p. */
+hduVector3Dd closestPointOnTriangle(const MeshTriangle& t, const hduVector3Dd& p);
+
+#endif /* Mesh_H_ */
+
+/******************************************************************************/
@@ -0,0 +1,253 @@
+/*****************************************************************************
+
+Module Name:
+
+  options.cpp
+
+Description:
+
+  Startup options for the dynamic objects program.
+
+*******************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "options.h"
+
+RunOptions::RunOptions()
+    : integrator(INTEGRATOR_SEMI_IMPLICIT_EULER),
+      substeps(1),
+      servoRate(1000),
+      physicsRate(0),
+      frameRate(60),
+      headless(false),
+      duration(0),
+      statsEvery(1),
+      recordPath(NULL),
+      replayPath(NULL),
+      telemetryPath(NULL),
+      telemetryEvery(1),
+      scenePath(NULL),
+      meshPath(NULL),
+      sdfPath(NULL),
+      bakeSdfPath(NULL)
+{
+}
+
+namespace
+{
+
+/* Returns the value of a --name=value argument, or NULL if arg is not that
+   option. */
+const char* optionValue(const char* arg, const char* name)
+{
+    const size_t len = strlen(name);
+    if (strncmp(arg, "--", 2) != 0 ||
+        strncmp(arg + 2, name, len) != 0 ||
+        arg[2 + len] != '=')
+    {
+        return NULL;
+    }
+    return arg + 3 + len;
+}
+
+bool parsePositiveInt(const char* value, int* result)
+{
+    char* end = NULL;
+    const long v = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || v <= 0)
+    {
+        return false;
+    }
+    *result = (int) v;
+    return true;
+}
+
+bool parseNonNegativeInt(const char* value, int* result)
+{
+    if (strcmp(value, "0") == 0)
+    {
+        *result = 0;
+        return true;
+    }
+    return parsePositiveInt(value, result);
+}
+
+} // namespace
+
+/******************************************************************************
+ Parses and strips the options this program understands.
+******************************************************************************/
+bool parseRunOptions(int& argc, char* argv[], RunOptions& options)
+{
+    if (!parseRealtimeOptions(argc, argv, options.realtime))
+    {
+        printRunOptionsUsage(stderr);
+        return false;
+    }
+
+    int kept = 1;
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        const char* value = NULL;
+
+        if ((value = optionValue(arg, "integrator")) != NULL)
+        {
+            if (!parseIntegratorType(value, &options.integrator))
+            {
+                fprintf(stderr, "Unknown integrator '%s'.\n", value);
+                printRunOptionsUsage(stderr);
+                return false;
+            }
+        }
+        else if ((value = optionValue(arg, "substeps")) != NULL)
+        {
+            if (!parsePositiveInt(value, &options.substeps))
+            {
+                fprintf(stderr, "Bad substep count '%s'.\n", value);
+                printRunOptionsUsage(stderr);
+                return false;
+            }
+        }
+        else if ((value = optionValue(arg, "servo-hz")) != NULL)
+        {
+            // The rates hdSetSchedulerRate accepts.
+            if (!parsePositiveInt(value, &options.servoRate) ||
+                (options.servoRate != 1000 && options.servoRate != 2000 &&
+                 options.servoRate != 4000 && options.servoRate != 8000))
+            {
+                fprintf(stderr, "Bad servo rate '%s'.\n", value);
+                printRunOptionsUsage(stderr);
+                return false;
+            }
+        }
+        else if ((value = optionValue(arg, "physics-hz")) != NULL)
+        {
+            if (!parseNonNegativeInt(value, &options.physicsRate))
+            {
+                fprintf(stderr, "Bad physics rate '%s'.\n", value);
+                printRunOptionsUsage(stderr);
+                return false;
+            }
+        }
+        else if ((value = optionValue(arg, "fps")) != NULL)
+        {
+            if (!parseNonNegativeInt(value, &options.frameRate))
+            {
+                fprintf(stderr, "Bad frame rate '%s'.\n", value);
+                printRunOptionsUsage(stderr);
+                return false;
+            }
+        }
+        else if (strcmp(arg, "--headless") == 0)
+        {
+            options.headless = true;
+        }
+        else if ((value = optionValue(arg, "duration")) != NULL)
+        {
+            if (!parseNonNegativeInt(value, &options.duration))
+            {
+                fprintf(stderr, "Bad duration '%s'.\n", value);
+                printRunOptionsUsage(stderr);
+                return false;
+            }
+        }
+        else if ((value = optionValue(arg, "stats-every")) != NULL)
+        {
+            if (!parseNonNegativeInt(value, &options.statsEvery))
+            {
+                fprintf(stderr, "Bad stats interval '%s'.\n", value);
+                printRunOptionsUsage(stderr);
+                return false;
+            }
+        }
+        else if ((value = optionValue(arg, "record")) != NULL && *value != '\0')
+        {
+            options.recordPath = value;
+        }
+        else if ((value = optionValue(arg, "replay")) != NULL && *value != '\0')
+        {
+            options.replayPath = value;
+        }
+        else if ((value = optionValue(arg, "telemetry")) != NULL && *value != '\0')
+        {
+            options.telemetryPath = value;
+        }
+        else if ((value = optionValue(arg, "telemetry-every")) != NULL)
+        {
+            if (!parsePositiveInt(value, &options.telemetryEvery))
+            {
+                fprintf(stderr, "Bad telemetry interval '%s'.\n", value);
+                printRunOptionsUsage(stderr);
+                return false;
+            }
+        }
+        else if ((value = optionValue(arg, "scene")) != NULL && *value != '\0')
+        {
+            options.scenePath = value;
+        }
+        else if ((value = optionValue(arg, "mesh")) != NULL && *value != '\0')
+        {
+            options.meshPath = value;
+        }
+        else if ((value = optionValue(arg, "sdf")) != NULL && *value != '\0')
+        {
+            options.sdfPath = value;
+        }
+        else if ((value = optionValue(arg, "bake-sdf")) != NULL && *value != '\0')
+        {
+            options.bakeSdfPath = value;
+        }
+        else if (strcmp(arg, "--help") == 0)
+        {
+            printRunOptionsUsage(stdout);
+            exit(0);
+        }
+        else
+        {
+            argv[kept++] = argv[i];
+        }
+    }
+
+    argc = kept;
+    argv[argc] = NULL;
+    return true;
+}
+
+void printRunOptionsUsage(FILE* stream)
+{
+    fprintf(stream,
+        "Options:\n"
+        "  --integrator=NAME  euler, semi-implicit (default), verlet, rk4 or implicit\n"
+        "  --substeps=N       integration steps per haptic tick or physics update (default 1)\n"
+        "  --scene=FILE       load the scene parameters and spheres from FILE (see scene.h);\n"
+        "                     it is compiled to FILE.bin, which later runs map directly\n"
+        "  --mesh=FILE        add the triangle mesh in the OBJ file FILE to the scene\n"
+        "  --bake-sdf=FILE    bake the signed distance grid of the --mesh to FILE and exit;\n"
+        "                     dense, or sparse with the sdf_bits scene setting\n"
+        "  --sdf=FILE         render the distance grid in FILE instead of the mesh proxy;\n"
+        "                     a --mesh is then only drawn\n"
+        "  --servo-hz=N       haptic servo loop rate: 1000 (default), 2000, 4000 or 8000\n"
+        "  --physics-hz=N     step the spheres on a separate thread N times a second and\n"
+        "                     render a local contact model in the servo loop; 0 (default)\n"
+        "                     steps them inside the servo loop\n"
+        "  --fps=N            draw at most N frames a second, and only when the spheres or\n"
+        "                     the HIP moved, sleeping in between (default 60); 0 redraws\n"
+        "                     continuously\n"
+        "  --headless         run the simulation without a window, printing a status\n"
+        "                     line every --stats-every seconds; SIGINT or SIGTERM ends it\n"
+        "  --duration=S       end a headless run after S seconds; 0 (default) runs until\n"
+        "                     interrupted, or until a --replay ends\n"
+        "  --stats-every=S    seconds between headless status lines, 0 for none (default 1)\n"
+        "  --record=FILE      record the HIP position and force of every servo tick\n"
+        "  --replay=FILE      feed the HIP positions of a recording to the servo loop\n"
+        "                     instead of the device's, at the recorded servo rate\n"
+        "  --telemetry=FILE   write the HIP and sphere state of every servo tick to FILE\n"
+        "                     as CSV, or to the console for \"-\"\n"
+        "  --telemetry-every=N  keep one tick in N, e.g. 300 for the console (default 1)\n");
+    printRealtimeOptionsUsage(stream);
+}
+
+/******************************************************************************/
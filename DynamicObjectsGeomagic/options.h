@@ -0,0 +1,87 @@
+/*****************************************************************************
+
+Module Name:
+
+  options.h
+
+Description:
+
+  Startup options for the dynamic objects program, read from the command
+  line before GLUT sees it.
+
+*******************************************************************************/
+
+#ifndef Options_H_
+#define Options_H_
+
+#include <stdio.h>
+
+#include "integrator.h"
+#include "realtime.h"
+
+struct RunOptions
+{
+    // Integration scheme for the dynamic spheres.
+    IntegratorType integrator;
+
+    // Integration steps per haptic tick, or per physics update when the physics thread runs.
+    int substeps;
+
+    // Haptic servo loop rate (Hz).
+    int servoRate;
+
+    // Physics thread update rate (Hz), or 0 to step the spheres inside the haptic loop.
+    int physicsRate;
+
+    // Most frames drawn per second, or 0 to redraw whenever GLUT is idle.
+    int frameRate;
+
+    // Run without a window: no GLUT and no OpenGL calls.
+    bool headless;
+
+    // Seconds a headless run lasts, or 0 to run until interrupted (or a replay ends).
+    int duration;
+
+    // Seconds between the status lines of a headless run, or 0 for none.
+    int statsEvery;
+
+    // File to record the session to, or NULL.
+    const char* recordPath;
+
+    // Recording to replay instead of reading the device position, or NULL.
+    const char* replayPath;
+
+    // File to write per tick telemetry to ("-" for the console), or NULL.
+    const char* telemetryPath;
+
+    // Telemetry keeps one servo tick in this many.
+    int telemetryEvery;
+
+    // Scene file to load over the defaults in scene.h, or NULL.
+    const char* scenePath;
+
+    // Wavefront OBJ mesh to add to the scene, or NULL.
+    const char* meshPath;
+
+    // Distance grid to render instead of the mesh proxy, or NULL.
+    const char* sdfPath;
+
+    // File to bake the distance grid of the mesh to before exiting, or NULL.
+    const char* bakeSdfPath;
+
+    // Real-time setup of the process and the servo thread (--rt).
+    RealtimeOptions realtime;
+
+    RunOptions();
+};
+
+/* Reads the options this program understands (all of the form
+   --name=value) and removes them from argv, leaving the rest for GLUT.
+   Prints a message and returns false on a bad option. */
+bool parseRunOptions(int& argc, char* argv[], RunOptions& options);
+
+void printRunOptionsUsage(FILE* stream);
+
+#endif /* Options_H_ */
+
+/******************************************************************************/
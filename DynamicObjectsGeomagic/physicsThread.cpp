@@ -0,0 +1,141 @@
+/*****************************************************************************
+
+Module Name:
+
+  physicsThread.cpp
+
+Description:
+
+  Fixed rate physics thread and the haptic side of its local model.
+
+*******************************************************************************/
+
+#include <chrono>
+
+#include "monotonicClock.h"
+#include "physicsThread.h"
+#include "scene.h"
+#include "simulation.h"
+
+PhysicsThread::PhysicsThread()
+    : m_running(false),
+      m_stop(false),
+      m_droppedPlanes(0),
+      m_period(0),
+      m_substeps(1)
+{
+}
+
+PhysicsThread::~PhysicsThread()
+{
+    stop();
+}
+
+void PhysicsThread::start(int rateHz, int substeps)
+{
+    stop();
+    m_period = 1.0 / rateHz;
+    m_substeps = substeps;
+    for (int i = 0; i < 3; ++i)
+    {
+        m_bodyStates.slot(i).resize(bodies.count());
+        m_bodyStates.slot(i).capture(bodies);
+    }
+    m_stop.store(false);
+    m_droppedPlanes.store(0);
+    m_running.store(true, std::memory_order_release);
+    m_thread = std::thread(&PhysicsThread::run, this);
+}
+
+void PhysicsThread::stop()
+{
+    if (m_thread.joinable())
+    {
+        m_stop.store(true);
+        m_thread.join();
+    }
+    m_running.store(false, std::memory_order_release);
+}
+
+/******************************************************************************
+ Physics loop. Updates are released on absolute deadlines so the rate does
+ not drift; an update that overruns its period pushes the schedule back
+ instead of being followed by a burst of catch-up updates.
+******************************************************************************/
+void PhysicsThread::run()
+{
+    typedef std::chrono::steady_clock Clock;
+    const Clock::duration period =
+        std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(m_period));
+
+    bool haveHip = false;
+    Clock::time_point deadline = Clock::now();
+    while (!m_stop.load(std::memory_order_relaxed))
+    {
+        // Nothing to simulate against until the haptic loop has reported the HIP once.
+        haveHip = m_hip.update() || haveHip;
+        if (haveHip)
+        {
+            const hduVector3Dd hipPosition = m_hip.readBuffer();
+            StepSimulation(hipPosition, m_period, m_substeps);
+
+            LocalModel& model = m_model.writeBuffer();
+            BuildLocalModel(hipPosition, local_model_margin, model);
+            if (model.droppedPlanes > 0)
+            {
+                m_droppedPlanes.fetch_add(model.droppedPlanes, std::memory_order_relaxed);
+            }
+            model.publishTime = monotonicSeconds();
+            m_model.publish();
+
+            m_bodyStates.writeBuffer().capture(bodies);
+            m_bodyStates.publish();
+        }
+
+        deadline += period;
+        const Clock::time_point now = Clock::now();
+        if (deadline < now)
+        {
+            deadline = now;
+        }
+        std::this_thread::sleep_until(deadline);
+    }
+}
+
+/******************************************************************************
+ The force is blended from the previous model into the newest one over one
+ physics period after it was published, so a model update changes the
+ force gradually instead of in a step at the physics rate.
+******************************************************************************/
+hduVector3Dd PhysicsThread::hapticForce(const hduVector3Dd& position)
+{
+    m_hip.writeBuffer() = position;
+    m_hip.publish();
+
+    if (m_model.fresh())
+    {
+        m_previous = m_model.readBuffer();
+        m_model.update();
+    }
+    const LocalModel& current = m_model.readBuffer();
+
+    double alpha = (monotonicSeconds() - current.publishTime) / m_period;
+    if (alpha > 1)
+    {
+        alpha = 1;
+    }
+    else if (alpha < 0)
+    {
+        alpha = 0;
+    }
+    return evaluateLocalModel(m_previous, position) * (1 - alpha) +
+           evaluateLocalModel(current, position) * alpha;
+}
+
+const BodyStates& PhysicsThread::bodyStates()
+{
+    m_bodyStates.update();
+    return m_bodyStates.readBuffer();
+}
+
+/******************************************************************************/
@@ -0,0 +1,79 @@
+/*****************************************************************************
+
+Module Name:
+
+  physicsThread.h
+
+Description:
+
+  Runs the sphere simulation on its own thread at a fixed rate, decoupled
+  from the haptic loop. Each update publishes the new sphere states and a
+  local model of the scene around the HIP; the haptic loop renders that
+  model at the servo rate and hands the HIP position back. The two threads
+  only meet through wait-free triple buffers, so an expensive physics
+  update never delays a servo tick.
+
+*******************************************************************************/
+
+#ifndef PhysicsThread_H_
+#define PhysicsThread_H_
+
+#include <atomic>
+#include <thread>
+
+#include <HDU/hduVector.h>
+
+#include "localModel.h"
+#include "snapshot.h"
+#include "tripleBuffer.h"
+
+class PhysicsThread
+{
+public:
+    PhysicsThread();
+    ~PhysicsThread();
+
+    /* Starts stepping the simulation rateHz times a second, each update
+       split into the given number of integrator substeps. Call it before
+       the haptic loop is scheduled: from then on only this thread steps
+       the spheres. */
+    void start(int rateHz, int substeps);
+    void stop();
+
+    /* Safe to call from the haptic loop. */
+    bool running() const { return m_running.load(std::memory_order_acquire); }
+
+    /* Haptic loop side: publishes the HIP position for the next physics
+       update and returns the force of the local model on the HIP. */
+    hduVector3Dd hapticForce(const hduVector3Dd& position);
+
+    /* Haptic loop side: sphere states after the latest physics update. */
+    const BodyStates& bodyStates();
+
+    /* Sphere planes left out of local models that were full, over the run. */
+    unsigned long droppedPlanes() const { return m_droppedPlanes.load(); }
+
+private:
+    void run();
+
+    TripleBuffer<hduVector3Dd> m_hip;
+    TripleBuffer<LocalModel> m_model;
+    TripleBuffer<BodyStates> m_bodyStates;
+
+    // Model replaced by the one in m_model's read slot, used by the haptic loop only.
+    LocalModel m_previous;
+
+    std::thread m_thread;
+    std::atomic<bool> m_running; // set before the thread starts, cleared after it is joined
+    std::atomic<bool> m_stop;
+    std::atomic<unsigned long> m_droppedPlanes;
+    double m_period;
+    int m_substeps;
+
+    PhysicsThread(const PhysicsThread&);
+    PhysicsThread& operator=(const PhysicsThread&);
+};
+
+#endif /* PhysicsThread_H_ */
+
+/******************************************************************************/
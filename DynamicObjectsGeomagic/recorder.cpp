@@ -0,0 +1,178 @@
+/*****************************************************************************
+
+Module Name:
+
+  recorder.cpp
+
+Description:
+
+  Binary session recorder and replayer.
+
+*******************************************************************************/
+
+#include <string.h>
+
+#include "monotonicClock.h"
+#include "recorder.h"
+
+Recorder::Recorder()
+    : m_file(NULL), m_unwritten(0), m_startTime(0), m_started(false)
+{
+}
+
+Recorder::~Recorder()
+{
+    close();
+}
+
+bool Recorder::open(const char* path, int servoRate)
+{
+    close();
+
+    m_file = fopen(path, "wb");
+    if (m_file == NULL)
+    {
+        fprintf(stderr, "Cannot create recording '%s'.\n", path);
+        return false;
+    }
+    // The writer already batches, and unbuffered writes fail on the batch they lose, so failures are counted exactly.
+    setvbuf(m_file, NULL, _IONBF, 0);
+
+    HipRecordHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kHipRecordMagic, sizeof(header.magic));
+    header.version = kHipRecordVersion;
+    header.recordSize = sizeof(HipRecord);
+    header.servoRate = (uint32_t) servoRate;
+    if (fwrite(&header, sizeof(header), 1, m_file) != 1)
+    {
+        fprintf(stderr, "Cannot write recording '%s'.\n", path);
+        fclose(m_file);
+        m_file = NULL;
+        return false;
+    }
+
+    m_unwritten.store(0);
+    m_started = false;
+    m_drain.start(kTickRingCapacity,
+                  [this](const HipRecord* records, size_t count) { write(records, count); });
+    return true;
+}
+
+void Recorder::close()
+{
+    if (m_file == NULL)
+    {
+        return;
+    }
+
+    m_drain.stop();
+    const bool flushed = fclose(m_file) == 0;
+    m_file = NULL;
+
+    if (m_drain.dropped() > 0)
+    {
+        fprintf(stderr, "Recording dropped %lu ticks.\n", m_drain.dropped());
+    }
+    if (m_unwritten.load() > 0 || !flushed)
+    {
+        fprintf(stderr, "Recording failed to write %lu ticks%s; the file is incomplete.\n",
+                m_unwritten.load(), flushed ? "" : " and its final flush");
+    }
+}
+
+/******************************************************************************
+ The time base starts at the first recorded tick.
+******************************************************************************/
+void Recorder::record(uint32_t tick, const hduVector3Dd& position, const hduVector3Dd& force)
+{
+    const double now = monotonicSeconds();
+    if (!m_started)
+    {
+        m_startTime = now;
+        m_started = true;
+    }
+
+    HipRecord record;
+    record.time = now - m_startTime;
+    record.tick = tick;
+    for (int i = 0; i < 3; ++i)
+    {
+        record.position[i] = position[i];
+        record.force[i] = (float) force[i];
+    }
+
+    m_drain.push(record);
+}
+
+/******************************************************************************
+ Writer thread side: moves a batch of records to the file.
+******************************************************************************/
+void Recorder::write(const HipRecord* records, size_t count)
+{
+    const size_t written = fwrite(records, sizeof(HipRecord), count, m_file);
+    if (written < count)
+    {
+        m_unwritten.fetch_add((unsigned long) (count - written), std::memory_order_relaxed);
+    }
+}
+
+Replayer::Replayer()
+    : m_next(0), m_servoRate(0)
+{
+}
+
+bool Replayer::open(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Cannot open recording '%s'.\n", path);
+        return false;
+    }
+
+    HipRecordHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, kHipRecordMagic, sizeof(header.magic)) != 0 ||
+        header.version != kHipRecordVersion ||
+        header.recordSize != sizeof(HipRecord))
+    {
+        fprintf(stderr, "'%s' is not a HIP recording.\n", path);
+        fclose(file);
+        return false;
+    }
+
+    m_records.clear();
+    HipRecord record;
+    while (fread(&record, sizeof(record), 1, file) == 1)
+    {
+        m_records.push_back(record);
+    }
+    fclose(file);
+
+    if (m_records.empty())
+    {
+        fprintf(stderr, "Recording '%s' has no ticks.\n", path);
+        return false;
+    }
+    m_servoRate = (int) header.servoRate;
+    m_next.store(0);
+    return true;
+}
+
+hduVector3Dd Replayer::next()
+{
+    size_t index = m_next.load(std::memory_order_relaxed);
+    if (index < m_records.size())
+    {
+        m_next.store(index + 1, std::memory_order_relaxed);
+    }
+    else
+    {
+        index = m_records.size() - 1;
+    }
+    const HipRecord& record = m_records[index];
+    return hduVector3Dd(record.position[0], record.position[1], record.position[2]);
+}
+
+/******************************************************************************/
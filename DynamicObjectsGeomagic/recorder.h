@@ -0,0 +1,120 @@
+/*****************************************************************************
+
+Module Name:
+
+  recorder.h
+
+Description:
+
+  Session recording and replay. The recorder streams one record per servo
+  tick (time, HIP position, force) to a binary file; the servo loop only
+  pushes into a ring buffer and a writer thread does the file I/O. The
+  replayer loads such a file and hands its positions back to the servo
+  loop one tick at a time, so a session can be rerun on identical input.
+
+  File layout, native byte order: a HipRecordHeader followed by one
+  HipRecord per tick.
+
+*******************************************************************************/
+
+#ifndef Recorder_H_
+#define Recorder_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <vector>
+
+#include <HDU/hduVector.h>
+
+#include "drainThread.h"
+
+const char kHipRecordMagic[8] = { 'H', 'I', 'P', 'R', 'E', 'C', '\0', '\0' };
+const uint32_t kHipRecordVersion = 1;
+
+struct HipRecordHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize; // sizeof(HipRecord), also catches byte order mismatches
+    uint32_t servoRate;  // Hz
+    uint32_t reserved;
+};
+
+struct HipRecord
+{
+    double time;        // seconds since recording started
+    double position[3]; // HIP position (mm)
+    float force[3];     // force rendered on the HIP that tick (N)
+    uint32_t tick;      // servo tick number, counting from 1
+};
+
+class Recorder
+{
+public:
+    Recorder();
+    ~Recorder();
+
+    /* Creates the file, writes its header and starts the writer thread.
+       Returns false if the file cannot be created. */
+    bool open(const char* path, int servoRate);
+
+    /* Stops the writer thread after it has written everything recorded,
+       and reports any ticks that were dropped or could not be written. */
+    void close();
+
+    bool active() const { return m_file != NULL; }
+
+    /* Servo loop side. Never blocks; a tick that finds the buffer full is
+       counted as dropped. */
+    void record(uint32_t tick, const hduVector3Dd& position, const hduVector3Dd& force);
+
+    unsigned long dropped() const { return m_drain.dropped(); }
+
+    /* Ticks lost to failed writes, e.g. on a full disk. */
+    unsigned long unwritten() const { return m_unwritten.load(); }
+
+private:
+    void write(const HipRecord* records, size_t count);
+
+    FILE* m_file;
+    DrainThread<HipRecord> m_drain;
+    std::atomic<unsigned long> m_unwritten;
+    double m_startTime;
+    bool m_started;
+
+    Recorder(const Recorder&);
+    Recorder& operator=(const Recorder&);
+};
+
+class Replayer
+{
+public:
+    Replayer();
+
+    /* Loads a whole recording. Prints a message and returns false if the
+       file is missing or not a recording. */
+    bool open(const char* path);
+
+    bool active() const { return !m_records.empty(); }
+
+    /* Servo rate the recording was made at. */
+    int servoRate() const { return m_servoRate; }
+
+    /* Servo loop side. Position of the next recorded tick; after the last
+       one the final position is held. */
+    hduVector3Dd next();
+
+    bool finished() const { return m_next.load() >= m_records.size(); }
+    size_t recordCount() const { return m_records.size(); }
+
+private:
+    std::vector<HipRecord> m_records;
+    std::atomic<size_t> m_next;
+    int m_servoRate;
+};
+
+#endif /* Recorder_H_ */
+
+/******************************************************************************/
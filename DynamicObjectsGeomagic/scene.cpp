@@ -0,0 +1,504 @@
+/*****************************************************************************
+
+Module Name:
+
+  scene.cpp
+
+Description:
+
+  Scene parameters, the scene file parser and its binary image.
+
+  Image layout, native byte order: a SceneImageHeader, the values of all
+  the parameters as doubles in kSceneParams order, then the SceneBody
+  records. The header carries the size and modification time of the text
+  file it was compiled from, and a hash of the parameter table and its
+  default values, so an image left behind by an edited scene file or by a
+  build with other parameters or defaults is ignored.
+
+*******************************************************************************/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+
+#if !defined(WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "monotonicClock.h"
+#include "scene.h"
+
+// HIP Parameters
+double proxy_radius = 5.0;
+float proxy_color[4] = { .8, .2, .2, .8 };
+
+// Box surface Parameters
+double wall_hip_k = 0.48;
+double wall_sphere_k = 4.00;
+double side_length = 200;
+float box_color[4] = { .2, .2, .8, .2 };
+
+// Object (big sphere) Parameters
+double sphere_k = 0.48;
+double sphere_damping = 0.002;
+double implicit_sphere_damping = 0.0;
+double sphere_mass = 0.005;
+double sphere_radius = 10.0;
+double sphere_sphere_k = 4.00;
+float sphere_color[4] = { .2, .8, .8, .8 };
+
+int body_count = 1;
+
+// State parameters
+hduVector3Dd sphere_start_pos(0, -60, -88);
+hduVector3Dd sphere_start_vel(-20, 0, 0);
+
+// Triangle mesh
+double mesh_k = 0.48;
+double mesh_scale = 1.0;
+hduVector3Dd mesh_offset(0, 0, 0);
+float mesh_color[4] = { .8, .8, .2, 1 };
+double sdf_cell = 1.0;
+double sdf_margin = 10.0;
+int sdf_bits = 0;
+double sdf_band = 12.0;
+
+double local_model_margin = 10.0;
+
+const SceneBody* scene_bodies = NULL;
+int scene_body_count = 0;
+
+namespace
+{
+
+enum SceneParamType
+{
+    PARAM_DOUBLE,
+    PARAM_FLOAT,
+    PARAM_INT,
+    PARAM_VECTOR
+};
+
+struct SceneParam
+{
+    const char* name;
+    SceneParamType type;
+    int count; // values on its line
+    void* value;
+};
+
+const SceneParam kSceneParams[] =
+{
+    { "proxy_radius",            PARAM_DOUBLE, 1, &proxy_radius },
+    { "proxy_color",             PARAM_FLOAT,  4, proxy_color },
+    { "wall_hip_k",              PARAM_DOUBLE, 1, &wall_hip_k },
+    { "wall_sphere_k",           PARAM_DOUBLE, 1, &wall_sphere_k },
+    { "side_length",             PARAM_DOUBLE, 1, &side_length },
+    { "box_color",               PARAM_FLOAT,  4, box_color },
+    { "sphere_k",                PARAM_DOUBLE, 1, &sphere_k },
+    { "sphere_damping",          PARAM_DOUBLE, 1, &sphere_damping },
+    { "implicit_sphere_damping", PARAM_DOUBLE, 1, &implicit_sphere_damping },
+    { "sphere_mass",             PARAM_DOUBLE, 1, &sphere_mass },
+    { "sphere_radius",           PARAM_DOUBLE, 1, &sphere_radius },
+    { "sphere_sphere_k",         PARAM_DOUBLE, 1, &sphere_sphere_k },
+    { "sphere_color",            PARAM_FLOAT,  4, sphere_color },
+    { "body_count",              PARAM_INT,    1, &body_count },
+    { "sphere_start_pos",        PARAM_VECTOR, 3, &sphere_start_pos },
+    { "sphere_start_vel",        PARAM_VECTOR, 3, &sphere_start_vel },
+    { "mesh_k",                  PARAM_DOUBLE, 1, &mesh_k },
+    { "mesh_scale",              PARAM_DOUBLE, 1, &mesh_scale },
+    { "mesh_offset",             PARAM_VECTOR, 3, &mesh_offset },
+    { "mesh_color",              PARAM_FLOAT,  4, mesh_color },
+    { "sdf_cell",                PARAM_DOUBLE, 1, &sdf_cell },
+    { "sdf_margin",              PARAM_DOUBLE, 1, &sdf_margin },
+    { "sdf_bits",                PARAM_INT,    1, &sdf_bits },
+    { "sdf_band",                PARAM_DOUBLE, 1, &sdf_band },
+    { "local_model_margin",      PARAM_DOUBLE, 1, &local_model_margin },
+};
+
+const int kSceneParamCount = sizeof(kSceneParams) / sizeof(kSceneParams[0]);
+
+const char kSceneImageMagic[8] = { 'S', 'C', 'E', 'N', 'E', 'I', 'M', 'G' };
+const uint32_t kSceneImageVersion = 2;
+
+struct SceneImageHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t layout;     // hash of the parameter table and the defaults
+    uint64_t sourceSize; // bytes, of the text file
+    int64_t sourceTime;  // modification time of the text file, seconds
+    int64_t sourceTimeNsec; // and nanoseconds
+    uint32_t valueCount; // doubles after the header
+    uint32_t bodyCount;  // SceneBody records after the values
+};
+
+// Bodies parsed from text, when the scene did not come from an image.
+std::vector<SceneBody> parsed_bodies;
+
+int sceneValueCount()
+{
+    int count = 0;
+    for (int i = 0; i < kSceneParamCount; ++i)
+    {
+        count += kSceneParams[i].count;
+    }
+    return count;
+}
+
+void setParam(const SceneParam& param, const double* values)
+{
+    for (int i = 0; i < param.count; ++i)
+    {
+        switch (param.type)
+        {
+        case PARAM_DOUBLE:
+            ((double*) param.value)[i] = values[i];
+            break;
+        case PARAM_FLOAT:
+            ((float*) param.value)[i] = (float) values[i];
+            break;
+        case PARAM_INT:
+            ((int*) param.value)[i] = (int) values[i];
+            break;
+        case PARAM_VECTOR:
+            (*(hduVector3Dd*) param.value)[i] = values[i];
+            break;
+        }
+    }
+}
+
+double getParam(const SceneParam& param, int i)
+{
+    switch (param.type)
+    {
+    case PARAM_DOUBLE:
+        return ((const double*) param.value)[i];
+    case PARAM_FLOAT:
+        return ((const float*) param.value)[i];
+    case PARAM_INT:
+        return ((const int*) param.value)[i];
+    default:
+        return (*(const hduVector3Dd*) param.value)[i];
+    }
+}
+
+/* FNV-1a over the names, value counts and current values of the
+   parameters. Taken before a scene is applied, the values are the
+   compiled-in defaults, so an image written by a build with a different
+   table, or with different defaults it would bake in, is not reused. */
+uint32_t sceneLayout()
+{
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < kSceneParamCount; ++i)
+    {
+        for (const char* c = kSceneParams[i].name; *c != '\0'; ++c)
+        {
+            hash = (hash ^ (unsigned char) *c) * 16777619u;
+        }
+        hash = (hash ^ (uint32_t) kSceneParams[i].count) * 16777619u;
+        for (int v = 0; v < kSceneParams[i].count; ++v)
+        {
+            const double value = getParam(kSceneParams[i], v);
+            const unsigned char* bytes = (const unsigned char*) &value;
+            for (size_t b = 0; b < sizeof(value); ++b)
+            {
+                hash = (hash ^ bytes[b]) * 16777619u;
+            }
+        }
+    }
+    return (hash ^ (uint32_t) sizeof(SceneBody)) * 16777619u;
+}
+
+/* Nanoseconds of the modification time, where the platform keeps them. */
+int64_t modifiedNsec(const struct stat& info)
+{
+#if defined(WIN32)
+    return 0;
+#else
+    return (int64_t) info.st_mtim.tv_nsec;
+#endif
+}
+
+/* Reads up to max numbers from the rest of a line. Returns how many there
+   were, or -1 if there is anything else on it. */
+int parseNumbers(char* text, double* values, int max)
+{
+    int count = 0;
+    for (char* token = strtok(text, " \t\r\n"); token != NULL; token = strtok(NULL, " \t\r\n"))
+    {
+        char* end = NULL;
+        const double v = strtod(token, &end);
+        if (end == token || *end != '\0' || count == max)
+        {
+            return -1;
+        }
+        values[count++] = v;
+    }
+    return count;
+}
+
+/******************************************************************************
+ Text scene files. Settings are applied as they are read, so a file with
+ an error leaves some applied; the program stops on it anyway.
+******************************************************************************/
+bool parseSceneText(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Cannot open scene '%s'.\n", path);
+        return false;
+    }
+
+    parsed_bodies.clear();
+    char line[512];
+    int lineNumber = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file) != NULL)
+    {
+        ++lineNumber;
+        char* comment = strchr(line, '#');
+        if (comment != NULL)
+        {
+            *comment = '\0';
+        }
+        const size_t length = strlen(line);
+        char* name = strtok(line, " \t\r\n");
+        if (name == NULL)
+        {
+            continue;
+        }
+        // The numbers start after the separator strtok overwrote, if the name did not end the line.
+        char* rest = name + strlen(name);
+        if (rest < line + length)
+        {
+            ++rest;
+        }
+
+        double values[8];
+        if (strcmp(name, "body") == 0)
+        {
+            if (parseNumbers(rest, values, 8) != 8 || values[6] <= 0 || values[7] <= 0)
+            {
+                fprintf(stderr, "%s:%d: a body is a position, a velocity, a mass and a radius, the last two positive.\n",
+                        path, lineNumber);
+                ok = false;
+                break;
+            }
+            SceneBody body;
+            for (int i = 0; i < 3; ++i)
+            {
+                body.position[i] = values[i];
+                body.velocity[i] = values[3 + i];
+            }
+            body.mass = values[6];
+            body.radius = values[7];
+            parsed_bodies.push_back(body);
+            continue;
+        }
+
+        int p = 0;
+        while (p < kSceneParamCount && strcmp(name, kSceneParams[p].name) != 0)
+        {
+            ++p;
+        }
+        if (p == kSceneParamCount)
+        {
+            fprintf(stderr, "%s:%d: unknown parameter '%s'.\n", path, lineNumber, name);
+            ok = false;
+            break;
+        }
+        if (parseNumbers(rest, values, 8) != kSceneParams[p].count)
+        {
+            fprintf(stderr, "%s:%d: %s takes %d number(s).\n", path, lineNumber, name, kSceneParams[p].count);
+            ok = false;
+            break;
+        }
+        setParam(kSceneParams[p], values);
+    }
+    fclose(file);
+
+    if (ok && (body_count < 1 || side_length <= 0 || proxy_radius <= 0 || sphere_mass <= 0 || sphere_radius <= 0))
+    {
+        fprintf(stderr, "%s: body_count, side_length, proxy_radius, sphere_mass and sphere_radius must be positive.\n", path);
+        ok = false;
+    }
+    return ok;
+}
+
+/* Writes the current parameters and the parsed bodies as the image of the
+   source file described by info, under the layout hash taken before the
+   text was parsed. */
+void writeSceneImage(const char* imagePath, const struct stat& info, uint32_t layout)
+{
+    SceneImageHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kSceneImageMagic, sizeof(header.magic));
+    header.version = kSceneImageVersion;
+    header.layout = layout;
+    header.sourceSize = (uint64_t) info.st_size;
+    header.sourceTime = (int64_t) info.st_mtime;
+    header.sourceTimeNsec = modifiedNsec(info);
+    header.valueCount = (uint32_t) sceneValueCount();
+    header.bodyCount = (uint32_t) parsed_bodies.size();
+
+    std::vector<double> values;
+    values.reserve(header.valueCount);
+    for (int p = 0; p < kSceneParamCount; ++p)
+    {
+        for (int i = 0; i < kSceneParams[p].count; ++i)
+        {
+            values.push_back(getParam(kSceneParams[p], i));
+        }
+    }
+
+    // Written under a temporary name, so a launch racing this one never maps half an image.
+    std::string tempPath = std::string(imagePath) + ".tmp";
+    FILE* file = fopen(tempPath.c_str(), "wb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Cannot write scene image '%s'.\n", imagePath);
+        return;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(&values[0], sizeof(double), values.size(), file) == values.size() &&
+              (parsed_bodies.empty() ||
+               fwrite(&parsed_bodies[0], sizeof(SceneBody), parsed_bodies.size(), file) == parsed_bodies.size());
+    ok = fclose(file) == 0 && ok;
+#if defined(WIN32)
+    remove(imagePath);
+#endif
+    if (!ok || rename(tempPath.c_str(), imagePath) != 0)
+    {
+        fprintf(stderr, "Cannot write scene image '%s'.\n", imagePath);
+        remove(tempPath.c_str());
+    }
+}
+
+/******************************************************************************
+ Maps the image of the source file described by info and applies it.
+ Returns false, leaving the parameters alone, if there is no image or it is
+ stale or damaged. On success the image stays mapped for the life of the
+ process, since scene_bodies points into it.
+******************************************************************************/
+bool mapSceneImage(const char* imagePath, const struct stat& info, uint32_t layout)
+{
+    const char* data = NULL;
+    size_t size = 0;
+
+#if defined(WIN32)
+    static std::vector<char> image;
+    FILE* file = fopen(imagePath, "rb");
+    if (file == NULL)
+    {
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    image.resize((size_t) ftell(file));
+    fseek(file, 0, SEEK_SET);
+    const bool read = image.empty() || fread(&image[0], 1, image.size(), file) == image.size();
+    fclose(file);
+    if (!read || image.empty())
+    {
+        return false;
+    }
+    data = &image[0];
+    size = image.size();
+#else
+    const int fd = open(imagePath, O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat imageInfo;
+    if (fstat(fd, &imageInfo) != 0 || imageInfo.st_size < (off_t) sizeof(SceneImageHeader))
+    {
+        close(fd);
+        return false;
+    }
+    size = (size_t) imageInfo.st_size;
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        return false;
+    }
+    data = (const char*) mapping;
+#endif
+
+    const SceneImageHeader* header = (const SceneImageHeader*) data;
+    const size_t valueCount = (size_t) sceneValueCount();
+    const bool valid = size >= sizeof(SceneImageHeader) &&
+        memcmp(header->magic, kSceneImageMagic, sizeof(header->magic)) == 0 &&
+        header->version == kSceneImageVersion &&
+        header->layout == layout &&
+        header->sourceSize == (uint64_t) info.st_size &&
+        header->sourceTime == (int64_t) info.st_mtime &&
+        header->sourceTimeNsec == modifiedNsec(info) &&
+        header->valueCount == valueCount &&
+        size == sizeof(SceneImageHeader) + valueCount * sizeof(double) + header->bodyCount * sizeof(SceneBody);
+    if (!valid)
+    {
+#if !defined(WIN32)
+        munmap((void*) data, size);
+#endif
+        return false;
+    }
+
+    const double* values = (const double*) (data + sizeof(SceneImageHeader));
+    for (int p = 0; p < kSceneParamCount; ++p)
+    {
+        setParam(kSceneParams[p], values);
+        values += kSceneParams[p].count;
+    }
+    scene_bodies = header->bodyCount > 0 ? (const SceneBody*) values : NULL;
+    scene_body_count = (int) header->bodyCount;
+    return true;
+}
+
+} // namespace
+
+/******************************************************************************
+ Loads a scene file, through its binary image when that is up to date.
+******************************************************************************/
+bool loadScene(const char* path)
+{
+    const double start = monotonicSeconds();
+
+    struct stat info;
+    if (stat(path, &info) != 0)
+    {
+        fprintf(stderr, "Cannot open scene '%s'.\n", path);
+        return false;
+    }
+    const std::string imagePath = std::string(path) + ".bin";
+    // Hashed before anything is applied, while the parameters still hold their defaults.
+    const uint32_t layout = sceneLayout();
+
+    const char* source = "image";
+    if (!mapSceneImage(imagePath.c_str(), info, layout))
+    {
+        if (!parseSceneText(path))
+        {
+            return false;
+        }
+        writeSceneImage(imagePath.c_str(), info, layout);
+        scene_bodies = parsed_bodies.empty() ? NULL : &parsed_bodies[0];
+        scene_body_count = (int) parsed_bodies.size();
+        source = "text";
+    }
+
+    printf("Scene %s: %d listed sphere(s), loaded from its %s in %.2f ms\n",
+           path, scene_body_count, source, (monotonicSeconds() - start) * 1000);
+    return true;
+}
+
+/******************************************************************************/
@@ -0,0 +1,100 @@
+/*****************************************************************************
+
+Module Name:
+
+  scene.h
+
+Description:
+
+  Parameters of the scene: the HIP, the box and the dynamic spheres. Shared
+  by the haptic loop, the physics thread and the graphics.
+
+  The values below are the defaults. A scene file (--scene=FILE) overrides
+  any of them at startup, before the haptic loop starts; they are not
+  changed after that. A scene file is text, one setting per line:
+
+      # comment
+      wall_hip_k 0.48
+      sphere_color .2 .8 .8 .8
+      sphere_start_pos 0 -60 -88
+      body 0 -60 -88  -20 0 0  0.005 10   (position, velocity, mass, radius)
+
+  Every parameter below can be set by its name. Lines starting with "body"
+  list the spheres explicitly; a scene with any body lines uses those
+  spheres instead of the big sphere and the body_count lattice.
+
+  The first load of a scene file compiles it into a binary image, FILE.bin,
+  which later loads map straight into memory instead of parsing the text,
+  as long as the text file and the defaults below have not changed since.
+
+*******************************************************************************/
+
+#ifndef Scene_H_
+#define Scene_H_
+
+#include <HDU/hduVector.h>
+
+// HIP Parameters
+extern double proxy_radius; // 5.0
+extern float proxy_color[4];
+
+// Box surface Parameters
+extern double wall_hip_k;    // Surface stiffness with HIP (N/mm), 0.48
+extern double wall_sphere_k; // Surface stiffness with sphere (N/mm), 4.00
+extern double side_length;   // Length of the sides of the box (mm), 200
+extern float box_color[4];
+
+// Object (big sphere) Parameters.  Note that for remote testing purposes, object may spawn on hip to provide force / have intial velocity / force components.
+extern double sphere_k;                // Surface stiffness with HIP (N/mm), 0.48
+extern double sphere_damping;          // Sphere damping (N-s/mm), 0.002
+extern double implicit_sphere_damping; // Sphere damping with --integrator=implicit, which is stable without any, 0
+extern double sphere_mass;             // Sphere mass (Kg), 0.005
+extern double sphere_radius;           // Radius of sphere (mm), 10
+extern double sphere_sphere_k;         // Surface stiffness between two spheres (N/mm), 4.00
+extern float sphere_color[4];
+
+// Number of dynamic spheres in the scene.  The first is the big sphere above, any others are placed on a lattice filling the box.
+extern int body_count; // 1
+
+// State parameters
+//Note that HIP tool is at 0, -65, -88).
+extern hduVector3Dd sphere_start_pos; // initial center of the object sphere, (0, -60, -88)
+extern hduVector3Dd sphere_start_vel; // initial velocity of the big sphere, (-20, 0, 0)
+
+// Triangle mesh (--mesh=FILE.obj), touched through a god-object proxy.  Its vertices are scaled, then offset.
+extern double mesh_k;             // Stiffness of the spring between the HIP and its proxy (N/mm), 0.48
+extern double mesh_scale;         // mm per OBJ unit, 1
+extern hduVector3Dd mesh_offset;  // (0, 0, 0)
+extern float mesh_color[4];
+
+// Signed distance grid baked from the mesh with --bake-sdf=FILE, and rendered instead of the proxy with --sdf=FILE.
+extern double sdf_cell;   // Grid spacing (mm), 1.0
+extern double sdf_margin; // Space baked around the mesh bounds (mm), 10
+extern int sdf_bits;      // 0 for a dense float grid, or 8 or 16 for a sparse grid of bricks quantized to that many bits, 0
+extern double sdf_band;   // Band around the surface a sparse grid stores (mm); deeper than this it pushes no more, 12
+
+// Spheres farther than this from the HIP (mm, surface to surface) are left out of the local model
+// the physics thread hands to the haptic loop.  It bounds how far the HIP can move between two physics updates.
+extern double local_model_margin; // 10
+
+// A sphere listed in the scene file.  Also the layout of the bodies in the binary image.
+struct SceneBody
+{
+    double position[3]; // mm
+    double velocity[3]; // mm/s
+    double mass;        // Kg
+    double radius;      // mm
+};
+
+// Spheres listed in the scene file, or none to use the big sphere and the lattice.
+extern const SceneBody* scene_bodies;
+extern int scene_body_count;
+
+/* Loads a scene file over the defaults, from its binary image when that is
+   up to date and otherwise from the text, writing a new image. Prints a
+   message and returns false if the file cannot be read or has an error. */
+bool loadScene(const char* path);
+
+#endif /* Scene_H_ */
+
+/******************************************************************************/
@@ -0,0 +1,240 @@
+/*****************************************************************************
+
+Module Name:
+
+  sdfBench.cpp
+
+Description:
+
+  Benchmark for the signed distance grid. Builds a sphere mesh in memory,
+  bakes its distance grid at a few cell sizes, and times a query of the
+  grid against the same query on the mesh BVH and on the analytic sphere,
+  with the largest error of each grid near the surface, where the HIP
+  touches it. Then bakes sparse brick grids of the analytic sphere down to
+  0.25 mm, times their lookups, and runs a HIP around the sphere at the
+  servo rate to count the lookups the prefetcher did not get ahead of.
+
+  Usage: SdfBench [sphere rings] [queries]
+
+*******************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "distanceGrid.h"
+#include "mesh.h"
+#include "sparseDistanceGrid.h"
+
+namespace
+{
+
+const double bench_radius = 40;   // mm
+const double bench_margin = 10;   // mm baked around the sphere
+const double bench_band = 5;      // queries lie this close to the surface (mm)
+const double bench_sparse_band = 10; // band stored by the sparse grids, past the query shell (mm)
+const char* const bench_sparse_path = "sdfBench.sdf";
+
+double elapsedNs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+/* UV sphere of the given radius around the origin, facing out. */
+void buildSphere(int rings, TriangleMesh& mesh)
+{
+    const int segments = 2 * rings;
+    std::vector<hduVector3Dd> vertices;
+    std::vector<int> indices;
+    for (int i = 0; i <= rings; ++i)
+    {
+        const double theta = M_PI * i / rings;
+        for (int j = 0; j < segments; ++j)
+        {
+            const double phi = 2 * M_PI * j / segments;
+            vertices.push_back(hduVector3Dd(sin(theta) * cos(phi), sin(theta) * sin(phi), cos(theta)) * bench_radius);
+        }
+    }
+    for (int i = 0; i < rings; ++i)
+    {
+        for (int j = 0; j < segments; ++j)
+        {
+            const int a = i * segments + j;
+            const int b = i * segments + (j + 1) % segments;
+            const int c = a + segments;
+            const int d = b + segments;
+            if (i > 0)
+            {
+                indices.push_back(a);
+                indices.push_back(c);
+                indices.push_back(b);
+            }
+            if (i < rings - 1)
+            {
+                indices.push_back(b);
+                indices.push_back(c);
+                indices.push_back(d);
+            }
+        }
+    }
+    mesh.create(vertices, indices);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const int rings = argc > 1 ? atoi(argv[1]) : 128;
+    const int queries = argc > 2 ? atoi(argv[2]) : 100000;
+
+    TriangleMesh mesh;
+    buildSphere(rings, mesh);
+    printf("Sphere mesh: %d triangles, radius %.0f mm\n", mesh.triangleCount(), bench_radius);
+
+    // Query points in a shell around the surface, where contact is rendered.
+    std::vector<hduVector3Dd> points(queries);
+    srand(578);
+    for (int i = 0; i < queries; ++i)
+    {
+        hduVector3Dd d;
+        do
+        {
+            d.set(rand() / (double) RAND_MAX - 0.5, rand() / (double) RAND_MAX - 0.5, rand() / (double) RAND_MAX - 0.5);
+        } while (d.magnitude() < 1e-3 || d.magnitude() > 0.5);
+        d.normalize();
+        points[i] = d * (bench_radius + bench_band * (2.0 * rand() / RAND_MAX - 1));
+    }
+
+    double sum = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < queries; ++i)
+    {
+        sum += points[i].magnitude() - bench_radius;
+    }
+    printf("%-24s %10.1f ns/query\n", "analytic sphere", elapsedNs(start) / queries);
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < queries; ++i)
+    {
+        sum += mesh.signedDistance(points[i]);
+    }
+    printf("%-24s %10.1f ns/query\n", "mesh BVH", elapsedNs(start) / queries);
+
+    const hduVector3Dd lo(-bench_radius - bench_margin, -bench_radius - bench_margin, -bench_radius - bench_margin);
+    const hduVector3Dd hi(bench_radius + bench_margin, bench_radius + bench_margin, bench_radius + bench_margin);
+    const double cells[] = { 4.0, 2.0, 1.0 };
+    for (size_t c = 0; c < sizeof(cells) / sizeof(cells[0]); ++c)
+    {
+        DistanceGrid grid;
+        start = std::chrono::steady_clock::now();
+        grid.bake(lo, hi, cells[c], [&mesh](const hduVector3Dd& p) { return mesh.signedDistance(p); });
+        const double bakeMs = elapsedNs(start) / 1e6;
+
+        hduVector3Dd normal;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < queries; ++i)
+        {
+            sum += grid.sample(points[i], normal);
+        }
+        const double ns = elapsedNs(start) / queries;
+
+        // Error of the distance against the mesh the grid was baked from, and of the normal against the sphere.
+        double meshError = 0;
+        double normalError = 0;
+        for (int i = 0; i < queries; i += 10)
+        {
+            const double d = grid.sample(points[i], normal);
+            const double e = fabs(d - mesh.signedDistance(points[i]));
+            meshError = e > meshError ? e : meshError;
+            const double angle = acos(fmin(1.0, dotProduct(normal, normalize(points[i]))));
+            normalError = angle > normalError ? angle : normalError;
+        }
+
+        char label[32];
+        sprintf(label, "grid %.1f mm", cells[c]);
+        printf("%-24s %10.1f ns/query  %4d^3 points %7.1f MB  baked in %8.1f ms"
+               "  max error %.3f mm, %.2f deg\n",
+               label, ns, grid.size(0), grid.bytes() / 1048576.0, bakeMs,
+               meshError, normalError * 180 / M_PI);
+    }
+
+    // Sparse grids of the analytic sphere, whose bake only evaluates the bricks near the surface.
+    const double sparseCells[] = { 1.0, 0.5, 0.25 };
+    const int sparseBits[] = { 16, 8 };
+    for (size_t c = 0; c < sizeof(sparseCells) / sizeof(sparseCells[0]); ++c)
+    {
+        for (size_t b = 0; b < sizeof(sparseBits) / sizeof(sparseBits[0]); ++b)
+        {
+            start = std::chrono::steady_clock::now();
+            if (!SparseDistanceGrid::bake(bench_sparse_path, lo, hi, sparseCells[c], bench_sparse_band, sparseBits[b],
+                                          [](const hduVector3Dd& p) { return p.magnitude() - bench_radius; }))
+            {
+                return 1;
+            }
+            const double bakeMs = elapsedNs(start) / 1e6;
+            SparseDistanceGrid grid;
+            if (!grid.load(bench_sparse_path))
+            {
+                return 1;
+            }
+
+            hduVector3Dd normal;
+            start = std::chrono::steady_clock::now();
+            for (int i = 0; i < queries; ++i)
+            {
+                sum += grid.sample(points[i], normal);
+            }
+            const double ns = elapsedNs(start) / queries;
+
+            double error = 0;
+            double normalError = 0;
+            for (int i = 0; i < queries; i += 10)
+            {
+                const double e = fabs(grid.sample(points[i], normal) - (points[i].magnitude() - bench_radius));
+                error = e > error ? e : error;
+                const double angle = acos(fmin(1.0, dotProduct(normal, normalize(points[i]))));
+                normalError = angle > normalError ? angle : normalError;
+            }
+
+            char label[32];
+            sprintf(label, "sparse %.2f mm %d bit", sparseCells[c], sparseBits[b]);
+            printf("%-24s %10.1f ns/query  %7d bricks %7.1f MB  baked in %8.1f ms"
+                   "  max error %.3f mm, %.2f deg (dense would be %.0f MB)\n",
+                   label, ns, grid.storedBricks(), grid.bytes() / 1048576.0, bakeMs, error, normalError * 180 / M_PI,
+                   pow((hi[0] - lo[0]) / sparseCells[c] + 1, 3) * sizeof(GridSample) / 1048576.0);
+        }
+    }
+
+    // A HIP circling the sphere at 200 mm/s on its surface, tracked at 1 kHz, with the prefetcher following it.
+    SparseDistanceGrid grid;
+    if (!grid.load(bench_sparse_path))
+    {
+        return 1;
+    }
+    grid.track(hduVector3Dd(bench_radius, 0, 0));
+    grid.startPrefetch(10, 0.05);
+    const int ticks = 2000;
+    for (int i = 0; i < ticks; ++i)
+    {
+        const double angle = 200.0 / bench_radius * i / 1000.0;
+        const hduVector3Dd hip(bench_radius * cos(angle), bench_radius * sin(angle), 0);
+        hduVector3Dd normal;
+        grid.track(hip);
+        sum += grid.sample(hip, normal);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    grid.stopPrefetch();
+    printf("prefetch: %llu lookups, %llu before the prefetcher reached their brick\n",
+           (unsigned long long) grid.lookups(), (unsigned long long) grid.coldLookups());
+    grid.close();
+    remove(bench_sparse_path);
+
+    // Keeps the timed loops from being optimized away.
+    return sum == 12345.678 ? 1 : 0;
+}
+
+/******************************************************************************/
@@ -0,0 +1,191 @@
+/*****************************************************************************
+
+Module Name:
+
+  simulation.cpp
+
+Description:
+
+  Steps the dynamic sphere world and builds the local model of it that the
+  haptic loop renders when the world runs on the physics thread.
+
+*******************************************************************************/
+
+#include "simulation.h"
+#include "scene.h"
+#include "wallForce.h"
+
+BodyWorld bodies;
+
+SpatialHash broadphase;
+std::vector<BodyPair> body_pairs;
+std::vector<int> hip_candidates;
+double max_body_radius = 0;
+
+Integrator integrator;
+
+namespace
+{
+
+/* Haptic loop state handed to ComputeBodyForces by the integrator. */
+struct BodyForceContext
+{
+    hduVector3Dd hipPosition;
+    hduVector3Dd hipForce; // force on the HIP from the spheres, from the first evaluation of the tick
+    int evaluations;
+};
+
+/*******************************************************************************
+  Net applied force on every dynamic sphere for the current sphere positions.
+  Called by the integrator one or more times per step.
+ *******************************************************************************/
+void ComputeBodyForces(BodyWorld& world, void* pUserData)
+{
+    BodyForceContext* context = static_cast<BodyForceContext*>(pUserData);
+    hduVector3Dd hipForce(0, 0, 0);
+
+    //The dynamic spheres are handled together by the vectorized version of Interaction_Wall.
+    world.clearForces();
+    if (world.count() > 0) {
+        Interaction_WallBatch(&world.px[0], &world.py[0], &world.pz[0], &world.radius[0], world.count(),
+                              wall_sphere_k, side_length, &world.fx[0], &world.fy[0], &world.fz[0]);
+    }
+
+    //The implicit integrator also needs the stiffness of every contact spring acting on a sphere.
+    if (world.trackStiffness) {
+        for (int b = 0; b < world.count(); ++b) {
+            world.addAxisStiffness(b, Interaction_WallStiffness(world.position(b), world.radius[b], wall_sphere_k, side_length));
+        }
+    }
+
+    //Only bodies that share or neighbour a grid cell can touch, so the spatial hash gives us the candidates for the remaining two collision types.
+    broadphase.update(world);
+
+    //Calculate collision forces between the HIP and dynamic spheres.  Normally this would require the mass of both points to calculate energy balance.
+    //We are given a stiffness coefficient, so it is possible we assume infinite mass for HIP.
+    broadphase.query(context->hipPosition, proxy_radius + max_body_radius, hip_candidates);
+    for (size_t c = 0; c < hip_candidates.size(); ++c) {
+        const int b = hip_candidates[c];
+
+        //Check if the HIP has collided with the dynamic sphere.
+        hduVector3Dd rSphereHIP = world.position(b) - context->hipPosition;
+        //If the distance vector has less magnitude than sum of radii, then we have collision.
+        const double deltaDist = rSphereHIP.magnitude() - world.radius[b] - proxy_radius;
+        if (deltaDist < 0) {
+            //Calculate force onto dynamic sphere based on its k value.  Apply this force to both the user and the sphere.
+            //The force is in the opposite direction to rSphereHIP (the vector between the centers of the two spheres).  This vector points from the proxy to the dynamic sphere.
+            rSphereHIP.normalize();
+            hduVector3Dd collisionForce = rSphereHIP * deltaDist * sphere_k;
+
+            hipForce = hipForce + collisionForce;
+            world.addForce(b, -collisionForce);
+            if (world.trackStiffness) {
+                world.addStiffness(b, sphere_k, rSphereHIP);
+            }
+        }
+    }
+
+    //Collisions between dynamic spheres use the same spring model with sphere_sphere_k, applied equal and opposite to both spheres.
+    broadphase.findPairs(body_pairs);
+    for (size_t c = 0; c < body_pairs.size(); ++c) {
+        const int a = body_pairs[c].a;
+        const int b = body_pairs[c].b;
+
+        //rAB points from sphere a to sphere b.
+        hduVector3Dd rAB = world.position(b) - world.position(a);
+        const double deltaDist = rAB.magnitude() - world.radius[a] - world.radius[b];
+        if (deltaDist < 0) {
+            rAB.normalize();
+            hduVector3Dd collisionForce = rAB * deltaDist * sphere_sphere_k;
+
+            world.addForce(a, collisionForce);
+            world.addForce(b, -collisionForce);
+            if (world.trackStiffness) {
+                world.addStiffness(a, sphere_sphere_k, rAB);
+                world.addStiffness(b, sphere_sphere_k, rAB);
+            }
+        }
+    }
+
+    if (context->evaluations++ == 0) {
+        context->hipForce = hipForce;
+    }
+}
+
+} // namespace
+
+/******************************************************************************
+ Creates the spheres and sizes the broadphase and integrator for them.
+******************************************************************************/
+void InitSimulation(const RunOptions& options)
+{
+    // The implicit integrator does not need the artificial damping the explicit schemes rely on.
+    const double damping = options.integrator == INTEGRATOR_IMPLICIT_EULER ? implicit_sphere_damping : sphere_damping;
+    if (scene_body_count > 0) {
+        // Spheres listed in the scene file.
+        bodies.reserve(scene_body_count);
+        for (int i = 0; i < scene_body_count; ++i) {
+            const SceneBody& body = scene_bodies[i];
+            bodies.addBody(hduVector3Dd(body.position[0], body.position[1], body.position[2]),
+                           hduVector3Dd(body.velocity[0], body.velocity[1], body.velocity[2]),
+                           body.mass, body.radius, damping);
+        }
+    }
+    else {
+        bodies.reserve(body_count);
+        bodies.addBody(sphere_start_pos, sphere_start_vel, sphere_mass, sphere_radius, damping);
+        spawnBodyLattice(bodies, body_count - 1, sphere_mass, sphere_radius, damping, side_length);
+    }
+
+    // Grid cells are large enough that touching spheres, or the HIP and a sphere it touches, are never more than one cell apart.
+    max_body_radius = bodies.maxRadius();
+    const double cellSize = 2 * (max_body_radius > proxy_radius ? max_body_radius : proxy_radius);
+    broadphase.init(bodies.count(), cellSize);
+    broadphase.update(bodies);
+    body_pairs.reserve(broadphase.pairBound(bodies));
+    hip_candidates.reserve(bodies.count());
+    integrator.init(options.integrator, bodies.count());
+}
+
+/******************************************************************************
+ Runs the integrator over the substeps of one step. The force on the HIP is
+ taken from the first force evaluation, at the state the user is touching
+ now.
+******************************************************************************/
+hduVector3Dd StepSimulation(const hduVector3Dd& hipPosition, double dt, int substeps)
+{
+    BodyForceContext context;
+    context.hipPosition = hipPosition;
+    context.evaluations = 0;
+
+    for (int step = 0; step < substeps; ++step)
+    {
+        integrator.step(bodies, dt / substeps, ComputeBodyForces, &context);
+    }
+    return context.hipForce;
+}
+
+/******************************************************************************
+ Walls first so they are never dropped, then the candidate spheres the
+ broadphase returns for the enlarged HIP.
+******************************************************************************/
+void BuildLocalModel(const hduVector3Dd& hipPosition, double margin, LocalModel& model)
+{
+    model.planeCount = 0;
+    model.droppedPlanes = 0;
+    addWallPlanes(model, proxy_radius, wall_hip_k, side_length);
+
+    broadphase.query(hipPosition, proxy_radius + max_body_radius + margin, hip_candidates);
+    for (size_t c = 0; c < hip_candidates.size(); ++c)
+    {
+        const int b = hip_candidates[c];
+        const hduVector3Dd center = bodies.position(b);
+        const double gap = (center - hipPosition).magnitude() - bodies.radius[b] - proxy_radius;
+        if (gap < margin)
+        {
+            addSpherePlane(model, hipPosition, proxy_radius, center, bodies.radius[b], sphere_k);
+        }
+    }
+}
+
+/******************************************************************************/
@@ -0,0 +1,54 @@
+/*****************************************************************************
+
+Module Name:
+
+  simulation.h
+
+Description:
+
+  The dynamic sphere world: body storage, broadphase and integrator, and
+  the step that advances them. The step runs either inline in the haptic
+  loop or on the physics thread, never on both.
+
+*******************************************************************************/
+
+#ifndef Simulation_H_
+#define Simulation_H_
+
+#include <vector>
+
+#include <HDU/hduVector.h>
+
+#include "bodies.h"
+#include "broadphase.h"
+#include "integrator.h"
+#include "localModel.h"
+#include "options.h"
+
+// Positions, velocities and parameters of every dynamic sphere, written by whichever thread steps the simulation.
+extern BodyWorld bodies;
+
+// Broadphase for sphere-sphere and HIP-sphere contacts, and its output buffers.  All are sized by InitSimulation.
+extern SpatialHash broadphase;
+extern std::vector<BodyPair> body_pairs;
+extern std::vector<int> hip_candidates;
+extern double max_body_radius;
+
+// Integrator selected by the startup options.
+extern Integrator integrator;
+
+/* Creates the spheres and sizes every buffer the step uses, so stepping
+   never allocates. Call before the haptic loop starts. */
+void InitSimulation(const RunOptions& options);
+
+/* Advances the spheres by dt in the given number of substeps with the HIP
+   held at hipPosition. Returns the force of the spheres on the HIP at the
+   start of the step. */
+hduVector3Dd StepSimulation(const hduVector3Dd& hipPosition, double dt, int substeps);
+
+/* Replaces model with the walls and every sphere within margin of the HIP. */
+void BuildLocalModel(const hduVector3Dd& hipPosition, double margin, LocalModel& model);
+
+#endif /* Simulation_H_ */
+
+/******************************************************************************/
@@ -0,0 +1,89 @@
+/*****************************************************************************
+
+Module Name:
+
+  snapshot.cpp
+
+Description:
+
+  Copies of the simulation state handed between threads.
+
+*******************************************************************************/
+
+#include <algorithm>
+
+#include "scene.h"
+#include "snapshot.h"
+
+void BodyStates::resize(int bodyCount)
+{
+    px.assign(bodyCount, 0); py.assign(bodyCount, 0); pz.assign(bodyCount, 0);
+    vx.assign(bodyCount, 0); vy.assign(bodyCount, 0); vz.assign(bodyCount, 0);
+    fx.assign(bodyCount, 0); fy.assign(bodyCount, 0); fz.assign(bodyCount, 0);
+}
+
+void BodyStates::capture(const BodyWorld& world)
+{
+    std::copy(world.px.begin(), world.px.end(), px.begin());
+    std::copy(world.py.begin(), world.py.end(), py.begin());
+    std::copy(world.pz.begin(), world.pz.end(), pz.begin());
+    std::copy(world.vx.begin(), world.vx.end(), vx.begin());
+    std::copy(world.vy.begin(), world.vy.end(), vy.begin());
+    std::copy(world.vz.begin(), world.vz.end(), vz.begin());
+    std::copy(world.fx.begin(), world.fx.end(), fx.begin());
+    std::copy(world.fy.begin(), world.fy.end(), fy.begin());
+    std::copy(world.fz.begin(), world.fz.end(), fz.begin());
+}
+
+void WorldSnapshot::resize(int bodyCount)
+{
+    bodies.resize(bodyCount);
+    bodyProxies.assign(bodyCount, hduVector3Dd(0, 0, 0));
+}
+
+namespace
+{
+
+/* center moved back inside the walls far enough to keep a sphere of the
+   given radius clear of them. */
+hduVector3Dd insideWalls(hduVector3Dd center, double radius)
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        if (center[i] + radius > side_length / 2)
+        {
+            center[i] = side_length / 2 - radius;
+        }
+        else if (center[i] - radius < -side_length / 2)
+        {
+            center[i] = -side_length / 2 + radius;
+        }
+    }
+    return center;
+}
+
+} // namespace
+
+/******************************************************************************
+ The spheres are placed first and take priority: a HIP overlapping one is
+ drawn touching it, along the line from the sphere to the HIP, even if
+ that puts it in a wall.
+******************************************************************************/
+void WorldSnapshot::solveProxies(const hduVector3Dd& surfaceProxy, const BodyWorld& world)
+{
+    hipProxy = insideWalls(surfaceProxy, proxy_radius);
+    for (int b = 0; b < bodies.count(); ++b)
+    {
+        const double radius = world.radius[b];
+        bodyProxies[b] = insideWalls(bodies.position(b), radius);
+
+        hduVector3Dd rSphereHIP = bodyProxies[b] - hipPosition;
+        const double distance = rSphereHIP.magnitude();
+        if (distance < radius + proxy_radius && distance > 0)
+        {
+            hipProxy = bodyProxies[b] - rSphereHIP * ((radius + proxy_radius) / distance);
+        }
+    }
+}
+
+/******************************************************************************/
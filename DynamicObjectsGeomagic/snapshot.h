@@ -0,0 +1,86 @@
+/*****************************************************************************
+
+Module Name:
+
+  snapshot.h
+
+Description:
+
+  Copies of the simulation state handed between threads through triple
+  buffers. The haptic loop publishes a WorldSnapshot every tick for the
+  graphics; when the spheres run on the physics thread, that thread hands
+  its BodyStates to the haptic loop the same way.
+
+  Body radii and the other per body parameters never change after
+  InitSimulation, so readers take them from the BodyWorld directly.
+
+  The snapshot also carries the proxies the graphics draw: the HIP and
+  each sphere held out of the surfaces they are pushed against. The haptic
+  loop solves them once per tick, so what is drawn is what is rendered,
+  and the graphics only draw.
+
+*******************************************************************************/
+
+#ifndef Snapshot_H_
+#define Snapshot_H_
+
+#include <vector>
+
+#include <HDU/hduVector.h>
+
+#include "bodies.h"
+
+struct BodyStates
+{
+    std::vector<double> px, py, pz;
+    std::vector<double> vx, vy, vz;
+    std::vector<double> fx, fy, fz;
+
+    int count() const { return (int) px.size(); }
+
+    /* Sizes the arrays for bodyCount bodies. Call before the threads
+       start; capture and assignment between equally sized states then
+       never allocate. */
+    void resize(int bodyCount);
+
+    /* Copies the positions, velocities and net forces of every body in
+       world. */
+    void capture(const BodyWorld& world);
+
+    hduVector3Dd position(int i) const { return hduVector3Dd(px[i], py[i], pz[i]); }
+    hduVector3Dd velocity(int i) const { return hduVector3Dd(vx[i], vy[i], vz[i]); }
+    hduVector3Dd force(int i) const { return hduVector3Dd(fx[i], fy[i], fz[i]); }
+};
+
+struct WorldSnapshot
+{
+    WorldSnapshot() : tick(0) {}
+
+    /* Sizes the body arrays, like BodyStates::resize. */
+    void resize(int bodyCount);
+
+    /* Haptic loop side: solves the proxies from bodies, which must be
+       filled in already. surfaceProxy is the HIP held out of the mesh, or
+       the HIP position without one. The spheres are held inside the walls;
+       the HIP is held inside the walls, then pushed out of any sphere it
+       overlaps. */
+    void solveProxies(const hduVector3Dd& surfaceProxy, const BodyWorld& world);
+
+    // Servo tick the snapshot was taken on, counting from 1.
+    unsigned long tick;
+
+    // HIP position, and the force the scene rendered on it that tick,
+    // before the safety override zeroes the device output.
+    hduVector3Dd hipPosition;
+    hduVector3Dd force;
+
+    BodyStates bodies;
+
+    // Where the graphics draw the HIP and each sphere.
+    hduVector3Dd hipProxy;
+    std::vector<hduVector3Dd> bodyProxies;
+};
+
+#endif /* Snapshot_H_ */
+
+/******************************************************************************/
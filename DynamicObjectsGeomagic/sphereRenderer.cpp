@@ -0,0 +1,372 @@
+/*****************************************************************************
+
+Module Name:
+
+  sphereRenderer.cpp
+
+Description:
+
+  Draws many spheres per frame from meshes tessellated once.
+
+*******************************************************************************/
+
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "glExtensions.h"
+#include "helper.h"
+#include "sphereRenderer.h"
+
+namespace
+{
+
+// Slices and stacks of each level of detail, coarsest first.
+const int kLevels[][2] = { { 8, 6 }, { 12, 8 }, { 20, 14 }, { 32, 24 } };
+const int kLevelCount = sizeof(kLevels) / sizeof(kLevels[0]);
+
+// Largest on screen radius (pixels) drawn at each level but the finest.
+const double kLevelPixels[kLevelCount - 1] = { 4, 12, 40 };
+
+// Same as the fixed function pipeline with GL_COLOR_MATERIAL on ambient and
+// diffuse and no specular, for the two directional lights of the scene.
+const char* const kVertexShader =
+    "#version 120\n"
+    "attribute vec4 sphere;\n" // center, radius
+    "attribute vec4 color;\n"
+    "varying vec4 shade;\n"
+    "void main()\n"
+    "{\n"
+    "    vec3 normal = normalize(gl_NormalMatrix * gl_Vertex.xyz);\n"
+    "    vec3 light = gl_LightModel.ambient.rgb;\n"
+    "    for (int i = 0; i < 2; ++i) {\n"
+    "        light += gl_LightSource[i].ambient.rgb + gl_LightSource[i].diffuse.rgb\n"
+    "            * max(dot(normal, normalize(gl_LightSource[i].position.xyz)), 0.0);\n"
+    "    }\n"
+    "    shade = vec4(color.rgb * light, color.a);\n"
+    "    gl_Position = gl_ModelViewProjectionMatrix * vec4(sphere.xyz + gl_Vertex.xyz * sphere.w, 1.0);\n"
+    "}\n";
+
+const char* const kFragmentShader =
+    "#version 120\n"
+    "varying vec4 shade;\n"
+    "void main()\n"
+    "{\n"
+    "    gl_FragColor = shade;\n"
+    "}\n";
+
+GLuint compileShader(GLenum type, const char* source)
+{
+    const GLExtensions& gl = glExtensions();
+    const GLuint shader = gl.createShader(type);
+    gl.shaderSource(shader, 1, &source, NULL);
+    gl.compileShader(shader);
+    GLint status = 0;
+    gl.getShaderiv(shader, GL_COMPILE_STATUS, &status);
+    return status ? shader : 0;
+}
+
+/* Builds the instancing program; returns 0 if the driver rejects it. */
+GLuint buildProgram()
+{
+    const GLExtensions& gl = glExtensions();
+    const GLuint vertexShader = compileShader(GL_VERTEX_SHADER, kVertexShader);
+    const GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, kFragmentShader);
+    if (vertexShader == 0 || fragmentShader == 0)
+    {
+        return 0;
+    }
+    const GLuint program = gl.createProgram();
+    gl.attachShader(program, vertexShader);
+    gl.attachShader(program, fragmentShader);
+    gl.linkProgram(program);
+    GLint status = 0;
+    gl.getProgramiv(program, GL_LINK_STATUS, &status);
+    return status ? program : 0;
+}
+
+} // namespace
+
+/******************************************************************************
+ SphereRenderer
+******************************************************************************/
+SphereRenderer::SphereRenderer() :
+    m_initialized(false),
+    m_vertexBuffer(0),
+    m_indexBuffer(0),
+    m_instanceBuffer(0),
+    m_program(0),
+    m_pixelScale(1)
+{
+    m_instanceAttribute[0] = -1;
+    m_instanceAttribute[1] = -1;
+    memset(m_modelView, 0, sizeof(m_modelView));
+}
+
+/******************************************************************************
+ Queues a sphere for the next draw().
+******************************************************************************/
+void SphereRenderer::add(const hduVector3Dd& center, double radius, const float color[4])
+{
+    Instance sphere;
+    for (int i = 0; i < 3; ++i)
+    {
+        sphere.center[i] = (float) center[i];
+    }
+    sphere.radius = (float) radius;
+    memcpy(sphere.color, color, sizeof(sphere.color));
+    m_queue.push_back(sphere);
+}
+
+/******************************************************************************
+ Tessellates the unit sphere at every level of detail into one vertex and
+ index array, uploads them, and builds the instancing program if the
+ driver supports it.
+******************************************************************************/
+void SphereRenderer::init()
+{
+    m_initialized = true;
+
+    m_levels.resize(kLevelCount);
+    for (int l = 0; l < kLevelCount; ++l)
+    {
+        const int slices = kLevels[l][0];
+        const int stacks = kLevels[l][1];
+        const int first = (int) m_vertices.size() / 3;
+        for (int i = 0; i <= stacks; ++i)
+        {
+            const double theta = M_PI * i / stacks;
+            for (int j = 0; j <= slices; ++j)
+            {
+                const double phi = 2 * M_PI * j / slices;
+                m_vertices.push_back((float) (sin(theta) * cos(phi)));
+                m_vertices.push_back((float) (sin(theta) * sin(phi)));
+                m_vertices.push_back((float) cos(theta));
+            }
+        }
+
+        // Counterclockwise seen from outside.
+        m_levels[l].firstIndex = (int) m_indices.size();
+        for (int i = 0; i < stacks; ++i)
+        {
+            for (int j = 0; j < slices; ++j)
+            {
+                const unsigned short a = (unsigned short) (first + i * (slices + 1) + j);
+                const unsigned short b = (unsigned short) (a + 1);
+                const unsigned short c = (unsigned short) (a + slices + 1);
+                const unsigned short d = (unsigned short) (c + 1);
+                if (i > 0)
+                {
+                    m_indices.push_back(a);
+                    m_indices.push_back(c);
+                    m_indices.push_back(b);
+                }
+                if (i < stacks - 1)
+                {
+                    m_indices.push_back(b);
+                    m_indices.push_back(c);
+                    m_indices.push_back(d);
+                }
+            }
+        }
+        m_levels[l].indexCount = (int) m_indices.size() - m_levels[l].firstIndex;
+    }
+
+    const GLExtensions& gl = glExtensions();
+    if (!gl.buffers)
+    {
+        return;
+    }
+
+    GLuint buffers[3];
+    gl.genBuffers(3, buffers);
+    m_vertexBuffer = buffers[0];
+    m_indexBuffer = buffers[1];
+    m_instanceBuffer = buffers[2];
+    gl.bindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+    gl.bufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(float), &m_vertices[0], GL_STATIC_DRAW);
+    gl.bindBuffer(GL_ARRAY_BUFFER, 0);
+    gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+    gl.bufferData(GL_ELEMENT_ARRAY_BUFFER, m_indices.size() * sizeof(unsigned short), &m_indices[0], GL_STATIC_DRAW);
+    gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    if (gl.instancing)
+    {
+        const GLuint program = buildProgram();
+        if (program != 0)
+        {
+            m_instanceAttribute[0] = gl.getAttribLocation(program, "sphere");
+            m_instanceAttribute[1] = gl.getAttribLocation(program, "color");
+            if (m_instanceAttribute[0] >= 0 && m_instanceAttribute[1] >= 0)
+            {
+                m_program = program;
+            }
+        }
+    }
+}
+
+/******************************************************************************
+ Level of detail for a sphere, from the radius it covers on screen.
+******************************************************************************/
+int SphereRenderer::levelFor(const Instance& sphere) const
+{
+    const double* m = m_modelView;
+    const double depth = -(m[2] * sphere.center[0] + m[6] * sphere.center[1] + m[10] * sphere.center[2] + m[14]);
+    if (depth <= sphere.radius)
+    {
+        return kLevelCount - 1;
+    }
+    const double pixels = sphere.radius * m_pixelScale / depth;
+    int level = 0;
+    while (level < kLevelCount - 1 && pixels > kLevelPixels[level])
+    {
+        ++level;
+    }
+    return level;
+}
+
+/******************************************************************************
+ Draws the queued spheres, then empties the queue.
+******************************************************************************/
+void SphereRenderer::draw()
+{
+    if (!m_initialized)
+    {
+        init();
+    }
+    const GLExtensions& gl = glExtensions();
+
+    // Scale from the perspective projection: pixels = radius * P[1][1] * height / 2 / depth.
+    double projection[16];
+    GLint viewport[4];
+    glGetDoublev(GL_MODELVIEW_MATRIX, m_modelView);
+    glGetDoublev(GL_PROJECTION_MATRIX, projection);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    m_pixelScale = projection[5] * viewport[3] / 2;
+
+    for (int l = 0; l < kLevelCount; ++l)
+    {
+        m_levels[l].instances.clear();
+    }
+    for (size_t i = 0; i < m_queue.size(); ++i)
+    {
+        m_levels[levelFor(m_queue[i])].instances.push_back(m_queue[i]);
+    }
+    m_queue.clear();
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    if (m_vertexBuffer != 0)
+    {
+        gl.bindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+        gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+        glVertexPointer(3, GL_FLOAT, 0, bufferOffset(0));
+    }
+    else
+    {
+        glVertexPointer(3, GL_FLOAT, 0, &m_vertices[0]);
+    }
+
+    if (m_program != 0)
+    {
+        drawInstanced();
+    }
+    else
+    {
+        drawEach();
+    }
+
+    glDisableClientState(GL_VERTEX_ARRAY);
+    if (m_vertexBuffer != 0)
+    {
+        gl.bindBuffer(GL_ARRAY_BUFFER, 0);
+        gl.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+}
+
+/******************************************************************************
+ One upload of every sphere, then one instanced call per level of detail.
+******************************************************************************/
+void SphereRenderer::drawInstanced()
+{
+    const GLExtensions& gl = glExtensions();
+    m_stream.clear();
+    for (int l = 0; l < kLevelCount; ++l)
+    {
+        m_stream.insert(m_stream.end(), m_levels[l].instances.begin(), m_levels[l].instances.end());
+    }
+    if (m_stream.empty())
+    {
+        return;
+    }
+
+    // A new store each frame, so the driver need not wait for last frame's draws.
+    gl.bindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+    gl.bufferData(GL_ARRAY_BUFFER, m_stream.size() * sizeof(Instance), &m_stream[0], GL_STREAM_DRAW);
+
+    gl.useProgram(m_program);
+    for (int a = 0; a < 2; ++a)
+    {
+        gl.enableVertexAttribArray(m_instanceAttribute[a]);
+        gl.vertexAttribDivisor(m_instanceAttribute[a], 1);
+    }
+
+    size_t offset = 0;
+    for (int l = 0; l < kLevelCount; ++l)
+    {
+        const Level& level = m_levels[l];
+        if (level.instances.empty())
+        {
+            continue;
+        }
+        const size_t base = offset * sizeof(Instance);
+        gl.vertexAttribPointer(m_instanceAttribute[0], 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                             bufferOffset(base + offsetof(Instance, center)));
+        gl.vertexAttribPointer(m_instanceAttribute[1], 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                             bufferOffset(base + offsetof(Instance, color)));
+        gl.drawElementsInstanced(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_SHORT,
+                               bufferOffset(level.firstIndex * sizeof(unsigned short)),
+                               (GLsizei) level.instances.size());
+        offset += level.instances.size();
+    }
+
+    for (int a = 0; a < 2; ++a)
+    {
+        gl.vertexAttribDivisor(m_instanceAttribute[a], 0);
+        gl.disableVertexAttribArray(m_instanceAttribute[a]);
+    }
+    gl.useProgram(0);
+    gl.bindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+}
+
+/******************************************************************************
+ One call of the cached mesh per sphere, lit by the fixed function pipeline.
+******************************************************************************/
+void SphereRenderer::drawEach()
+{
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glNormalPointer(GL_FLOAT, 0, m_vertexBuffer != 0 ? bufferOffset(0) : (const void*) &m_vertices[0]);
+    setCapability(GL_LIGHTING, true);
+    glMatrixMode(GL_MODELVIEW);
+
+    for (int l = 0; l < kLevelCount; ++l)
+    {
+        const Level& level = m_levels[l];
+        const void* indices = m_indexBuffer != 0
+            ? bufferOffset(level.firstIndex * sizeof(unsigned short))
+            : (const void*) &m_indices[level.firstIndex];
+        for (size_t i = 0; i < level.instances.size(); ++i)
+        {
+            const Instance& sphere = level.instances[i];
+            glPushMatrix();
+            glTranslatef(sphere.center[0], sphere.center[1], sphere.center[2]);
+            glScalef(sphere.radius, sphere.radius, sphere.radius);
+            setColor(sphere.color);
+            glDrawElements(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_SHORT, indices);
+            glPopMatrix();
+        }
+    }
+
+    glDisableClientState(GL_NORMAL_ARRAY);
+}
+
+/******************************************************************************/
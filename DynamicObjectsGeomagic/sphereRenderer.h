@@ -0,0 +1,101 @@
+/*****************************************************************************
+
+Module Name:
+
+  sphereRenderer.h
+
+Description:
+
+  Draws many spheres per frame from meshes tessellated once. A unit sphere
+  is tessellated at a few levels of detail when the renderer first draws,
+  and uploaded to vertex and index buffers. Each frame the spheres are
+  queued with their center, radius and color, sorted into levels of detail
+  by how many pixels they cover on screen, and each level is drawn with a
+  single instanced call, the per sphere data streamed to the GPU in one
+  buffer.
+
+  Instancing needs OpenGL 2.0 shaders and instanced arrays (OpenGL 3.3 or
+  ARB_instanced_arrays). Without them each sphere is one draw call of the
+  cached mesh, which still saves the tessellation of gluSphere. The shader
+  lights the spheres from the fixed function light and material state, so
+  they look the same either way.
+
+*******************************************************************************/
+
+#ifndef SphereRenderer_H_
+#define SphereRenderer_H_
+
+#include <vector>
+
+#if defined(WIN32)
+# include <windows.h>
+#endif
+#if defined(WIN32) || defined(linux)
+# include <GL/gl.h>
+#elif defined(__APPLE__)
+# include <OpenGL/gl.h>
+#endif
+
+#include <HDU/hduVector.h>
+
+class SphereRenderer
+{
+public:
+    SphereRenderer();
+
+    /* Queues a sphere for the next draw(). */
+    void add(const hduVector3Dd& center, double radius, const float color[4]);
+
+    /* Draws the queued spheres with the current GL transforms and lighting,
+       then empties the queue. The first call needs a current GL context. */
+    void draw();
+
+    /* Whether draw() uses instanced calls; known after the first draw(). */
+    bool instanced() const { return m_program != 0; }
+
+private:
+    // One sphere: center and radius, then color. Also the layout of the instance buffer.
+    struct Instance
+    {
+        float center[3];
+        float radius;
+        float color[4];
+    };
+
+    // Range of one level of detail in the shared vertex and index buffers,
+    // and the spheres drawn at it this frame.
+    struct Level
+    {
+        int firstIndex;
+        int indexCount;
+        std::vector<Instance> instances;
+    };
+
+    void init();
+    int levelFor(const Instance& sphere) const;
+    void drawInstanced();
+    void drawEach();
+
+    bool m_initialized;
+    unsigned m_vertexBuffer;
+    unsigned m_indexBuffer;
+    unsigned m_instanceBuffer;
+    unsigned m_program;
+    int m_instanceAttribute[2]; // center and radius, color
+
+    // Mesh data, kept for drawing from client memory when there are no buffer objects.
+    std::vector<float> m_vertices; // unit sphere positions, which are also the normals
+    std::vector<unsigned short> m_indices;
+
+    std::vector<Level> m_levels;
+    std::vector<Instance> m_queue;
+    std::vector<Instance> m_stream; // every level's spheres, in level order, as uploaded
+
+    // Pixels per unit radius at unit eye depth, for the current frame.
+    double m_pixelScale;
+    double m_modelView[16];
+};
+
+#endif /* SphereRenderer_H_ */
+
+/******************************************************************************/
@@ -0,0 +1,91 @@
+/*****************************************************************************
+
+Module Name:
+
+  staticGeometry.cpp
+
+Description:
+
+  Scene geometry uploaded once and drawn from a vertex buffer.
+
+*******************************************************************************/
+
+#include "glExtensions.h"
+#include "staticGeometry.h"
+
+namespace
+{
+
+const int kFloatsPerVertex = 6; // position, normal
+
+} // namespace
+
+/******************************************************************************
+ StaticGeometry
+******************************************************************************/
+StaticGeometry::StaticGeometry() :
+    m_buffer(0),
+    m_uploaded(false)
+{
+}
+
+/******************************************************************************
+ Replaces the triangles; they are uploaded on the next draw.
+******************************************************************************/
+void StaticGeometry::set(const std::vector<float>& vertices)
+{
+    m_vertices = vertices;
+    m_uploaded = false;
+}
+
+/******************************************************************************
+ Draws the triangles, uploading them first if they changed.
+******************************************************************************/
+void StaticGeometry::draw()
+{
+    if (m_vertices.empty())
+    {
+        return;
+    }
+
+    const GLExtensions& gl = glExtensions();
+    if (!m_uploaded && gl.buffers)
+    {
+        if (m_buffer == 0)
+        {
+            GLuint buffer;
+            gl.genBuffers(1, &buffer);
+            m_buffer = buffer;
+        }
+        gl.bindBuffer(GL_ARRAY_BUFFER, m_buffer);
+        gl.bufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(float), &m_vertices[0], GL_STATIC_DRAW);
+        gl.bindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    m_uploaded = true;
+
+    const GLsizei stride = kFloatsPerVertex * sizeof(float);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    if (m_buffer != 0)
+    {
+        gl.bindBuffer(GL_ARRAY_BUFFER, m_buffer);
+        glVertexPointer(3, GL_FLOAT, stride, bufferOffset(0));
+        glNormalPointer(GL_FLOAT, stride, bufferOffset(3 * sizeof(float)));
+    }
+    else
+    {
+        glVertexPointer(3, GL_FLOAT, stride, &m_vertices[0]);
+        glNormalPointer(GL_FLOAT, stride, &m_vertices[3]);
+    }
+
+    glDrawArrays(GL_TRIANGLES, 0, (GLsizei) (m_vertices.size() / kFloatsPerVertex));
+
+    if (m_buffer != 0)
+    {
+        gl.bindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+/******************************************************************************/
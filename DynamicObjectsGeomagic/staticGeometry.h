@@ -0,0 +1,49 @@
+/*****************************************************************************
+
+Module Name:
+
+  staticGeometry.h
+
+Description:
+
+  Scene geometry that does not change from frame to frame, such as the
+  walls of the container. The triangles are uploaded to a vertex buffer
+  the first time they are drawn, and every frame after that is a single
+  draw call from the buffer instead of the vertices being sent again in
+  immediate mode. Without buffer objects (before OpenGL 1.5) they are
+  drawn from client memory.
+
+*******************************************************************************/
+
+#ifndef StaticGeometry_H_
+#define StaticGeometry_H_
+
+#include <vector>
+
+class StaticGeometry
+{
+public:
+    StaticGeometry();
+
+    /* Replaces the triangles, three vertices each of x y z nx ny nz. They
+       are uploaded on the next draw(). */
+    void set(const std::vector<float>& vertices);
+
+    bool empty() const { return m_vertices.empty(); }
+
+    /* Draws the triangles with the current transforms, color and lighting.
+       Needs a current GL context. */
+    void draw();
+
+private:
+    std::vector<float> m_vertices;
+    unsigned m_buffer;
+    bool m_uploaded;
+
+    StaticGeometry(const StaticGeometry&);
+    StaticGeometry& operator=(const StaticGeometry&);
+};
+
+#endif /* StaticGeometry_H_ */
+
+/******************************************************************************/
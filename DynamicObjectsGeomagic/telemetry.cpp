@@ -0,0 +1,137 @@
+/*****************************************************************************
+
+Module Name:
+
+  telemetry.cpp
+
+Description:
+
+  Per tick diagnostics of the servo loop.
+
+*******************************************************************************/
+
+#include <string.h>
+
+#include "monotonicClock.h"
+#include "telemetry.h"
+
+namespace
+{
+
+void copy3(float out[3], const hduVector3Dd& v)
+{
+    out[0] = (float) v[0];
+    out[1] = (float) v[1];
+    out[2] = (float) v[2];
+}
+
+} // namespace
+
+Telemetry::Telemetry()
+    : m_out(NULL), m_startTime(0), m_every(1), m_skipped(0)
+{
+}
+
+Telemetry::~Telemetry()
+{
+    close();
+}
+
+bool Telemetry::open(const char* path, int every)
+{
+    close();
+
+    if (strcmp(path, "-") == 0)
+    {
+        m_out = stdout;
+    }
+    else
+    {
+        m_out = fopen(path, "w");
+        if (m_out == NULL)
+        {
+            fprintf(stderr, "Cannot create telemetry file '%s'.\n", path);
+            return false;
+        }
+    }
+    fprintf(m_out, "tick,time,callback_us,hip_x,hip_y,hip_z,f_x,f_y,f_z,"
+                   "sphere_x,sphere_y,sphere_z,sphere_vx,sphere_vy,sphere_vz,"
+                   "sphere_fx,sphere_fy,sphere_fz\n");
+
+    m_startTime = monotonicSeconds();
+    m_every = every;
+    m_skipped = 0;
+    m_drain.start(kTickRingCapacity,
+                  [this](const TelemetrySample* samples, size_t count) { write(samples, count); });
+    return true;
+}
+
+void Telemetry::close()
+{
+    if (m_out == NULL)
+    {
+        return;
+    }
+
+    m_drain.stop();
+    if (m_out == stdout)
+    {
+        fflush(m_out);
+    }
+    else
+    {
+        fclose(m_out);
+    }
+    m_out = NULL;
+
+    if (m_drain.dropped() > 0)
+    {
+        fprintf(stderr, "Telemetry dropped %lu samples.\n", m_drain.dropped());
+    }
+}
+
+void Telemetry::record(uint32_t tick, double tickStart, const hduVector3Dd& position,
+                       const hduVector3Dd& force, const BodyStates& bodies)
+{
+    if (++m_skipped < m_every)
+    {
+        return;
+    }
+    m_skipped = 0;
+
+    TelemetrySample sample;
+    sample.time = tickStart - m_startTime;
+    sample.tick = tick;
+    sample.callbackUs = (float) ((monotonicSeconds() - tickStart) * 1e6);
+    copy3(sample.hipPosition, position);
+    copy3(sample.force, force);
+    copy3(sample.spherePosition, bodies.position(0));
+    copy3(sample.sphereVelocity, bodies.velocity(0));
+    copy3(sample.sphereForce, bodies.force(0));
+
+    m_drain.push(sample);
+}
+
+/******************************************************************************
+ Drain thread side: formats a batch of samples as CSV lines.
+******************************************************************************/
+void Telemetry::write(const TelemetrySample* samples, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        const TelemetrySample& s = samples[i];
+        fprintf(m_out, "%u,%.6f,%.2f,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g,%g\n",
+                s.tick, s.time, s.callbackUs,
+                s.hipPosition[0], s.hipPosition[1], s.hipPosition[2],
+                s.force[0], s.force[1], s.force[2],
+                s.spherePosition[0], s.spherePosition[1], s.spherePosition[2],
+                s.sphereVelocity[0], s.sphereVelocity[1], s.sphereVelocity[2],
+                s.sphereForce[0], s.sphereForce[1], s.sphereForce[2]);
+    }
+    if (m_out == stdout)
+    {
+        fflush(m_out);
+    }
+}
+
+/******************************************************************************/
@@ -0,0 +1,79 @@
+/*****************************************************************************
+
+Module Name:
+
+  telemetry.h
+
+Description:
+
+  Per tick diagnostics of the servo loop. The servo loop fills in one
+  TelemetrySample a tick and pushes it into a ring buffer; a drain thread
+  formats the samples and writes them to a file or the console as CSV.
+  Nothing on the servo side formats, allocates or blocks, so telemetry can
+  stay on while the device is in use.
+
+*******************************************************************************/
+
+#ifndef Telemetry_H_
+#define Telemetry_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <HDU/hduVector.h>
+
+#include "drainThread.h"
+#include "snapshot.h"
+
+struct TelemetrySample
+{
+    double time;              // seconds since telemetry started, at the start of the tick
+    uint32_t tick;            // servo tick number, counting from 1
+    float callbackUs;         // servo callback run time up to the sample (us)
+    float hipPosition[3];     // mm
+    float force[3];           // force the scene rendered on the HIP (N)
+    float spherePosition[3];  // first dynamic sphere (mm)
+    float sphereVelocity[3];  // mm/s
+    float sphereForce[3];     // net force on the sphere over its last step (N)
+};
+
+class Telemetry
+{
+public:
+    Telemetry();
+    ~Telemetry();
+
+    /* Starts the drain thread, writing to path, or to stdout when path is
+       "-". Only every Nth tick is kept. Returns false if the file cannot be
+       created. */
+    bool open(const char* path, int every);
+
+    /* Stops the drain thread after it has written everything sampled. */
+    void close();
+
+    bool active() const { return m_out != NULL; }
+
+    /* Servo loop side. Never blocks; a sample that finds the buffer full is
+       counted as dropped. tickStart is the monotonicSeconds() time the
+       tick started at. */
+    void record(uint32_t tick, double tickStart, const hduVector3Dd& position,
+                const hduVector3Dd& force, const BodyStates& bodies);
+
+    unsigned long dropped() const { return m_drain.dropped(); }
+
+private:
+    void write(const TelemetrySample* samples, size_t count);
+
+    FILE* m_out;
+    DrainThread<TelemetrySample> m_drain;
+    double m_startTime;
+    int m_every;
+    int m_skipped;
+
+    Telemetry(const Telemetry&);
+    Telemetry& operator=(const Telemetry&);
+};
+
+#endif /* Telemetry_H_ */
+
+/******************************************************************************/
@@ -0,0 +1,110 @@
+/*****************************************************************************
+
+Module Name:
+
+  wallBench.cpp
+
+Description:
+
+  Microbenchmark for the box wall penalty kernels. Times Interaction_Wall
+  called once per sphere against Interaction_WallBatch on every kernel path
+  the CPU supports, and checks that each path reproduces Interaction_Wall
+  bit for bit.
+
+  Usage: WallBench [body count] [repetitions]
+
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "wallForce.h"
+
+namespace
+{
+
+const double bench_side_length = 200;
+const double bench_k = 4.00;
+
+double elapsedNs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const int n = argc > 1 ? atoi(argv[1]) : 1000;
+    const int reps = argc > 2 ? atoi(argv[2]) : 20000;
+
+    // Spheres spread a little past the walls so roughly half of them touch one.
+    std::vector<double> px(n), py(n), pz(n), radius(n);
+    srand(578);
+    for (int i = 0; i < n; ++i)
+    {
+        px[i] = (rand() / (double) RAND_MAX - 0.5) * (bench_side_length + 40);
+        py[i] = (rand() / (double) RAND_MAX - 0.5) * (bench_side_length + 40);
+        pz[i] = (rand() / (double) RAND_MAX - 0.5) * (bench_side_length + 40);
+        radius[i] = 2 + 18 * (rand() / (double) RAND_MAX);
+    }
+
+    // Reference: the per-sphere scalar function.
+    std::vector<double> refX(n), refY(n), refZ(n);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int r = 0; r < reps; ++r)
+    {
+        for (int i = 0; i < n; ++i)
+        {
+            const hduVector3Dd f = Interaction_Wall(hduVector3Dd(px[i], py[i], pz[i]),
+                                                    radius[i], bench_k, bench_side_length);
+            refX[i] = f[0];
+            refY[i] = f[1];
+            refZ[i] = f[2];
+        }
+    }
+    const double refNs = elapsedNs(start) / reps;
+    printf("%-20s %10.1f ns/batch %8.2f ns/body\n", "Interaction_Wall", refNs, refNs / n);
+
+    int failures = 0;
+    const WallKernelPath best = detectWallKernelPath();
+    for (int p = WALL_KERNEL_SCALAR; p <= best; ++p)
+    {
+        const WallKernelPath path = (WallKernelPath) p;
+        setWallKernelPath(path);
+
+        std::vector<double> fx(n), fy(n), fz(n);
+        start = std::chrono::steady_clock::now();
+        for (int r = 0; r < reps; ++r)
+        {
+            memset(&fx[0], 0, n * sizeof(double));
+            memset(&fy[0], 0, n * sizeof(double));
+            memset(&fz[0], 0, n * sizeof(double));
+            Interaction_WallBatch(&px[0], &py[0], &pz[0], &radius[0], n,
+                                  bench_k, bench_side_length,
+                                  &fx[0], &fy[0], &fz[0]);
+        }
+        const double ns = elapsedNs(start) / reps;
+
+        const bool exact = memcmp(&fx[0], &refX[0], n * sizeof(double)) == 0 &&
+                           memcmp(&fy[0], &refY[0], n * sizeof(double)) == 0 &&
+                           memcmp(&fz[0], &refZ[0], n * sizeof(double)) == 0;
+        if (!exact)
+        {
+            ++failures;
+        }
+
+        char label[32];
+        sprintf(label, "batch %s", wallKernelPathName(path));
+        printf("%-20s %10.1f ns/batch %8.2f ns/body  %5.2fx  %s\n",
+               label, ns, ns / n, refNs / ns, exact ? "exact" : "MISMATCH");
+    }
+
+    return failures == 0 ? 0 : 1;
+}
+
+/******************************************************************************/
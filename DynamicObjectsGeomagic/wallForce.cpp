@@ -0,0 +1,276 @@
+/*****************************************************************************
+
+Module Name:
+
+  wallForce.cpp
+
+Description:
+
+  Scalar and vectorized box wall penalty forces.
+
+  Each axis of Interaction_Wall computes
+
+      w = 0 + (p + r >  h ? k * ((h - p) - r) : 0)
+            + (p - r < -h ? k * ((-h - p) + r) : 0)
+
+  The batch kernels evaluate both candidate forces for every sphere and keep
+  them with a compare mask instead of a branch, then add them in the same
+  order starting from zero. That keeps every path bit for bit identical to
+  the scalar function.
+
+*******************************************************************************/
+
+#include "wallForce.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+# define WALL_KERNEL_X86
+# include <immintrin.h>
+# if defined(_MSC_VER)
+#  include <intrin.h>
+# endif
+#endif
+
+#if defined(WALL_KERNEL_X86) && defined(__GNUC__)
+# define WALL_TARGET_AVX2 __attribute__((target("avx2")))
+# define WALL_TARGET_SSE2 __attribute__((target("sse2")))
+#else
+# define WALL_TARGET_AVX2
+# define WALL_TARGET_SSE2
+#endif
+
+namespace
+{
+WallKernelPath gWallKernelPath = detectWallKernelPath();
+}
+
+/******************************************************************************
+ Wall force on a single sphere.
+******************************************************************************/
+hduVector3Dd Interaction_Wall(const hduVector3Dd& position, const double& radius, const double& k, const double& side_length) {
+    hduVector3Dd wallForce;
+	for (int i = 0; i < 3; ++i){
+		if (position[i] + radius > side_length / 2) {
+        wallForce[i] += k * (side_length / 2 - position[i] - radius);
+		}
+		if (position[i] - radius < -side_length / 2) {
+			wallForce[i] += k * (-side_length / 2 - position[i] + radius);
+		}
+	}
+    return wallForce;
+}
+
+/******************************************************************************
+ Wall spring stiffness on a single sphere, using the same contact tests as
+ Interaction_Wall.
+******************************************************************************/
+hduVector3Dd Interaction_WallStiffness(const hduVector3Dd& position, double radius, double k, double side_length)
+{
+    hduVector3Dd stiffness;
+    for (int i = 0; i < 3; ++i)
+    {
+        if (position[i] + radius > side_length / 2)
+        {
+            stiffness[i] += k;
+        }
+        if (position[i] - radius < -side_length / 2)
+        {
+            stiffness[i] += k;
+        }
+    }
+    return stiffness;
+}
+
+/******************************************************************************
+ Checks the CPU for AVX2 and SSE2 support.
+******************************************************************************/
+WallKernelPath detectWallKernelPath()
+{
+#if defined(WALL_KERNEL_X86) && defined(__GNUC__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return WALL_KERNEL_AVX2;
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        return WALL_KERNEL_SSE2;
+    }
+#elif defined(WALL_KERNEL_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    const int maxLeaf = info[0];
+    if (maxLeaf >= 7)
+    {
+        // AVX2 also needs the OS to save the YMM registers.
+        __cpuid(info, 1);
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+        __cpuidex(info, 7, 0);
+        const bool avx2 = (info[1] & (1 << 5)) != 0;
+        if (osxsave && avx && avx2 && (_xgetbv(0) & 0x6) == 0x6)
+        {
+            return WALL_KERNEL_AVX2;
+        }
+    }
+    __cpuid(info, 1);
+    if (info[3] & (1 << 26))
+    {
+        return WALL_KERNEL_SSE2;
+    }
+#endif
+    return WALL_KERNEL_SCALAR;
+}
+
+WallKernelPath wallKernelPath()
+{
+    return gWallKernelPath;
+}
+
+void setWallKernelPath(WallKernelPath path)
+{
+    gWallKernelPath = path <= detectWallKernelPath() ? path : WALL_KERNEL_SCALAR;
+}
+
+const char* wallKernelPathName(WallKernelPath path)
+{
+    switch (path)
+    {
+    case WALL_KERNEL_AVX2:
+        return "avx2";
+    case WALL_KERNEL_SSE2:
+        return "sse2";
+    default:
+        return "scalar";
+    }
+}
+
+namespace
+{
+
+/******************************************************************************
+ Branchless wall force on one axis of one sphere.
+******************************************************************************/
+inline double wallAxisScalar(double p, double r, double k, double hi, double lo)
+{
+    const double upper = (p + r > hi) ? k * ((hi - p) - r) : 0.0;
+    const double lower = (p - r < lo) ? k * ((lo - p) + r) : 0.0;
+    return (0.0 + upper) + lower;
+}
+
+void wallBatchScalar(const double* px, const double* py, const double* pz,
+                     const double* radius, int begin, int end,
+                     double k, double hi, double lo,
+                     double* fx, double* fy, double* fz)
+{
+    for (int i = begin; i < end; ++i)
+    {
+        fx[i] += wallAxisScalar(px[i], radius[i], k, hi, lo);
+        fy[i] += wallAxisScalar(py[i], radius[i], k, hi, lo);
+        fz[i] += wallAxisScalar(pz[i], radius[i], k, hi, lo);
+    }
+}
+
+#if defined(WALL_KERNEL_X86)
+
+WALL_TARGET_SSE2 inline __m128d wallAxisSse2(__m128d p, __m128d r, __m128d k,
+                                             __m128d hi, __m128d lo)
+{
+    const __m128d upperMask = _mm_cmpgt_pd(_mm_add_pd(p, r), hi);
+    const __m128d lowerMask = _mm_cmplt_pd(_mm_sub_pd(p, r), lo);
+    const __m128d upper = _mm_and_pd(upperMask,
+        _mm_mul_pd(k, _mm_sub_pd(_mm_sub_pd(hi, p), r)));
+    const __m128d lower = _mm_and_pd(lowerMask,
+        _mm_mul_pd(k, _mm_add_pd(_mm_sub_pd(lo, p), r)));
+    return _mm_add_pd(_mm_add_pd(_mm_setzero_pd(), upper), lower);
+}
+
+WALL_TARGET_SSE2 int wallBatchSse2(const double* px, const double* py, const double* pz,
+                                   const double* radius, int n,
+                                   double k, double hi, double lo,
+                                   double* fx, double* fy, double* fz)
+{
+    const __m128d vk = _mm_set1_pd(k);
+    const __m128d vhi = _mm_set1_pd(hi);
+    const __m128d vlo = _mm_set1_pd(lo);
+
+    int i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        const __m128d r = _mm_loadu_pd(radius + i);
+        _mm_storeu_pd(fx + i, _mm_add_pd(_mm_loadu_pd(fx + i),
+            wallAxisSse2(_mm_loadu_pd(px + i), r, vk, vhi, vlo)));
+        _mm_storeu_pd(fy + i, _mm_add_pd(_mm_loadu_pd(fy + i),
+            wallAxisSse2(_mm_loadu_pd(py + i), r, vk, vhi, vlo)));
+        _mm_storeu_pd(fz + i, _mm_add_pd(_mm_loadu_pd(fz + i),
+            wallAxisSse2(_mm_loadu_pd(pz + i), r, vk, vhi, vlo)));
+    }
+    return i;
+}
+
+WALL_TARGET_AVX2 inline __m256d wallAxisAvx2(__m256d p, __m256d r, __m256d k,
+                                             __m256d hi, __m256d lo)
+{
+    const __m256d upperMask = _mm256_cmp_pd(_mm256_add_pd(p, r), hi, _CMP_GT_OQ);
+    const __m256d lowerMask = _mm256_cmp_pd(_mm256_sub_pd(p, r), lo, _CMP_LT_OQ);
+    const __m256d upper = _mm256_and_pd(upperMask,
+        _mm256_mul_pd(k, _mm256_sub_pd(_mm256_sub_pd(hi, p), r)));
+    const __m256d lower = _mm256_and_pd(lowerMask,
+        _mm256_mul_pd(k, _mm256_add_pd(_mm256_sub_pd(lo, p), r)));
+    return _mm256_add_pd(_mm256_add_pd(_mm256_setzero_pd(), upper), lower);
+}
+
+WALL_TARGET_AVX2 int wallBatchAvx2(const double* px, const double* py, const double* pz,
+                                   const double* radius, int n,
+                                   double k, double hi, double lo,
+                                   double* fx, double* fy, double* fz)
+{
+    const __m256d vk = _mm256_set1_pd(k);
+    const __m256d vhi = _mm256_set1_pd(hi);
+    const __m256d vlo = _mm256_set1_pd(lo);
+
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m256d r = _mm256_loadu_pd(radius + i);
+        _mm256_storeu_pd(fx + i, _mm256_add_pd(_mm256_loadu_pd(fx + i),
+            wallAxisAvx2(_mm256_loadu_pd(px + i), r, vk, vhi, vlo)));
+        _mm256_storeu_pd(fy + i, _mm256_add_pd(_mm256_loadu_pd(fy + i),
+            wallAxisAvx2(_mm256_loadu_pd(py + i), r, vk, vhi, vlo)));
+        _mm256_storeu_pd(fz + i, _mm256_add_pd(_mm256_loadu_pd(fz + i),
+            wallAxisAvx2(_mm256_loadu_pd(pz + i), r, vk, vhi, vlo)));
+    }
+    return i;
+}
+
+#endif /* WALL_KERNEL_X86 */
+
+} // namespace
+
+/******************************************************************************
+ Wall forces for a batch of spheres. The vector kernels handle whole groups
+ of 4 (AVX2) or 2 (SSE2) spheres and the scalar kernel finishes the rest.
+******************************************************************************/
+void Interaction_WallBatch(const double* px, const double* py, const double* pz,
+                           const double* radius, int n,
+                           double k, double side_length,
+                           double* fx, double* fy, double* fz)
+{
+    // Same expressions as Interaction_Wall, so the bounds round identically.
+    const double hi = side_length / 2;
+    const double lo = -side_length / 2;
+
+    int done = 0;
+#if defined(WALL_KERNEL_X86)
+    if (gWallKernelPath == WALL_KERNEL_AVX2)
+    {
+        done = wallBatchAvx2(px, py, pz, radius, n, k, hi, lo, fx, fy, fz);
+    }
+    else if (gWallKernelPath == WALL_KERNEL_SSE2)
+    {
+        done = wallBatchSse2(px, py, pz, radius, n, k, hi, lo, fx, fy, fz);
+    }
+#endif
+    wallBatchScalar(px, py, pz, radius, done, n, k, hi, lo, fx, fy, fz);
+}
+
+/******************************************************************************/
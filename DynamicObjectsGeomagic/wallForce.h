@@ -0,0 +1,57 @@
+/*****************************************************************************
+
+Module Name:
+
+  wallForce.h
+
+Description:
+
+  Penalty forces from the walls of the cubic box that contains the scene.
+  Interaction_Wall handles one sphere (the HIP); Interaction_WallBatch
+  handles every dynamic sphere at once with a branchless kernel that uses
+  AVX2 or SSE2 when the CPU has them and plain C++ otherwise. All paths
+  evaluate the same floating point operations in the same order, so they
+  return exactly the result of Interaction_Wall.
+
+*******************************************************************************/
+
+#ifndef WallForce_H_
+#define WallForce_H_
+
+#include <HDU/hduVector.h>
+
+//Calculate wall interactions based on radius and position.  Return force vector.  For cube (if want different side lengths take side_lengths as arg).
+hduVector3Dd Interaction_Wall(const hduVector3Dd& position, const double& radius, const double& k, const double& side_length);
+
+/* Stiffness of the wall springs acting on a sphere, per axis: k for every
+   wall the sphere penetrates along that axis, 0 otherwise. */
+hduVector3Dd Interaction_WallStiffness(const hduVector3Dd& position, double radius, double k, double side_length);
+
+/* Instruction set used by Interaction_WallBatch. */
+enum WallKernelPath
+{
+    WALL_KERNEL_SCALAR,
+    WALL_KERNEL_SSE2,
+    WALL_KERNEL_AVX2
+};
+
+/* Best path supported by this CPU. */
+WallKernelPath detectWallKernelPath();
+
+/* Path currently used by Interaction_WallBatch. Defaults to the detected
+   path; setting a path the CPU does not support falls back to scalar. */
+WallKernelPath wallKernelPath();
+void setWallKernelPath(WallKernelPath path);
+
+const char* wallKernelPathName(WallKernelPath path);
+
+/* Adds the wall force on each of n spheres, given as separate x/y/z
+   position arrays and a radius array, to the force arrays fx/fy/fz. */
+void Interaction_WallBatch(const double* px, const double* py, const double* pz,
+                           const double* radius, int n,
+                           double k, double side_length,
+                           double* fx, double* fy, double* fz);
+
+#endif /* WallForce_H_ */
+
+/******************************************************************************/
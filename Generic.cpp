@@ -23,16 +23,102 @@ Description:
 *******************************************************************************/
 
 #include <stdio.h>
-#include <conio.h>
+#include <string.h>
+#include <chrono>
 #include <iostream>
 
+#if defined(WIN32)
+# include <conio.h>
+#else
+# include "conio.h"
+#endif
+
 /* Sensable's includes */
 #include <HD/hd.h>
 #include <HDU/hduError.h>
 #include <HDU/hduVector.h>
 
+#include "asyncLog.h"
+#include "consoleEvents.h"
+#include "distanceGrid.h"
+#include "forceField.h"
+#include "realtime.h"
+
+#ifdef SERVO_BENCH
+#include "servoBench.h"
+#endif
+
 HDSchedulerHandle gCallbackHandle = 0;
 
+/* What the main loop sleeps on: keys, quit signals, and the callback
+   telling it the scheduler stopped it. */
+ConsoleEvents gConsoleEvents;
+
+/* The main loop also checks the callback at this interval (ms), in case it
+   is stopped without being able to say so. */
+const int kSchedulerCheckInterval = 500;
+
+/* Messages from the servo loop. Written out by a background thread, and
+   each message at most once a second. */
+AsyncLog gServoLog;
+const double kServoLogInterval = 1.0;
+
+/* Real-time setup (--rt and friends). */
+RealtimeOptions gRealtime;
+
+/* The four lab effects, each a force scene of one primitive, and a scene
+   mixing three of them. All use the same stiffness (N/mm); lengths are in
+   mm. */
+const double kStiffness = 0.20;
+
+/* Plane through (0, 10, 2) facing +y: the user feels it from above. */
+ForceScene<PlaneField> gPlaneScene(
+    PlaneField(hduVector3Dd(0, 1, 0), hduVector3Dd(0, 10, 2), kStiffness));
+
+/* 10 mm box around the origin holding the HIP in, open towards the user (+z). */
+ForceScene<BoxField> gBoxScene(
+    BoxField(hduVector3Dd(-5, -5, -5), hduVector3Dd(5, 5, 5), kStiffness, BoxField::MAX_Z));
+
+/* Rigid sphere of radius 5 at (10, 10, 10). */
+ForceScene<SphereField> gSphereScene(
+    SphereField(hduVector3Dd(10, 10, 10), 5, kStiffness));
+
+/* Gravity well at (5, 5, 5), a spring inside 20 mm. */
+ForceScene<GravityWellField> gGravityScene(
+    GravityWellField(hduVector3Dd(5, 5, 5), 20, kStiffness));
+
+/* 40 mm box open towards the user, with a sphere of radius 5 resting on its
+   floor and a gravity well at its center pulling the HIP in. */
+typedef ForceScene<BoxField, SphereField, GravityWellField> MixedScene;
+MixedScene gMixedScene(
+    BoxField(hduVector3Dd(-20, -20, -20), hduVector3Dd(20, 20, 20), kStiffness, BoxField::MAX_Z),
+    SphereField(hduVector3Dd(0, -15, 0), 5, kStiffness),
+    GravityWellField(hduVector3Dd(0, 0, 0), 20, kStiffness));
+
+enum Effect
+{
+    EFFECT_PLANE,
+    EFFECT_BOX,
+    EFFECT_SPHERE,
+    EFFECT_GRAVITY,
+    EFFECT_MIXED,
+    EFFECT_SDF // whichever effect --sdf baked
+};
+
+/* Effect rendered, chosen with --effect=plane|box|sphere|gravity|mixed. The
+   sphere is the default, as it was the force the callback used to send. */
+Effect gEffect = EFFECT_SPHERE;
+const char* const kEffectNames[] = { "plane", "box", "sphere", "gravity", "mixed" };
+
+/* With --sdf, the effect is baked into a distance grid at startup and the
+   callback renders the grid instead, with a single trilinear lookup. */
+bool gUseSdf = false;
+DistanceGrid gSdfGrid;
+ForceScene<SdfField> gSdfScene(SdfField(&gSdfGrid, 0, kStiffness));
+
+bool parseEffect(int& argc, char* argv[]);
+bool bakeEffect();
+
 void mainLoop();
 HDCallbackCode HDCALLBACK FrictionlessPlaneCallback(void *pUserData);
 
@@ -40,10 +126,30 @@ HDCallbackCode HDCALLBACK FrictionlessPlaneCallback(void *pUserData);
 /******************************************************************************
  Main : Program entry point
 ******************************************************************************/
+#ifndef SERVO_BENCH
 int main(int argc, char* argv[])
 {  
     HDErrorInfo error;
 
+    if (!parseEffect(argc, argv) || !parseRealtimeOptions(argc, argv, gRealtime))
+    {
+        fprintf(stderr, "  --effect=NAME       plane, box, sphere (default), gravity, or mixed (box,\n");
+        fprintf(stderr, "                      sphere and gravity well together)\n");
+        fprintf(stderr, "  --sdf               render the effect from a baked distance grid\n");
+        printRealtimeOptionsUsage(stderr);
+        return -1;
+    }
+    if (gUseSdf && !bakeEffect())
+    {
+        return -1;
+    }
+
+    /* Before any thread starts, so that all of them leave the quit signals to the main loop. */
+    if (!gConsoleEvents.open())
+    {
+        return -1;
+    }
+
     // Initialize the default haptic device.
     HHD hHD = hdInitDevice(HD_DEFAULT_DEVICE);
     if (HD_DEVICE_ERROR(error = hdGetError()))
@@ -62,12 +168,15 @@ int main(int argc, char* argv[])
     printf("Move the stylus around. Can you feel the wall(s)?\n");
 	printf("You're an official haptician now !!\n");
 	printf("-----------------------------------\n");
-	printf("Plane example.\n");
+	printf("Effect: %s.\n", kEffectNames[gEffect]);
     printf("Press Q key to quit.\n\n");
 
     /* to enable the motors call:  hdEnable(HD_FORCE_OUTPUT); */
 	hdEnable(HD_FORCE_OUTPUT);
 
+    gServoLog.start(stdout, kServoLogInterval);
+    rtSetupProcess(gRealtime);
+
     /* Start the haptic rendering loop. */
     hdStartScheduler();
     if (HD_DEVICE_ERROR(error = hdGetError()))
@@ -86,31 +195,158 @@ int main(int argc, char* argv[])
     hdStopScheduler();
     hdUnschedule(gCallbackHandle);
     hdDisableDevice(hHD);
+    gServoLog.stop();
+    rtReport(stderr);
 
     return 0;
 }
+#else
+/* Servo loop benchmark: runs the force callback, with the effect picked by
+   --effect, on the simulated device. */
+int main(int argc, char* argv[])
+{
+    HDErrorInfo error;
+
+    ServoBenchOptions bench;
+    if (!parseServoBenchOptions(argc, argv, bench) || !parseEffect(argc, argv) ||
+        !parseRealtimeOptions(argc, argv, gRealtime))
+    {
+        return -1;
+    }
+    if (gUseSdf && !bakeEffect())
+    {
+        return -1;
+    }
+
+    HHD hHD = hdInitDevice(HD_DEFAULT_DEVICE);
+    if (HD_DEVICE_ERROR(error = hdGetError()))
+    {
+        hduPrintError(stderr, &error, "Failed to initialize haptic device");
+        return -1;
+    }
+    hdEnable(HD_FORCE_OUTPUT);
+    gServoLog.start(stderr, kServoLogInterval);
+    rtSetupProcess(gRealtime);
+
+    int result = runServoBench(bench, FrictionlessPlaneCallback, 0);
+
+    hdDisableDevice(hHD);
+    gServoLog.stop();
+    rtReport(stderr);
+    return result;
+}
+#endif
+
+
+/******************************************************************************
+ Takes --effect=NAME and --sdf out of the command line.
+******************************************************************************/
+bool parseEffect(int& argc, char* argv[])
+{
+    int kept = 1;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--sdf") == 0)
+        {
+            gUseSdf = true;
+            continue;
+        }
+        if (strncmp(argv[i], "--effect=", 9) != 0)
+        {
+            argv[kept++] = argv[i];
+            continue;
+        }
+
+        const char* name = argv[i] + 9;
+        int effect = 0;
+        while (effect <= EFFECT_MIXED && strcmp(name, kEffectNames[effect]) != 0)
+        {
+            ++effect;
+        }
+        if (effect > EFFECT_MIXED)
+        {
+            fprintf(stderr, "Unknown effect '%s'.\n", name);
+            return false;
+        }
+        gEffect = (Effect) effect;
+    }
+    argc = kept;
+    argv[argc] = NULL;
+    return true;
+}
+
+
+/******************************************************************************
+ Bakes the distance of a primitive's surface on the box from lo to hi.
+******************************************************************************/
+template <typename Field>
+void bakeField(const Field& field, const hduVector3Dd& lo, const hduVector3Dd& hi, double cellSize)
+{
+    gSdfGrid.bake(lo, hi, cellSize, [&field](const hduVector3Dd& p) { return field.distance(p); });
+}
+
+/******************************************************************************
+ Bakes the chosen effect into gSdfGrid. The grid covers the surface with a
+ 20 mm margin; the plane's distance is linear, so a coarse grid reproduces
+ it exactly. The gravity well has no surface to bake, so neither has the
+ mixed scene as a whole.
+******************************************************************************/
+bool bakeEffect()
+{
+    const hduVector3Dd margin(20, 20, 20);
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    switch (gEffect) {
+    case EFFECT_PLANE: {
+        const PlaneField& plane = gPlaneScene.field<0>();
+        const hduVector3Dd extent(100, 100, 100);
+        bakeField(plane, plane.point - extent, plane.point + extent, 5.0);
+        break;
+    }
+    case EFFECT_BOX: {
+        const BoxField& box = gBoxScene.field<0>();
+        bakeField(box, box.low - margin, box.high + margin, 0.5);
+        break;
+    }
+    case EFFECT_SPHERE: {
+        const SphereField& sphere = gSphereScene.field<0>();
+        const hduVector3Dd extent(sphere.radius, sphere.radius, sphere.radius);
+        bakeField(sphere, sphere.center - extent - margin, sphere.center + extent + margin, 0.5);
+        break;
+    }
+    default:
+        fprintf(stderr, "The %s effect has a gravity well, which has no surface to bake.\n", kEffectNames[gEffect]);
+        return false;
+    }
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    printf("Baked the %s into a %d x %d x %d distance grid (%.1f MB) in %.1f ms.\n", kEffectNames[gEffect],
+           gSdfGrid.size(0), gSdfGrid.size(1), gSdfGrid.size(2), gSdfGrid.bytes() / 1048576.0, ms);
+    return true;
+}
 
 
 /******************************************************************************
  Main loop.  
- Detects and interprets keypresses. 
+ Detects and interprets keypresses. Sleeps until a key, a quit signal or
+ the callback stopping wakes it.
 ******************************************************************************/
 void mainLoop()
 {
-    int keypress;
+    int value;
 
     while (1)
     {       
-        /* Check for keyboard input. */
-        if (_kbhit())
+        const ConsoleEvents::Event event = gConsoleEvents.wait(kSchedulerCheckInterval, value);
+
+        /* Q, or Ctrl-C, which the raw console delivers as a key. */
+        if (event == ConsoleEvents::EVENT_KEY && (toupper(value) == 'Q' || value == 3))
         {
-            keypress = _getch();
-            keypress = toupper(keypress);
-            
-            if (keypress == 'Q')
-            {
-                return;
-            }
+            return;
+        }
+
+        if (event == ConsoleEvents::EVENT_SIGNAL)
+        {
+            fprintf(stderr, "\nQuitting on signal %d.\n", value);
+            return;
         }
 
         /* Check if the main scheduler callback has exited. */
@@ -118,7 +354,9 @@ void mainLoop()
         {
             fprintf(stderr, "\nThe main scheduler callback has exited\n");
             fprintf(stderr, "\nPress any key to quit.\n");
-            _getch();
+            while (gConsoleEvents.wait(-1, value) == ConsoleEvents::EVENT_NOTIFY)
+            {
+            }
             return;
         }
     }
@@ -130,177 +368,60 @@ void mainLoop()
  *****************************************************************************/
 HDCallbackCode HDCALLBACK FrictionlessPlaneCallback(void *pUserData)
 {
+    /* With --rt, the first tick sets up this thread for real-time work. */
+    rtSetupServoThread(gRealtime);
+
     hdBeginFrame(hdGetCurrentDevice());
 
 	// Get the position of the device.
     hduVector3Dd position;
     hdGetDoublev(HD_CURRENT_POSITION, position);
 
-	//*** START EDITING HERE ***//////////////////////////////////////////////////
-	//////////////////////////////////////////////////////////////////////////////
-
- 	// you don't have to use the following variables, but they may be useful
-	hduVector3Dd normal(0,0,0);
-	hduVector3Dd f(0,0,0);
-	double  dist = 0;
+    /* No system calls from here to the end of the frame (checked in debug builds). */
+    rtServoPathBegin();
 
 	//*** START EDITING HERE ***//////////////////////////////////////////////////
 	//////////////////////////////////////////////////////////////////////////////
 
-	//We use the same stiffness k for all examples below.  In the lab, we will have different cpps for each example, so we will have to redefine it in each.
-    //Note that k measured in N/mm.
-    HDdouble k = 0.20;
-
-    //////////////////////////////GENERIC PLANE/////////////////////////////////////////////////
-    /* Implement the algorithm covered in class
-    to create a frictionless oriented 3D plane with an offset, as defined by a point on the plane and the normal to the plane.
-    Indicate the orientation of the plane you chose clearly in your comment*/
-
-    //Note that in the future, this could be better done by having a plane struct with normal and point vector members.
-    hduVector3Dd planeNormal(0, 1, 0);
-    hduVector3Dd planePoint(0, 10, 2);
-
-    //Make sure that planeNormal is a unit vector.
-    planeNormal.normalize();
-
-    //r is the vector from the point on the plane planePoint to the user position.
-    hduVector3Dd r = position - planePoint;
-
-    //d is the impression of r onto planeNormal: if d is negative, the user is on or in the wall.  If d is positive, the user is outside of the wall.
-    HDdouble d = dotProduct(r, planeNormal);
-
-    //We initalize our force output var.
-    f.set(0, 0, 0);
-
-    //If d is negative, the user is on or in the wall.  If d is positive, the user is outside of the wall.
-    if (d <= 0) {
-		std::cout << "Collision detected\n";
-        f = -1 * k * d * planeNormal;
-    }
-
-    // command the desired force "f". You must determine the value of "f" before using this line.
-	hdSetDoublev(HD_CURRENT_FORCE, f);
-
-    //Displaying force prob important.  Use  [ ].
-
-
-	//std::cout<< position[0] << " " << position[1] << " " << position[2] << std::endl;
-
-	// command the desired force "f". You must determine the value of "f" before using this line.
-	
-
-	hdSetDoublev(HD_CURRENT_FORCE, f);
-
-    ////////////////////////////////////////////////////////////5 Sided box.////////////////////////
-    
-    //Recall that we put our point into 'position'.
-    //By far the simplest way to do this is with chained if statements.
-    //We initalize our force output var.
-    hduVector3Dd f(0, 0, 0);
-
-    //I don't know what the scale of internal distance units, so we will arbitrarily decide to make a 10x10x10 in this.
-    //May have to flip a sign in case the box is facing the wrong way (opening should face user).
-    //Again, can improve 'elegance' by encapsulating in classes.  Check with professor if wants this.
-    //z is the side facing use that we likely want open (positive z).
-    //These ints set the limits of the box in the x, y, z axes.
-    int xMin = -5;
-    int xMax = 5;
-    int yMin = -5;
-    int yMax = 5;
-    int zMin = -5;
-
-    //Could also hide this in function and loop call but likely meaningless complication.
-    //x
-    if (position[0] > xMax) {
-        f[0] += k * (xMax - position[0]);
-    }
-    //Use else if as HIP is a point.
-    else if (position[0] < xMin) {
-        f[0] += k * (xMin - position[0]);
-    }
-    //y
-    if (position[1] > yMax) {
-        f[1] += k * (yMax - position[0]);
-    }
-    //Use else if as HIP is a point.
-    else if (position[1] < yMin) {
-        f[1] += k * (yMin - position[0]);
-    }
-    //z -- note that box is open facing user.
-    if (position[0] < zMin) {
-        f[2] += k * (zMin - position[0]);
-    }
-    
-    //Render the force.
-    hdSetDoublev(HD_CURRENT_FORCE, f);
-
-    ////////////////////////////////////////////////////Render a 3d rigid sphere//////////////////////////////
-    //Define the center in x y z of the sphere.
-    //Define the sphere radius.  Is there an advanrage to using the HDdouble over standard c++ types?
-    hduVector3Dd sphereCenter(10, 10, 10);
-    HDdouble sphereRadius = 5;
-
-    hduVector3Dd f(0, 0, 0);
-
-    //Division and square root etc are generally expensive operations.  Magnitudes are always positive.  
-    //Thus, we can speed up processing by comparing the sphereRadius^2 to the distance between hip and sphereCenter squared.
-
-    //The distance between position and the sphereCenter.  Note that pow might not be defined for HDdouble type...
-    HDdouble distance = 0;
-    //Loop through the axises as this is an opportunity to condense without it being too obfuscated.
-    //Note: These loops are technically less efficient with n+1 additional operations (initialize i and increment).
-    //Can also just use .magnitude() but is more than 4x expensive.
-    for (int i = 0; i < 2; ++i) {
-        distanceSquared += pow(position[i] - sphereCenter[i]), 2);
+    //The effects are force scenes (see forceField.h), built once above.  Each scene's force is a sum of its
+    //primitives' forces, inlined at compile time, so picking the effect is the only branch here; the mixed
+    //scene adds up its three primitives in one call.
+    //With --sdf the effect was baked into a distance grid, and any of them costs the same single lookup.
+    hduVector3Dd f;
+    switch (gUseSdf ? EFFECT_SDF : gEffect) {
+    case EFFECT_SDF:
+        f = gSdfScene.force(position);
+        break;
+    case EFFECT_PLANE: {
+        f = gPlaneScene.force(position);
+        const double depth = gPlaneScene.field<0>().depth(position);
+        if (depth > 0) {
+            ASYNC_LOG(gServoLog, "Collision detected, %.2f mm into the plane", depth);
+        }
+        break;
     }
-
-    //If distance is less than sphereRadius, we are inside the sphere.
-    //We compared the squared values as this is faster.
-    if (distanceSquared < pow(sphereRadius, 2)) {
-        //We find the unit vector from the center of the sphere to the HIP position.
-        hduVector3Dd rHat;
-        rHat = position - sphereCenter;
-        //Normalize the vector.
-        rHat.normalize();
-
-        //Set f.  May have to static cast to double for distanceSquared.  Note that this is still optimal because we
-        //don't need to do the sqrt operation in non collision cases.
-        f = k * (sphereRadius - sqrt(distanceSquared)) * rHat;
+    case EFFECT_BOX:
+        f = gBoxScene.force(position);
+        break;
+    case EFFECT_SPHERE:
+        f = gSphereScene.force(position);
+        break;
+    case EFFECT_MIXED:
+        f = gMixedScene.force(position);
+        break;
+    default:
+        f = gGravityScene.force(position);
+        break;
     }
 
-    hdSetDoublev(HD_CURRENT_FORCE, f);
-
-    //////////////////////////////////////////////////////////Gravitational Pull//////////////////////////////////
-    //Define some arbitrary gravitationalPoint.
-    hduVector3Dd gravitationalPoint(5, 5, 5);
-
-    //d is the vector from the gravitational point to the position HIP.
-    hduVector3Dd d = position - gravitationalPoint;
-
-    //Then just implement as per slide 27...  R is arbitraily defined and F(r) should be continuous.  Find k2 algorithmically based on r.
-    //Note: can use .magnitude().
-	
-	//R defined in mm abritrarily.
-	R = 20;
-    
-	//We split the forces at R into a gravitational case and a spring case.
-	if (d.magnitude() > R){
-		f = -1*k/pow(d.magnituide, 2)*d.normalize();		
-	}
-	
-	if (d.magnitude() <= R){
-		//We set k2 to be equal to k/R^3 so that the force feedback is continuous.
-		//If wanted to optimize could make this a const outside of recurring loop so its not repeatedly calced.
-		k2 = k/pow(R,3);
-		f = -1*k2*d;	//Note that d.magnitude()*d.normalize == d.
-	}
-    
-
-
+    // command the desired force "f".
+	hdSetDoublev(HD_CURRENT_FORCE, f);
 
 	//////////////////////////////////////////////////////////////////////////////////
 	//*** STOP EDITING HERE ***//////////////////////////////////////////////////////
 
+    rtServoPathEnd();
+
 	hdEndFrame(hdGetCurrentDevice());
 
     /* Check if an error occurred while attempting to render the force */
@@ -309,6 +430,7 @@ HDCallbackCode HDCALLBACK FrictionlessPlaneCallback(void *pUserData)
     {
         if (hduIsSchedulerError(&error))
 		{
+            gConsoleEvents.notify();
             return HD_CALLBACK_DONE;
         }
     }
@@ -0,0 +1,177 @@
+/*****************************************************************************
+
+Module Name:
+
+  hd.h
+
+Description:
+
+  Simulated HD device backend. Declares the subset of the OpenHaptics HDAPI
+  used by the programs in this repository so they can be built and run
+  without the SDK or a physical device attached. Build with
+  "make SIMDEVICE=1" to compile against this directory and simDevice.cpp
+  instead of the SDK headers and libraries.
+
+  The simulated device runs the scheduler at a real 1 kHz (or the 500 Hz,
+  2, 4 or 8 kHz set with hdSetSchedulerRate) and moves the HIP along a
+  scripted or replayed trajectory chosen with environment variables:
+
+    SIMHD_TRAJECTORY  still (default), circle, sweep, or the path of a text
+                      file of "t x y z" lines (seconds, mm) to replay
+    SIMHD_CENTER      "x,y,z" center of the motion in mm (default 0,0,0)
+    SIMHD_RADIUS      circle radius or sweep amplitude in mm (default 50)
+    SIMHD_PERIOD      seconds per circle or sweep (default 4)
+    SIMHD_CATCHUP     what to do with ticks an overrunning tick made late:
+                      skip (default) or substep[:N] (see servoScheduler.h)
+
+  Commanded forces are accepted and reported back but do not move the HIP.
+
+*******************************************************************************/
+
+#ifndef SimHD_H_
+#define SimHD_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(WIN32)
+# define HDCALLBACK __stdcall
+#else
+# define HDCALLBACK
+#endif
+#define HDAPI
+#define HDAPIENTRY
+
+typedef unsigned int HHD;
+typedef unsigned int HDenum;
+typedef unsigned int HDCallbackCode;
+typedef unsigned long HDSchedulerHandle;
+typedef unsigned short HDushort;
+typedef unsigned int HDuint;
+typedef unsigned long HDulong;
+typedef unsigned int HDErrorCode;
+typedef unsigned char HDboolean;
+typedef int HDint;
+typedef long HDlong;
+typedef float HDfloat;
+typedef double HDdouble;
+typedef const char* HDstring;
+
+typedef HDCallbackCode (HDCALLBACK *HDSchedulerCallback)(void* pUserData);
+
+#define HD_INVALID_HANDLE 0xFFFFFFFF
+#define HD_DEFAULT_DEVICE NULL
+
+#define HD_TRUE 1
+#define HD_FALSE 0
+
+/* Scheduler callback return codes. */
+#define HD_CALLBACK_DONE 0
+#define HD_CALLBACK_CONTINUE 1
+
+/* Scheduler priorities. */
+#define HD_MAX_SCHEDULER_PRIORITY ((HDushort) 0xffff)
+#define HD_MIN_SCHEDULER_PRIORITY ((HDushort) 0)
+#define HD_DEFAULT_SCHEDULER_PRIORITY \
+    ((HDushort) ((HD_MAX_SCHEDULER_PRIORITY + HD_MIN_SCHEDULER_PRIORITY) / 2))
+
+/* hdWaitForCompletion modes. */
+#define HD_WAIT_CHECK_STATUS 0
+#define HD_WAIT_INFINITE 1
+
+/* Error codes. */
+#define HD_SUCCESS 0x0000
+#define HD_INVALID_ENUM 0x0100
+#define HD_INVALID_VALUE 0x0101
+#define HD_INVALID_OPERATION 0x0102
+#define HD_DEVICE_ALREADY_INITIATED 0x0301
+#define HD_COMM_ERROR 0x0302
+#define HD_DEVICE_FAULT 0x0304
+#define HD_INVALID_DEVICE_HANDLE 0x0306
+#define HD_SCHEDULER_FULL 0x0402
+#define HD_INVALID_CALLBACK_HANDLE 0x0403
+#define HD_TIMER_ERROR 0x1000
+
+/* Get / set parameters. */
+#define HD_UPDATE_RATE 0x0800
+#define HD_INSTANTANEOUS_UPDATE_RATE 0x0801
+#define HD_NOMINAL_MAX_STIFFNESS 0x0802
+#define HD_NOMINAL_MAX_FORCE 0x0603
+#define HD_CURRENT_POSITION 0x2050
+#define HD_CURRENT_VELOCITY 0x2051
+#define HD_LAST_POSITION 0x2200
+#define HD_LAST_VELOCITY 0x2201
+#define HD_DEVICE_MODEL_TYPE 0x2501
+#define HD_DEVICE_DRIVER_VERSION 0x2502
+#define HD_DEVICE_VENDOR 0x2503
+#define HD_DEVICE_SERIAL_NUMBER 0x2504
+#define HD_MAX_WORKSPACE_DIMENSIONS 0x2550
+#define HD_USABLE_WORKSPACE_DIMENSIONS 0x2551
+#define HD_CURRENT_FORCE 0x2700
+#define HD_LAST_FORCE 0x2900
+
+/* Capabilities. */
+#define HD_FORCE_OUTPUT 0x4000
+#define HD_MAX_FORCE_CLAMPING 0x4001
+#define HD_FORCE_RAMPING 0x4002
+#define HD_SOFTWARE_FORCE_LIMIT 0x4003
+
+typedef struct
+{
+    HDErrorCode errorCode;
+    int internalErrorCode;
+    HHD hHD;
+} HDErrorInfo;
+
+#define HD_DEVICE_ERROR(X) (((X).errorCode) != HD_SUCCESS)
+
+/* Device management. */
+HHD HDAPIENTRY hdInitDevice(HDstring pConfigName);
+void HDAPIENTRY hdDisableDevice(HHD hHD);
+void HDAPIENTRY hdMakeCurrentDevice(HHD hHD);
+HHD HDAPIENTRY hdGetCurrentDevice();
+
+/* Frames. */
+void HDAPIENTRY hdBeginFrame(HHD hHD);
+void HDAPIENTRY hdEndFrame(HHD hHD);
+
+/* State. */
+void HDAPIENTRY hdGetBooleanv(HDenum pname, HDboolean* params);
+void HDAPIENTRY hdGetIntegerv(HDenum pname, HDint* params);
+void HDAPIENTRY hdGetFloatv(HDenum pname, HDfloat* params);
+void HDAPIENTRY hdGetDoublev(HDenum pname, HDdouble* params);
+HDstring HDAPIENTRY hdGetString(HDenum pname);
+void HDAPIENTRY hdSetFloatv(HDenum pname, const HDfloat* params);
+void HDAPIENTRY hdSetDoublev(HDenum pname, const HDdouble* params);
+
+void HDAPIENTRY hdEnable(HDenum cap);
+void HDAPIENTRY hdDisable(HDenum cap);
+HDboolean HDAPIENTRY hdIsEnabled(HDenum cap);
+
+HDErrorInfo HDAPIENTRY hdGetError();
+HDstring HDAPIENTRY hdGetErrorString(HDErrorCode errorCode);
+
+/* Scheduler. */
+void HDAPIENTRY hdStartScheduler();
+void HDAPIENTRY hdStopScheduler();
+void HDAPIENTRY hdSetSchedulerRate(HDulong rate);
+HDdouble HDAPIENTRY hdGetSchedulerTimeStamp();
+
+HDSchedulerHandle HDAPIENTRY hdScheduleAsynchronous(
+    HDSchedulerCallback pCallback, void* pUserData, HDushort nPriority);
+void HDAPIENTRY hdScheduleSynchronous(
+    HDSchedulerCallback pCallback, void* pUserData, HDushort nPriority);
+void HDAPIENTRY hdUnschedule(HDSchedulerHandle hHandle);
+HDboolean HDAPIENTRY hdWaitForCompletion(HDSchedulerHandle hHandle,
+                                         HDuint param);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SimHD_H_ */
+
+/******************************************************************************/
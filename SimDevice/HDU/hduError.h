@@ -0,0 +1,50 @@
+/*****************************************************************************
+
+Module Name:
+
+  hduError.h
+
+Description:
+
+  Simulated HD device backend. Error reporting helpers matching the
+  OpenHaptics utility library.
+
+*******************************************************************************/
+
+#ifndef SimHDUError_H_
+#define SimHDUError_H_
+
+#include <stdio.h>
+
+#include <HD/hd.h>
+
+/* Prints the error code and a readable description to the given stream. */
+inline void hduPrintError(FILE* stream, const HDErrorInfo* error,
+                          const char* message)
+{
+    fprintf(stream, "HD Error: %s\n", hdGetErrorString(error->errorCode));
+    fprintf(stream, "%s\n", message);
+    fprintf(stream, "HHD: %X\n", error->hHD);
+    fprintf(stream, "Error Code: %X\n", error->errorCode);
+    fprintf(stream, "Internal Error Code: %d\n", error->internalErrorCode);
+}
+
+/* Returns true if the error means the scheduler has stopped servicing
+   callbacks, in which case a servo callback should return HD_CALLBACK_DONE. */
+inline bool hduIsSchedulerError(const HDErrorInfo* error)
+{
+    switch (error->errorCode)
+    {
+    case HD_COMM_ERROR:
+    case HD_DEVICE_FAULT:
+    case HD_TIMER_ERROR:
+    case HD_INVALID_DEVICE_HANDLE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+#endif /* SimHDUError_H_ */
+
+/******************************************************************************/
@@ -0,0 +1,86 @@
+/*****************************************************************************
+
+Module Name:
+
+  hduMatrix.h
+
+Description:
+
+  Simulated HD device backend. A minimal stand-in for the hduMatrix class
+  from the OpenHaptics utility library, stored row major like the original
+  so get() can be handed straight to glMultMatrixd.
+
+*******************************************************************************/
+
+#ifndef SimHDUMatrix_H_
+#define SimHDUMatrix_H_
+
+#include <math.h>
+
+#include <HDU/hduVector.h>
+
+class hduMatrix
+{
+public:
+    hduMatrix() { makeIdentity(); }
+
+    void makeIdentity()
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            for (int j = 0; j < 4; ++j)
+            {
+                m[i][j] = (i == j) ? 1.0 : 0.0;
+            }
+        }
+    }
+
+    void get(double out[4][4]) const
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            for (int j = 0; j < 4; ++j)
+            {
+                out[i][j] = m[i][j];
+            }
+        }
+    }
+
+    double& operator()(int i, int j) { return m[i][j]; }
+    double operator()(int i, int j) const { return m[i][j]; }
+
+    /* Rotation of angle radians about axis, for row vectors (v' = v * M). */
+    static hduMatrix createRotation(const hduVector3Dd& axis, double angle)
+    {
+        hduMatrix r;
+        hduVector3Dd a(axis);
+        if (a.magnitude() == 0)
+        {
+            return r;
+        }
+        a.normalize();
+
+        const double c = cos(angle);
+        const double s = sin(angle);
+        const double t = 1.0 - c;
+        const double x = a[0], y = a[1], z = a[2];
+
+        r.m[0][0] = t * x * x + c;
+        r.m[0][1] = t * x * y + s * z;
+        r.m[0][2] = t * x * z - s * y;
+        r.m[1][0] = t * x * y - s * z;
+        r.m[1][1] = t * y * y + c;
+        r.m[1][2] = t * y * z + s * x;
+        r.m[2][0] = t * x * z + s * y;
+        r.m[2][1] = t * y * z - s * x;
+        r.m[2][2] = t * z * z + c;
+        return r;
+    }
+
+private:
+    double m[4][4];
+};
+
+#endif /* SimHDUMatrix_H_ */
+
+/******************************************************************************/
@@ -0,0 +1,173 @@
+/*****************************************************************************
+
+Module Name:
+
+  hduVector.h
+
+Description:
+
+  Simulated HD device backend. A source compatible stand-in for the
+  hduVector3D template from the OpenHaptics utility library, covering the
+  operations used in this repository.
+
+*******************************************************************************/
+
+#ifndef SimHDUVector_H_
+#define SimHDUVector_H_
+
+#include <math.h>
+
+#include <HD/hd.h>
+
+template <typename T>
+class hduVector3D
+{
+public:
+    typedef T EltType;
+
+    hduVector3D() { m_p[0] = 0; m_p[1] = 0; m_p[2] = 0; }
+    hduVector3D(T x, T y, T z) { m_p[0] = x; m_p[1] = y; m_p[2] = z; }
+    explicit hduVector3D(const T* p) { m_p[0] = p[0]; m_p[1] = p[1]; m_p[2] = p[2]; }
+
+    template <typename U>
+    hduVector3D(const hduVector3D<U>& v)
+    {
+        m_p[0] = T(v[0]); m_p[1] = T(v[1]); m_p[2] = T(v[2]);
+    }
+
+    operator T*() { return m_p; }
+    operator const T*() const { return m_p; }
+
+    T& operator[](int i) { return m_p[i]; }
+    const T& operator[](int i) const { return m_p[i]; }
+
+    void set(T x, T y, T z) { m_p[0] = x; m_p[1] = y; m_p[2] = z; }
+
+    hduVector3D& operator+=(const hduVector3D& v)
+    {
+        m_p[0] += v.m_p[0]; m_p[1] += v.m_p[1]; m_p[2] += v.m_p[2];
+        return *this;
+    }
+    hduVector3D& operator-=(const hduVector3D& v)
+    {
+        m_p[0] -= v.m_p[0]; m_p[1] -= v.m_p[1]; m_p[2] -= v.m_p[2];
+        return *this;
+    }
+    hduVector3D& operator*=(T s)
+    {
+        m_p[0] *= s; m_p[1] *= s; m_p[2] *= s;
+        return *this;
+    }
+    hduVector3D& operator/=(T s)
+    {
+        m_p[0] /= s; m_p[1] /= s; m_p[2] /= s;
+        return *this;
+    }
+
+    hduVector3D operator-() const
+    {
+        return hduVector3D(-m_p[0], -m_p[1], -m_p[2]);
+    }
+
+    T dotProduct(const hduVector3D& v) const
+    {
+        return m_p[0] * v.m_p[0] + m_p[1] * v.m_p[1] + m_p[2] * v.m_p[2];
+    }
+
+    hduVector3D crossProduct(const hduVector3D& v) const
+    {
+        return hduVector3D(m_p[1] * v.m_p[2] - m_p[2] * v.m_p[1],
+                           m_p[2] * v.m_p[0] - m_p[0] * v.m_p[2],
+                           m_p[0] * v.m_p[1] - m_p[1] * v.m_p[0]);
+    }
+
+    T magnitude() const { return T(sqrt(dotProduct(*this))); }
+
+    hduVector3D& normalize()
+    {
+        const T mag = magnitude();
+        if (mag != 0)
+        {
+            *this /= mag;
+        }
+        return *this;
+    }
+
+    bool isZero(T epsilon) const
+    {
+        return fabs(m_p[0]) < epsilon && fabs(m_p[1]) < epsilon &&
+               fabs(m_p[2]) < epsilon;
+    }
+
+private:
+    T m_p[3];
+};
+
+template <typename T>
+inline hduVector3D<T> operator+(const hduVector3D<T>& a, const hduVector3D<T>& b)
+{
+    return hduVector3D<T>(a[0] + b[0], a[1] + b[1], a[2] + b[2]);
+}
+
+template <typename T>
+inline hduVector3D<T> operator-(const hduVector3D<T>& a, const hduVector3D<T>& b)
+{
+    return hduVector3D<T>(a[0] - b[0], a[1] - b[1], a[2] - b[2]);
+}
+
+template <typename T>
+inline hduVector3D<T> operator*(const hduVector3D<T>& v, T s)
+{
+    return hduVector3D<T>(v[0] * s, v[1] * s, v[2] * s);
+}
+
+template <typename T>
+inline hduVector3D<T> operator*(T s, const hduVector3D<T>& v)
+{
+    return hduVector3D<T>(v[0] * s, v[1] * s, v[2] * s);
+}
+
+template <typename T>
+inline hduVector3D<T> operator/(const hduVector3D<T>& v, T s)
+{
+    return hduVector3D<T>(v[0] / s, v[1] / s, v[2] / s);
+}
+
+template <typename T>
+inline bool operator==(const hduVector3D<T>& a, const hduVector3D<T>& b)
+{
+    return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];
+}
+
+template <typename T>
+inline bool operator!=(const hduVector3D<T>& a, const hduVector3D<T>& b)
+{
+    return !(a == b);
+}
+
+template <typename T>
+inline T dotProduct(const hduVector3D<T>& a, const hduVector3D<T>& b)
+{
+    return a.dotProduct(b);
+}
+
+template <typename T>
+inline hduVector3D<T> crossProduct(const hduVector3D<T>& a, const hduVector3D<T>& b)
+{
+    return a.crossProduct(b);
+}
+
+template <typename T>
+inline hduVector3D<T> normalize(const hduVector3D<T>& v)
+{
+    hduVector3D<T> n(v);
+    return n.normalize();
+}
+
+typedef hduVector3D<HDint> hduVector3Di;
+typedef hduVector3D<HDfloat> hduVector3Df;
+typedef hduVector3D<HDdouble> hduVector3Dd;
+
+#endif /* SimHDUVector_H_ */
+
+/******************************************************************************/
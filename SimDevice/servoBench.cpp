@@ -0,0 +1,291 @@
+/*****************************************************************************
+
+Module Name:
+
+  servoBench.cpp
+
+Description:
+
+  Servo loop benchmark on the simulated device.
+
+  A tick misses its deadline when its callbacks have not returned one
+  servo period after the tick was due, i.e. the force for that period was
+  late. Samples are stored in arrays sized before the scheduler starts, so
+  measuring allocates nothing inside the servo loop.
+
+*******************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <HDU/hduError.h>
+
+#include "servoBench.h"
+#include "simDevice.h"
+
+ServoBenchOptions::ServoBenchOptions()
+    : seconds(10),
+      label(""),
+      jsonPath(NULL),
+      catchUp(NULL)
+{
+}
+
+namespace
+{
+
+// Spare sample room over the nominal tick count, so a fast clock does not drop samples.
+const double kSampleHeadroom = 1.1;
+
+struct BenchSamples
+{
+    std::vector<float> callbackUs;
+    std::vector<float> periodUs;
+    std::vector<float> latencyUs;
+    size_t count;
+    unsigned long long ticks;
+    unsigned long missed;
+    unsigned long dropped;
+    double period;
+    double previousStart;
+};
+
+/******************************************************************************
+ Tick observer, on the scheduler thread.
+******************************************************************************/
+void recordTick(const SimTickTiming& timing, void* userData)
+{
+    BenchSamples& samples = *static_cast<BenchSamples*>(userData);
+
+    ++samples.ticks;
+    if (timing.end > timing.deadline + samples.period)
+    {
+        ++samples.missed;
+    }
+
+    // The first tick has no period before it.
+    if (timing.tick > 0)
+    {
+        if (samples.count < samples.callbackUs.size())
+        {
+            const size_t i = samples.count++;
+            samples.callbackUs[i] = (float) ((timing.end - timing.start) * 1e6);
+            samples.periodUs[i] = (float) ((timing.start - samples.previousStart) * 1e6);
+            samples.latencyUs[i] = (float) ((timing.start - timing.deadline) * 1e6);
+        }
+        else
+        {
+            ++samples.dropped;
+        }
+    }
+    samples.previousStart = timing.start;
+}
+
+/* Nearest rank percentile of sorted values. */
+double percentile(const std::vector<float>& sorted, double p)
+{
+    size_t rank = (size_t) ceil(p / 100.0 * sorted.size());
+    if (rank > 0)
+    {
+        --rank;
+    }
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+/* Sorts the first count values and writes their summary as a JSON object. */
+void writeDistribution(FILE* out, const char* name, std::vector<float>& values, size_t count, bool last)
+{
+    fprintf(out, "  \"%s\": ", name);
+    if (count == 0)
+    {
+        fprintf(out, "null%s\n", last ? "" : ",");
+        return;
+    }
+
+    values.resize(count);
+    std::sort(values.begin(), values.end());
+    double sum = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        sum += values[i];
+    }
+
+    fprintf(out, "{ \"mean\": %.3f, \"p50\": %.3f, \"p99\": %.3f, \"p99_9\": %.3f, \"max\": %.3f }%s\n",
+            sum / count, percentile(values, 50), percentile(values, 99), percentile(values, 99.9),
+            values[count - 1], last ? "" : ",");
+}
+
+/* Writes a string as a JSON string literal. */
+void writeJsonString(FILE* out, const char* s)
+{
+    fputc('"', out);
+    for (; *s != '\0'; ++s)
+    {
+        const unsigned char c = (unsigned char) *s;
+        if (c == '"' || c == '\\')
+        {
+            fprintf(out, "\\%c", c);
+        }
+        else if (c < 0x20)
+        {
+            fprintf(out, "\\u%04x", c);
+        }
+        else
+        {
+            fputc(c, out);
+        }
+    }
+    fputc('"', out);
+}
+
+} // namespace
+
+/******************************************************************************
+ Parses and strips the benchmark options.
+******************************************************************************/
+bool parseServoBenchOptions(int& argc, char* argv[], ServoBenchOptions& options)
+{
+    int kept = 1;
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+
+        if (strncmp(arg, "--bench-seconds=", 16) == 0)
+        {
+            char* end = NULL;
+            options.seconds = strtod(arg + 16, &end);
+            if (end == arg + 16 || *end != '\0' || !(options.seconds > 0))
+            {
+                fprintf(stderr, "Bad benchmark duration '%s'.\n", arg + 16);
+                return false;
+            }
+        }
+        else if (strncmp(arg, "--bench-label=", 14) == 0)
+        {
+            options.label = arg + 14;
+        }
+        else if (strncmp(arg, "--bench-json=", 13) == 0)
+        {
+            options.jsonPath = arg + 13;
+        }
+        else if (strncmp(arg, "--bench-catchup=", 16) == 0)
+        {
+            int maxTicks = 0;
+            options.catchUp = arg + 16;
+            if (strcmp(options.catchUp, "skip") != 0 && strcmp(options.catchUp, "substep") != 0 &&
+                !(sscanf(options.catchUp, "substep:%d", &maxTicks) == 1 && maxTicks > 0))
+            {
+                fprintf(stderr, "Bad catch-up policy '%s'.\n", options.catchUp);
+                return false;
+            }
+        }
+        else
+        {
+            argv[kept++] = argv[i];
+        }
+    }
+    argc = kept;
+    argv[argc] = NULL;
+    return true;
+}
+
+/******************************************************************************
+ Runs the benchmark and writes its report.
+******************************************************************************/
+int runServoBench(const ServoBenchOptions& options, HDSchedulerCallback callback, void* userData)
+{
+    HDErrorInfo error;
+
+    HDdouble rate = 0;
+    hdGetDoublev(HD_UPDATE_RATE, &rate);
+    const size_t capacity = (size_t) (options.seconds * rate * kSampleHeadroom) + 1;
+
+    BenchSamples samples;
+    samples.callbackUs.resize(capacity);
+    samples.periodUs.resize(capacity);
+    samples.latencyUs.resize(capacity);
+    samples.count = 0;
+    samples.ticks = 0;
+    samples.missed = 0;
+    samples.dropped = 0;
+    samples.period = 1.0 / rate;
+    samples.previousStart = 0;
+
+    if (options.catchUp != NULL)
+    {
+        int maxTicks = 4;
+        sscanf(options.catchUp, "substep:%d", &maxTicks);
+        simSetCatchUpPolicy(strcmp(options.catchUp, "skip") == 0 ? SIM_CATCHUP_SKIP : SIM_CATCHUP_SUBSTEP,
+                            maxTicks);
+    }
+
+    HDSchedulerHandle handle = hdScheduleAsynchronous(callback, userData, HD_MAX_SCHEDULER_PRIORITY);
+    if (HD_DEVICE_ERROR(error = hdGetError()))
+    {
+        hduPrintError(stderr, &error, "Failed to schedule the benchmarked callback");
+        return -1;
+    }
+
+    simSetTickObserver(recordTick, &samples);
+    hdStartScheduler();
+    if (HD_DEVICE_ERROR(error = hdGetError()))
+    {
+        hduPrintError(stderr, &error, "Failed to start scheduler");
+        simSetTickObserver(NULL, NULL);
+        hdUnschedule(handle);
+        return -1;
+    }
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(options.seconds));
+
+    // Stopping joins the scheduler thread, so the samples are safe to read after this.
+    hdStopScheduler();
+    SimSchedulerStats stats;
+    simGetSchedulerStats(&stats);
+    hdUnschedule(handle);
+    simSetTickObserver(NULL, NULL);
+
+    FILE* out = stdout;
+    if (options.jsonPath != NULL)
+    {
+        out = fopen(options.jsonPath, "w");
+        if (out == NULL)
+        {
+            fprintf(stderr, "Cannot create '%s'.\n", options.jsonPath);
+            return -1;
+        }
+    }
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"label\": ");
+    writeJsonString(out, options.label);
+    fprintf(out, ",\n");
+    fprintf(out, "  \"servo_rate_hz\": %.0f,\n", rate);
+    fprintf(out, "  \"seconds\": %.3f,\n", options.seconds);
+    fprintf(out, "  \"ticks\": %llu,\n", samples.ticks);
+    fprintf(out, "  \"missed_deadlines\": %lu,\n", samples.missed);
+    fprintf(out, "  \"dropped_samples\": %lu,\n", samples.dropped);
+    fprintf(out, "  \"catch_up_policy\": \"%s\",\n", simCatchUpPolicy() == SIM_CATCHUP_SKIP ? "skip" : "substep");
+    fprintf(out, "  \"overruns\": %llu,\n", stats.overruns);
+    fprintf(out, "  \"skipped_ticks\": %llu,\n", stats.skippedTicks);
+    fprintf(out, "  \"catch_up_ticks\": %llu,\n", stats.catchUpTicks);
+    writeDistribution(out, "callback_us", samples.callbackUs, samples.count, false);
+    writeDistribution(out, "period_us", samples.periodUs, samples.count, false);
+    writeDistribution(out, "wakeup_latency_us", samples.latencyUs, samples.count, true);
+    fprintf(out, "}\n");
+
+    if (out != stdout)
+    {
+        fclose(out);
+    }
+    return 0;
+}
+
+/******************************************************************************/
@@ -0,0 +1,51 @@
+/*****************************************************************************
+
+Module Name:
+
+  servoBench.h
+
+Description:
+
+  Servo loop benchmark. Runs a servo callback on the simulated device for
+  a fixed time and reports, as JSON, the distribution of the callback's
+  run time, of the period between ticks and of the scheduler's wakeup
+  latency, how many ticks missed their deadline, and the scheduler's
+  overrun and catch-up counts.
+
+*******************************************************************************/
+
+#ifndef ServoBench_H_
+#define ServoBench_H_
+
+#include <HD/hd.h>
+
+struct ServoBenchOptions
+{
+    // How long to run the callback for (s).
+    double seconds;
+
+    // Free text copied into the report, e.g. the scene variant or build.
+    const char* label;
+
+    // File to write the report to, or NULL for stdout.
+    const char* jsonPath;
+
+    // Catch-up policy to run with, or NULL to keep SIMHD_CATCHUP's.
+    const char* catchUp;
+
+    ServoBenchOptions();
+};
+
+/* Reads --bench-seconds=, --bench-label=, --bench-json= and
+   --bench-catchup=skip|substep[:N] and removes them from argv. Prints a
+   message and returns false on a bad value. */
+bool parseServoBenchOptions(int& argc, char* argv[], ServoBenchOptions& options);
+
+/* Schedules the callback at the highest priority, runs the scheduler for
+   options.seconds, then stops it and writes the report. The device must be
+   initialized and the scheduler stopped. Returns 0, or -1 on an HD error. */
+int runServoBench(const ServoBenchOptions& options, HDSchedulerCallback callback, void* userData);
+
+#endif /* ServoBench_H_ */
+
+/******************************************************************************/
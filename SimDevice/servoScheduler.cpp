@@ -0,0 +1,421 @@
+/*****************************************************************************
+
+Module Name:
+
+  servoScheduler.cpp
+
+Description:
+
+  Servo loop scheduler of the simulated device.
+
+*******************************************************************************/
+
+#include <errno.h>
+#include <time.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "monotonicClock.h"
+#include "servoScheduler.h"
+
+namespace
+{
+
+const HDulong kSupportedRates[] = { 500, 1000, 2000, 4000, 8000 };
+const HDulong kDefaultRate = 1000;
+
+const long long kNsPerSecond = 1000000000LL;
+
+void sleepUntilNs(long long deadline)
+{
+#if defined(__linux__)
+    timespec when;
+    when.tv_sec = (time_t) (deadline / kNsPerSecond);
+    when.tv_nsec = (long) (deadline % kNsPerSecond);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &when, NULL) == EINTR)
+    {
+    }
+#else
+    std::this_thread::sleep_until(std::chrono::steady_clock::time_point(
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(deadline))));
+#endif
+}
+
+double toSeconds(long long ns)
+{
+    return ns * 1e-9;
+}
+
+} // namespace
+
+ServoScheduler::ServoScheduler()
+    : m_nextHandle(1),
+      m_running(false),
+      m_rate(kDefaultRate),
+      m_policy(SIM_CATCHUP_SKIP),
+      m_maxCatchUpTicks(4),
+      m_hook(NULL),
+      m_hookData(NULL),
+      m_observer(NULL),
+      m_observerData(NULL),
+      m_tickStart(0),
+      m_previousStart(0),
+      m_previousTick(0),
+      m_ticks(0),
+      m_overruns(0),
+      m_skippedTicks(0),
+      m_catchUpTicks(0)
+{
+    // Room for far more callbacks than any program here schedules, so a
+    // tick never allocates.
+    m_callbacks.reserve(64);
+    for (int i = 0; i < 3; ++i)
+    {
+        m_published.slot(i).reserve(64);
+    }
+    m_finished.init(64);
+    m_retired.reserve(64);
+    m_unposted.reserve(64);
+}
+
+ServoScheduler::~ServoScheduler()
+{
+    stop();
+}
+
+bool ServoScheduler::supportedRate(HDulong rate)
+{
+    return std::find(kSupportedRates, kSupportedRates + sizeof(kSupportedRates) / sizeof(kSupportedRates[0]),
+                     rate) != kSupportedRates + sizeof(kSupportedRates) / sizeof(kSupportedRates[0]);
+}
+
+void ServoScheduler::start()
+{
+    if (m_running.load())
+    {
+        return;
+    }
+    m_ticks.store(0);
+    m_overruns.store(0);
+    m_skippedTicks.store(0);
+    m_catchUpTicks.store(0);
+    m_running.store(true);
+    m_thread = std::thread(&ServoScheduler::run, this);
+}
+
+void ServoScheduler::stop()
+{
+    if (!m_thread.joinable())
+    {
+        return;
+    }
+    m_running.store(false);
+    if (!onSchedulerThread())
+    {
+        m_thread.join();
+    }
+    else
+    {
+        m_thread.detach();
+    }
+
+    // Release anyone waiting on a synchronous callback.
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_changed.notify_all();
+}
+
+bool ServoScheduler::setRate(HDulong rate)
+{
+    if (!supportedRate(rate) || m_running.load())
+    {
+        return false;
+    }
+    m_rate = rate;
+    return true;
+}
+
+void ServoScheduler::setCatchUpPolicy(SimCatchUpPolicy policy, int maxCatchUpTicks)
+{
+    m_policy = policy;
+    m_maxCatchUpTicks = maxCatchUpTicks > 0 ? maxCatchUpTicks : 1;
+}
+
+void ServoScheduler::setTickHook(ServoTickHook hook, void* userData)
+{
+    m_hook = hook;
+    m_hookData = userData;
+}
+
+void ServoScheduler::setObserver(SimTickObserver observer, void* userData)
+{
+    m_observer = observer;
+    m_observerData = userData;
+}
+
+bool ServoScheduler::higherPriority(const ScheduledCallback& a, const ScheduledCallback& b)
+{
+    return a.priority > b.priority;
+}
+
+bool ServoScheduler::contains(const std::vector<ScheduledCallback>& callbacks, HDSchedulerHandle handle)
+{
+    for (size_t i = 0; i < callbacks.size(); ++i)
+    {
+        if (callbacks[i].handle == handle)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Hands the current list to the scheduler thread, which picks it up at its
+   next tick. The scheduler thread never reads the slot written here. */
+void ServoScheduler::publishLocked()
+{
+    m_published.writeBuffer().assign(m_callbacks.begin(), m_callbacks.end());
+    m_published.publish();
+}
+
+bool ServoScheduler::removeLocked(HDSchedulerHandle handle)
+{
+    for (std::vector<ScheduledCallback>::iterator it = m_callbacks.begin(); it != m_callbacks.end(); ++it)
+    {
+        if (it->handle == handle)
+        {
+            m_callbacks.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Unschedules the callbacks the scheduler thread reported finished. */
+void ServoScheduler::collectFinishedLocked()
+{
+    bool removed = false;
+    HDSchedulerHandle handle;
+    while (m_finished.pop(handle))
+    {
+        removed = removeLocked(handle) || removed;
+    }
+    if (removed)
+    {
+        publishLocked();
+        m_changed.notify_all();
+    }
+}
+
+HDSchedulerHandle ServoScheduler::add(HDSchedulerCallback callback, void* userData, HDushort priority)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ScheduledCallback entry;
+    entry.handle = m_nextHandle++;
+    entry.callback = callback;
+    entry.userData = userData;
+    entry.priority = priority;
+
+    // After any callbacks of the same priority, so equal priorities run in
+    // the order they were scheduled.
+    m_callbacks.insert(std::upper_bound(m_callbacks.begin(), m_callbacks.end(), entry, higherPriority), entry);
+    publishLocked();
+    return entry.handle;
+}
+
+bool ServoScheduler::remove(HDSchedulerHandle handle)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    collectFinishedLocked();
+    if (!removeLocked(handle))
+    {
+        return false;
+    }
+    publishLocked();
+    m_changed.notify_all();
+    return true;
+}
+
+bool ServoScheduler::scheduledLocked(HDSchedulerHandle handle) const
+{
+    return contains(m_callbacks, handle);
+}
+
+bool ServoScheduler::scheduled(HDSchedulerHandle handle)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    collectFinishedLocked();
+    return scheduledLocked(handle);
+}
+
+/******************************************************************************
+ The scheduler thread cannot wake the waiter without a system call, so the
+ waiter looks for finished callbacks itself, once a tick.
+******************************************************************************/
+void ServoScheduler::waitUntilDone(HDSchedulerHandle handle)
+{
+    const std::chrono::nanoseconds poll(kNsPerSecond / (long long) m_rate);
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        collectFinishedLocked();
+        if (!m_running.load() || !scheduledLocked(handle))
+        {
+            return;
+        }
+        m_changed.wait_for(lock, poll);
+    }
+}
+
+double ServoScheduler::tickTime() const
+{
+    return toSeconds(monotonicNs() - m_tickStart.load(std::memory_order_relaxed));
+}
+
+SimSchedulerStats ServoScheduler::stats() const
+{
+    SimSchedulerStats stats;
+    stats.ticks = m_ticks.load(std::memory_order_relaxed);
+    stats.overruns = m_overruns.load(std::memory_order_relaxed);
+    stats.skippedTicks = m_skippedTicks.load(std::memory_order_relaxed);
+    stats.catchUpTicks = m_catchUpTicks.load(std::memory_order_relaxed);
+    return stats;
+}
+
+/******************************************************************************
+ The scheduled callbacks of one tick, from the latest published list, so
+ callbacks may schedule and unschedule others without deadlocking and the
+ tick takes no lock. A callback that finishes is skipped from then on until
+ a list without it is published, and its handle is passed back through
+ m_finished; a full ring keeps it for the next tick.
+******************************************************************************/
+void ServoScheduler::runCallbacks()
+{
+    if (m_published.update())
+    {
+        const std::vector<ScheduledCallback>& latest = m_published.readBuffer();
+        size_t kept = 0;
+        for (size_t i = 0; i < m_retired.size(); ++i)
+        {
+            if (contains(latest, m_retired[i]))
+            {
+                m_retired[kept++] = m_retired[i];
+            }
+        }
+        m_retired.resize(kept);
+    }
+
+    const std::vector<ScheduledCallback>& callbacks = m_published.readBuffer();
+    for (size_t i = 0; i < callbacks.size(); ++i)
+    {
+        if (std::find(m_retired.begin(), m_retired.end(), callbacks[i].handle) != m_retired.end())
+        {
+            continue;
+        }
+        if (callbacks[i].callback(callbacks[i].userData) == HD_CALLBACK_DONE)
+        {
+            m_retired.push_back(callbacks[i].handle);
+            m_unposted.push_back(callbacks[i].handle);
+        }
+    }
+
+    size_t posted = 0;
+    while (posted < m_unposted.size() && m_finished.push(m_unposted[posted]))
+    {
+        ++posted;
+    }
+    m_unposted.erase(m_unposted.begin(), m_unposted.begin() + posted);
+}
+
+void ServoScheduler::runTick(unsigned long long tick, long long deadline)
+{
+    const long long start = monotonicNs();
+    m_tickStart.store(start, std::memory_order_relaxed);
+
+    if (m_hook != NULL)
+    {
+        const double dt = 1.0 / m_rate;
+        ServoTick info;
+        info.tick = tick;
+        info.time = tick * dt;
+        info.dt = m_ticks.load(std::memory_order_relaxed) > 0 ? (tick - m_previousTick) * dt : 0;
+        info.measuredPeriod = m_ticks.load(std::memory_order_relaxed) > 0 ? toSeconds(start - m_previousStart) : 0;
+        m_hook(info, m_hookData);
+    }
+    m_previousStart = start;
+    m_previousTick = tick;
+
+    runCallbacks();
+    m_ticks.fetch_add(1, std::memory_order_relaxed);
+
+    if (m_observer != NULL)
+    {
+        SimTickTiming timing;
+        timing.tick = tick;
+        timing.deadline = toSeconds(deadline);
+        timing.start = toSeconds(start);
+        timing.end = toSeconds(monotonicNs());
+        m_observer(timing, m_observerData);
+    }
+}
+
+/******************************************************************************
+ Scheduler thread. After each tick, if the next deadline has already
+ passed, the tick overran: the late ticks are counted and either dropped
+ or, with the substep policy, run back to back. While such a burst is
+ being worked off, the late ticks are not counted as new overruns.
+******************************************************************************/
+void ServoScheduler::run()
+{
+    const long long period = kNsPerSecond / (long long) m_rate;
+
+    unsigned long long tick = 0;
+    unsigned long long burstLeft = 0;
+    long long deadline = monotonicNs();
+    while (m_running.load(std::memory_order_relaxed))
+    {
+        runTick(tick, deadline);
+        ++tick;
+        deadline += period;
+
+        const long long now = monotonicNs();
+        if (now <= deadline)
+        {
+            burstLeft = 0;
+            sleepUntilNs(deadline);
+            continue;
+        }
+        if (burstLeft > 0)
+        {
+            --burstLeft;
+            continue;
+        }
+
+        // Ticks due by now, from the one at deadline on.
+        m_overruns.fetch_add(1, std::memory_order_relaxed);
+        const unsigned long long late = (unsigned long long) ((now - deadline) / period) + 1;
+        unsigned long long catchUp = 0;
+        if (m_policy == SIM_CATCHUP_SUBSTEP)
+        {
+            catchUp = std::min(late, (unsigned long long) m_maxCatchUpTicks);
+        }
+
+        // The oldest late ticks are the ones dropped.
+        const unsigned long long skipped = late - catchUp;
+        tick += skipped;
+        deadline += (long long) skipped * period;
+        m_skippedTicks.fetch_add(skipped, std::memory_order_relaxed);
+        m_catchUpTicks.fetch_add(catchUp, std::memory_order_relaxed);
+
+        if (catchUp > 0)
+        {
+            burstLeft = catchUp - 1;
+        }
+        else
+        {
+            sleepUntilNs(deadline);
+        }
+    }
+}
+
+/******************************************************************************/
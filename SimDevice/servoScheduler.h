@@ -0,0 +1,158 @@
+/*****************************************************************************
+
+Module Name:
+
+  servoScheduler.h
+
+Description:
+
+  Servo loop scheduler of the simulated device. A dedicated thread runs the
+  scheduled callbacks once per tick, in priority order, with ticks released
+  on absolute deadlines (clock_nanosleep with TIMER_ABSTIME on Linux) so
+  the rate never drifts with the callbacks' run time.
+
+  The scheduler thread never takes a lock. Scheduling and unscheduling
+  rebuild the callback list and publish it through a triple buffer, and
+  callbacks that finish are handed back through a ring; the other threads
+  unschedule them the next time they call in.
+
+  A tick overruns when it is still running at the next tick's deadline.
+  Overruns are counted, and the ticks they make late are handled by the
+  catch-up policy:
+
+    skip     drop the late ticks and resume at the next deadline still in
+             the future; device time jumps ahead with the wall clock
+    substep  run up to a set number of the late ticks back to back, each
+             with its own device time, and drop any beyond that
+
+*******************************************************************************/
+
+#ifndef ServoScheduler_H_
+#define ServoScheduler_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <HD/hd.h>
+
+#include "simDevice.h"
+#include "spscRing.h"
+#include "tripleBuffer.h"
+
+/* What a tick hook is told about the tick about to run. */
+struct ServoTick
+{
+    unsigned long long tick; // counting from 0; skipped ticks are counted too
+    double time;             // device time of the tick, tick / rate (s)
+    double dt;               // device time since the previous tick that ran (s)
+    double measuredPeriod;   // wall time since the previous tick started, 0 for the first (s)
+};
+
+typedef void (*ServoTickHook)(const ServoTick& tick, void* userData);
+
+class ServoScheduler
+{
+public:
+    ServoScheduler();
+    ~ServoScheduler();
+
+    /* Rates the scheduler runs at: 500 Hz and 1, 2, 4 or 8 kHz. */
+    static bool supportedRate(HDulong rate);
+
+    void start();
+    void stop();
+    bool running() const { return m_running.load(); }
+    bool onSchedulerThread() const { return std::this_thread::get_id() == m_thread.get_id(); }
+
+    /* The rate, policy and hooks can only change while the scheduler is
+       stopped; setRate returns false otherwise or for an unsupported rate. */
+    HDulong rate() const { return m_rate; }
+    bool setRate(HDulong rate);
+    void setCatchUpPolicy(SimCatchUpPolicy policy, int maxCatchUpTicks);
+    SimCatchUpPolicy catchUpPolicy() const { return m_policy; }
+
+    /* Called on the scheduler thread before each tick's callbacks. */
+    void setTickHook(ServoTickHook hook, void* userData);
+
+    /* Called on the scheduler thread after each tick's callbacks. */
+    void setObserver(SimTickObserver observer, void* userData);
+
+    HDSchedulerHandle add(HDSchedulerCallback callback, void* userData, HDushort priority);
+    bool remove(HDSchedulerHandle handle);
+    bool scheduled(HDSchedulerHandle handle);
+    void waitUntilDone(HDSchedulerHandle handle);
+
+    /* Seconds since the current tick started. */
+    double tickTime() const;
+
+    /* Counters since the scheduler last started. Safe to read while it runs. */
+    SimSchedulerStats stats() const;
+
+private:
+    struct ScheduledCallback
+    {
+        HDSchedulerHandle handle;
+        HDSchedulerCallback callback;
+        void* userData;
+        HDushort priority;
+    };
+
+    static bool higherPriority(const ScheduledCallback& a, const ScheduledCallback& b);
+    static bool contains(const std::vector<ScheduledCallback>& callbacks, HDSchedulerHandle handle);
+
+    void run();
+    void runTick(unsigned long long tick, long long deadline);
+    void runCallbacks();
+    bool scheduledLocked(HDSchedulerHandle handle) const;
+    bool removeLocked(HDSchedulerHandle handle);
+    void publishLocked();
+    void collectFinishedLocked();
+
+    // Callbacks as the other threads see them, guarded by m_mutex, and the
+    // copy of them published to the scheduler thread.
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::vector<ScheduledCallback> m_callbacks;
+    TripleBuffer<std::vector<ScheduledCallback> > m_published;
+    HDSchedulerHandle m_nextHandle;
+
+    // Handles of callbacks that returned HD_CALLBACK_DONE, on their way
+    // from the scheduler thread to m_callbacks.
+    SpscRing<HDSchedulerHandle> m_finished;
+
+    // Scheduler thread only: finished callbacks still in the published
+    // list, which are skipped, and those not yet pushed to m_finished.
+    std::vector<HDSchedulerHandle> m_retired;
+    std::vector<HDSchedulerHandle> m_unposted;
+
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+    HDulong m_rate;
+    SimCatchUpPolicy m_policy;
+    int m_maxCatchUpTicks;
+
+    ServoTickHook m_hook;
+    void* m_hookData;
+    SimTickObserver m_observer;
+    void* m_observerData;
+
+    // Scheduler thread state, in nanoseconds on the monotonic clock.
+    std::atomic<long long> m_tickStart;
+    long long m_previousStart;
+    unsigned long long m_previousTick;
+
+    std::atomic<unsigned long long> m_ticks;
+    std::atomic<unsigned long long> m_overruns;
+    std::atomic<unsigned long long> m_skippedTicks;
+    std::atomic<unsigned long long> m_catchUpTicks;
+
+    ServoScheduler(const ServoScheduler&);
+    ServoScheduler& operator=(const ServoScheduler&);
+};
+
+#endif /* ServoScheduler_H_ */
+
+/******************************************************************************/
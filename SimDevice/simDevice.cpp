@@ -0,0 +1,732 @@
+/*****************************************************************************
+
+Module Name:
+
+  simDevice.cpp
+
+Description:
+
+  Software stand-in for the OpenHaptics HD library: a single simulated
+  device whose HIP follows a scripted or replayed trajectory, the HD error
+  stack, and the HD scheduler calls, which run the servo callbacks on a
+  ServoScheduler at a real fixed rate.
+
+  The HIP position of a tick depends only on the tick number, so two runs
+  with the same trajectory feed the callbacks identical positions.
+
+*******************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <HD/hd.h>
+
+#include "monotonicClock.h"
+#include "servoScheduler.h"
+#include "simDevice.h"
+
+namespace
+{
+
+
+const double kPi = 3.14159265358979323846;
+
+const HHD kDeviceHandle = 0;
+
+// Figures of a Touch class device.
+const double kNominalMaxForce = 3.3; // N
+const double kNominalMaxStiffness = 0.5; // N/mm
+const double kMaxWorkspace[6] = { -210, -110, -85, 210, 205, 130 }; // mm
+const double kUsableWorkspace[6] = { -80, -60, -35, 80, 60, 35 }; // mm
+
+
+/******************************************************************************
+ Errors. Like the HD library, each thread keeps its own error, and the
+ first error raised is kept until hdGetError reads it.
+******************************************************************************/
+thread_local HDErrorInfo tError = { HD_SUCCESS, 0, HD_INVALID_HANDLE };
+
+void raiseError(HDErrorCode code)
+{
+    if (tError.errorCode == HD_SUCCESS)
+    {
+        tError.errorCode = code;
+        tError.internalErrorCode = 0;
+        tError.hHD = kDeviceHandle;
+    }
+}
+
+/******************************************************************************
+ HIP trajectory.
+******************************************************************************/
+enum TrajectoryKind
+{
+    TRAJECTORY_STILL,
+    TRAJECTORY_CIRCLE,
+    TRAJECTORY_SWEEP,
+    TRAJECTORY_FILE
+};
+
+struct TrajectoryKey
+{
+    double t;
+    double p[3];
+};
+
+bool keyBefore(double t, const TrajectoryKey& key)
+{
+    return t < key.t;
+}
+
+struct Trajectory
+{
+    TrajectoryKind kind;
+    double center[3];
+    double radius;
+    double period;
+    std::vector<TrajectoryKey> keys;
+
+    Trajectory()
+        : kind(TRAJECTORY_STILL), radius(50), period(4)
+    {
+        center[0] = center[1] = center[2] = 0;
+    }
+
+    bool load();
+    bool loadFile(const char* path);
+    void position(double t, double out[3]) const;
+};
+
+double envDouble(const char* name, double fallback)
+{
+    const char* value = getenv(name);
+    if (value == NULL)
+    {
+        return fallback;
+    }
+    char* end = NULL;
+    const double v = strtod(value, &end);
+    if (end == value || *end != '\0')
+    {
+        fprintf(stderr, "SimDevice: ignoring bad %s '%s'\n", name, value);
+        return fallback;
+    }
+    return v;
+}
+
+/* Reads the SIMHD_* environment variables. */
+bool Trajectory::load()
+{
+    const char* centerValue = getenv("SIMHD_CENTER");
+    if (centerValue != NULL &&
+        sscanf(centerValue, "%lf,%lf,%lf", &center[0], &center[1], &center[2]) != 3)
+    {
+        fprintf(stderr, "SimDevice: ignoring bad SIMHD_CENTER '%s'\n", centerValue);
+        center[0] = center[1] = center[2] = 0;
+    }
+    radius = envDouble("SIMHD_RADIUS", radius);
+    period = envDouble("SIMHD_PERIOD", period);
+    if (period <= 0)
+    {
+        fprintf(stderr, "SimDevice: SIMHD_PERIOD must be positive\n");
+        return false;
+    }
+
+    const char* name = getenv("SIMHD_TRAJECTORY");
+    if (name == NULL || strcmp(name, "still") == 0)
+    {
+        kind = TRAJECTORY_STILL;
+    }
+    else if (strcmp(name, "circle") == 0)
+    {
+        kind = TRAJECTORY_CIRCLE;
+    }
+    else if (strcmp(name, "sweep") == 0)
+    {
+        kind = TRAJECTORY_SWEEP;
+    }
+    else
+    {
+        kind = TRAJECTORY_FILE;
+        return loadFile(name);
+    }
+    return true;
+}
+
+/* Text file of "t x y z" lines with increasing t; blank lines and lines
+   starting with '#' are skipped. */
+bool Trajectory::loadFile(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if (file == NULL)
+    {
+        fprintf(stderr, "SimDevice: cannot open trajectory '%s'\n", path);
+        return false;
+    }
+
+    keys.clear();
+    char line[256];
+    int lineNumber = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file) != NULL)
+    {
+        ++lineNumber;
+        const char* p = line + strspn(line, " \t");
+        if (*p == '#' || *p == '\n' || *p == '\r' || *p == '\0')
+        {
+            continue;
+        }
+
+        TrajectoryKey key;
+        if (sscanf(p, "%lf %lf %lf %lf", &key.t, &key.p[0], &key.p[1], &key.p[2]) != 4 ||
+            (!keys.empty() && key.t <= keys.back().t))
+        {
+            fprintf(stderr, "SimDevice: bad trajectory line %d in '%s'\n", lineNumber, path);
+            ok = false;
+        }
+        else
+        {
+            keys.push_back(key);
+        }
+    }
+    fclose(file);
+
+    if (ok && keys.empty())
+    {
+        fprintf(stderr, "SimDevice: trajectory '%s' is empty\n", path);
+        ok = false;
+    }
+    return ok;
+}
+
+/* HIP position t seconds after the scheduler started. Replayed files are
+   interpolated linearly and hold their first and last points outside the
+   recorded time span. */
+void Trajectory::position(double t, double out[3]) const
+{
+    const double phase = 2 * kPi * t / period;
+    switch (kind)
+    {
+    case TRAJECTORY_CIRCLE:
+        out[0] = center[0] + radius * cos(phase);
+        out[1] = center[1] + radius * sin(phase);
+        out[2] = center[2];
+        return;
+
+    case TRAJECTORY_SWEEP:
+        out[0] = center[0] + radius * sin(phase);
+        out[1] = center[1];
+        out[2] = center[2];
+        return;
+
+    case TRAJECTORY_FILE:
+        {
+            std::vector<TrajectoryKey>::const_iterator next =
+                std::upper_bound(keys.begin(), keys.end(), t, keyBefore);
+            if (next == keys.begin())
+            {
+                memcpy(out, keys.front().p, sizeof(keys.front().p));
+                return;
+            }
+            if (next == keys.end())
+            {
+                memcpy(out, keys.back().p, sizeof(keys.back().p));
+                return;
+            }
+            const TrajectoryKey& a = *(next - 1);
+            const TrajectoryKey& b = *next;
+            const double s = (t - a.t) / (b.t - a.t);
+            for (int i = 0; i < 3; ++i)
+            {
+                out[i] = a.p[i] + s * (b.p[i] - a.p[i]);
+            }
+            return;
+        }
+
+    default:
+        memcpy(out, center, sizeof(center));
+        return;
+    }
+}
+
+/******************************************************************************
+ Device state. Written by the scheduler thread at the start of every tick
+ and by the callbacks it runs; other threads only read the constant
+ workspace figures.
+******************************************************************************/
+struct DeviceState
+{
+    bool initialized;
+    bool forceOutput;
+    bool maxForceClamping;
+    bool forceRamping;
+    bool softwareForceLimit;
+
+    double position[3], lastPosition[3];
+    double velocity[3], lastVelocity[3];
+    double force[3], lastForce[3];
+
+    double instantaneousRate;
+    int frameDepth;
+};
+
+DeviceState gDevice;
+Trajectory gTrajectory;
+
+void copy3(double* out, const double* in)
+{
+    out[0] = in[0];
+    out[1] = in[1];
+    out[2] = in[2];
+}
+
+/* Moves the HIP to its position at time t, dt after the previous sample. */
+void sampleDevice(double t, double dt)
+{
+    copy3(gDevice.lastPosition, gDevice.position);
+    copy3(gDevice.lastVelocity, gDevice.velocity);
+    copy3(gDevice.lastForce, gDevice.force);
+
+    gTrajectory.position(t, gDevice.position);
+    for (int i = 0; i < 3; ++i)
+    {
+        gDevice.velocity[i] = dt > 0 ? (gDevice.position[i] - gDevice.lastPosition[i]) / dt : 0;
+    }
+}
+
+double schedulerRate();
+
+/* Values of a double valued parameter. Returns how many were written, or
+   0 for a parameter the device does not have. */
+int getDeviceValues(HDenum pname, double* params)
+{
+    switch (pname)
+    {
+    case HD_CURRENT_POSITION: copy3(params, gDevice.position); return 3;
+    case HD_LAST_POSITION: copy3(params, gDevice.lastPosition); return 3;
+    case HD_CURRENT_VELOCITY: copy3(params, gDevice.velocity); return 3;
+    case HD_LAST_VELOCITY: copy3(params, gDevice.lastVelocity); return 3;
+    case HD_CURRENT_FORCE: copy3(params, gDevice.force); return 3;
+    case HD_LAST_FORCE: copy3(params, gDevice.lastForce); return 3;
+
+    case HD_MAX_WORKSPACE_DIMENSIONS:
+        memcpy(params, kMaxWorkspace, sizeof(kMaxWorkspace));
+        return 6;
+    case HD_USABLE_WORKSPACE_DIMENSIONS:
+        memcpy(params, kUsableWorkspace, sizeof(kUsableWorkspace));
+        return 6;
+
+    case HD_NOMINAL_MAX_FORCE: params[0] = kNominalMaxForce; return 1;
+    case HD_NOMINAL_MAX_STIFFNESS: params[0] = kNominalMaxStiffness; return 1;
+    case HD_UPDATE_RATE: params[0] = schedulerRate(); return 1;
+    case HD_INSTANTANEOUS_UPDATE_RATE: params[0] = gDevice.instantaneousRate; return 1;
+
+    default:
+        return 0;
+    }
+}
+
+bool* capability(HDenum cap)
+{
+    switch (cap)
+    {
+    case HD_FORCE_OUTPUT: return &gDevice.forceOutput;
+    case HD_MAX_FORCE_CLAMPING: return &gDevice.maxForceClamping;
+    case HD_FORCE_RAMPING: return &gDevice.forceRamping;
+    case HD_SOFTWARE_FORCE_LIMIT: return &gDevice.softwareForceLimit;
+    default: return NULL;
+    }
+}
+
+/******************************************************************************
+ Scheduler. Asynchronous callbacks run every tick in priority order until
+ they return HD_CALLBACK_DONE or are unscheduled; synchronous callbacks run
+ the same way while the thread that scheduled them waits. Each tick first
+ moves the HIP to its position at the tick's device time.
+******************************************************************************/
+ServoScheduler gScheduler;
+
+double schedulerRate()
+{
+    return (double) gScheduler.rate();
+}
+
+void beginDeviceTick(const ServoTick& tick, void*)
+{
+    gDevice.instantaneousRate = tick.measuredPeriod > 0 ? 1.0 / tick.measuredPeriod : schedulerRate();
+    sampleDevice(tick.time, tick.dt);
+}
+
+/* Reads SIMHD_CATCHUP: "skip" (default), "substep" or "substep:N" to catch
+   up at most N ticks at a time. */
+bool loadCatchUpPolicy()
+{
+    const char* value = getenv("SIMHD_CATCHUP");
+    if (value == NULL || strcmp(value, "skip") == 0)
+    {
+        gScheduler.setCatchUpPolicy(SIM_CATCHUP_SKIP, 1);
+        return true;
+    }
+
+    int maxTicks = 4;
+    if (strcmp(value, "substep") == 0 ||
+        (sscanf(value, "substep:%d", &maxTicks) == 1 && maxTicks > 0))
+    {
+        gScheduler.setCatchUpPolicy(SIM_CATCHUP_SUBSTEP, maxTicks);
+        return true;
+    }
+    fprintf(stderr, "SimDevice: bad SIMHD_CATCHUP '%s'\n", value);
+    return false;
+}
+
+} // namespace
+
+/******************************************************************************
+ Simulated device extensions.
+******************************************************************************/
+void simSetTickObserver(SimTickObserver observer, void* userData)
+{
+    gScheduler.setObserver(observer, userData);
+}
+
+void simSetCatchUpPolicy(SimCatchUpPolicy policy, int maxCatchUpTicks)
+{
+    gScheduler.setCatchUpPolicy(policy, maxCatchUpTicks);
+}
+
+SimCatchUpPolicy simCatchUpPolicy()
+{
+    return gScheduler.catchUpPolicy();
+}
+
+void simGetSchedulerStats(SimSchedulerStats* stats)
+{
+    *stats = gScheduler.stats();
+}
+
+double simClock()
+{
+    return monotonicSeconds();
+}
+
+/******************************************************************************
+ Device management.
+******************************************************************************/
+HHD HDAPIENTRY hdInitDevice(HDstring pConfigName)
+{
+    (void) pConfigName;
+    if (gDevice.initialized)
+    {
+        raiseError(HD_DEVICE_ALREADY_INITIATED);
+        return HD_INVALID_HANDLE;
+    }
+    if (!gTrajectory.load() || !loadCatchUpPolicy())
+    {
+        raiseError(HD_COMM_ERROR);
+        return HD_INVALID_HANDLE;
+    }
+
+    memset(&gDevice, 0, sizeof(gDevice));
+    gDevice.initialized = true;
+    gDevice.instantaneousRate = (double) gScheduler.rate();
+    sampleDevice(0, 0);
+    copy3(gDevice.lastPosition, gDevice.position);
+    gScheduler.setTickHook(beginDeviceTick, NULL);
+    return kDeviceHandle;
+}
+
+void HDAPIENTRY hdDisableDevice(HHD hHD)
+{
+    if (hHD != kDeviceHandle || !gDevice.initialized)
+    {
+        raiseError(HD_INVALID_DEVICE_HANDLE);
+        return;
+    }
+    gDevice.initialized = false;
+}
+
+void HDAPIENTRY hdMakeCurrentDevice(HHD hHD)
+{
+    if (hHD != kDeviceHandle)
+    {
+        raiseError(HD_INVALID_DEVICE_HANDLE);
+    }
+}
+
+HHD HDAPIENTRY hdGetCurrentDevice()
+{
+    return gDevice.initialized ? kDeviceHandle : HD_INVALID_HANDLE;
+}
+
+/******************************************************************************
+ Frames. The device state is sampled once per tick, so every frame in a
+ tick sees the same HIP position.
+******************************************************************************/
+void HDAPIENTRY hdBeginFrame(HHD hHD)
+{
+    if (hHD != kDeviceHandle || !gDevice.initialized)
+    {
+        raiseError(HD_INVALID_DEVICE_HANDLE);
+        return;
+    }
+    ++gDevice.frameDepth;
+}
+
+void HDAPIENTRY hdEndFrame(HHD hHD)
+{
+    if (hHD != kDeviceHandle || !gDevice.initialized)
+    {
+        raiseError(HD_INVALID_DEVICE_HANDLE);
+        return;
+    }
+    if (gDevice.frameDepth == 0)
+    {
+        raiseError(HD_INVALID_OPERATION);
+        return;
+    }
+    --gDevice.frameDepth;
+}
+
+/******************************************************************************
+ State queries.
+******************************************************************************/
+void HDAPIENTRY hdGetDoublev(HDenum pname, HDdouble* params)
+{
+    if (getDeviceValues(pname, params) == 0)
+    {
+        raiseError(HD_INVALID_ENUM);
+    }
+}
+
+void HDAPIENTRY hdGetFloatv(HDenum pname, HDfloat* params)
+{
+    double values[6];
+    const int count = getDeviceValues(pname, values);
+    if (count == 0)
+    {
+        raiseError(HD_INVALID_ENUM);
+        return;
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        params[i] = (HDfloat) values[i];
+    }
+}
+
+void HDAPIENTRY hdGetIntegerv(HDenum pname, HDint* params)
+{
+    double values[6];
+    const int count = getDeviceValues(pname, values);
+    if (count == 0)
+    {
+        raiseError(HD_INVALID_ENUM);
+        return;
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        params[i] = (HDint) floor(values[i] + 0.5);
+    }
+}
+
+void HDAPIENTRY hdGetBooleanv(HDenum pname, HDboolean* params)
+{
+    const bool* flag = capability(pname);
+    if (flag == NULL)
+    {
+        raiseError(HD_INVALID_ENUM);
+        return;
+    }
+    params[0] = *flag ? HD_TRUE : HD_FALSE;
+}
+
+HDstring HDAPIENTRY hdGetString(HDenum pname)
+{
+    switch (pname)
+    {
+    case HD_DEVICE_MODEL_TYPE: return "SimDevice";
+    case HD_DEVICE_DRIVER_VERSION: return "1.0";
+    case HD_DEVICE_VENDOR: return "MAE578 software device";
+    case HD_DEVICE_SERIAL_NUMBER: return "00000000000";
+    default:
+        raiseError(HD_INVALID_ENUM);
+        return "";
+    }
+}
+
+/******************************************************************************
+ Force output. With HD_MAX_FORCE_CLAMPING enabled the commanded force is
+ scaled down to the nominal maximum, as on the real device.
+******************************************************************************/
+void HDAPIENTRY hdSetDoublev(HDenum pname, const HDdouble* params)
+{
+    if (pname != HD_CURRENT_FORCE)
+    {
+        raiseError(HD_INVALID_ENUM);
+        return;
+    }
+
+    copy3(gDevice.force, params);
+    if (gDevice.maxForceClamping)
+    {
+        const double magnitude = sqrt(params[0] * params[0] + params[1] * params[1] + params[2] * params[2]);
+        if (magnitude > kNominalMaxForce)
+        {
+            const double scale = kNominalMaxForce / magnitude;
+            for (int i = 0; i < 3; ++i)
+            {
+                gDevice.force[i] *= scale;
+            }
+        }
+    }
+}
+
+void HDAPIENTRY hdSetFloatv(HDenum pname, const HDfloat* params)
+{
+    const double values[3] = { params[0], params[1], params[2] };
+    hdSetDoublev(pname, values);
+}
+
+void HDAPIENTRY hdEnable(HDenum cap)
+{
+    bool* flag = capability(cap);
+    if (flag == NULL)
+    {
+        raiseError(HD_INVALID_ENUM);
+        return;
+    }
+    *flag = true;
+}
+
+void HDAPIENTRY hdDisable(HDenum cap)
+{
+    bool* flag = capability(cap);
+    if (flag == NULL)
+    {
+        raiseError(HD_INVALID_ENUM);
+        return;
+    }
+    *flag = false;
+}
+
+HDboolean HDAPIENTRY hdIsEnabled(HDenum cap)
+{
+    HDboolean enabled = HD_FALSE;
+    hdGetBooleanv(cap, &enabled);
+    return enabled;
+}
+
+/******************************************************************************
+ Errors.
+******************************************************************************/
+HDErrorInfo HDAPIENTRY hdGetError()
+{
+    const HDErrorInfo error = tError;
+    tError.errorCode = HD_SUCCESS;
+    tError.internalErrorCode = 0;
+    tError.hHD = HD_INVALID_HANDLE;
+    return error;
+}
+
+HDstring HDAPIENTRY hdGetErrorString(HDErrorCode errorCode)
+{
+    switch (errorCode)
+    {
+    case HD_SUCCESS: return "No error";
+    case HD_INVALID_ENUM: return "Invalid enumerant";
+    case HD_INVALID_VALUE: return "Invalid value";
+    case HD_INVALID_OPERATION: return "Invalid operation";
+    case HD_DEVICE_ALREADY_INITIATED: return "Device already initiated";
+    case HD_COMM_ERROR: return "Communication error";
+    case HD_DEVICE_FAULT: return "Device fault";
+    case HD_INVALID_DEVICE_HANDLE: return "Invalid device handle";
+    case HD_SCHEDULER_FULL: return "Scheduler full";
+    case HD_INVALID_CALLBACK_HANDLE: return "Invalid callback handle";
+    case HD_TIMER_ERROR: return "Timer error";
+    default: return "Unknown error";
+    }
+}
+
+/******************************************************************************
+ Scheduler.
+******************************************************************************/
+void HDAPIENTRY hdStartScheduler()
+{
+    gScheduler.start();
+}
+
+void HDAPIENTRY hdStopScheduler()
+{
+    gScheduler.stop();
+}
+
+void HDAPIENTRY hdSetSchedulerRate(HDulong rate)
+{
+    if (!ServoScheduler::supportedRate(rate))
+    {
+        raiseError(HD_INVALID_VALUE);
+    }
+    else if (gScheduler.running())
+    {
+        raiseError(HD_INVALID_OPERATION);
+    }
+    else
+    {
+        gScheduler.setRate(rate);
+    }
+}
+
+HDdouble HDAPIENTRY hdGetSchedulerTimeStamp()
+{
+    return gScheduler.tickTime();
+}
+
+HDSchedulerHandle HDAPIENTRY hdScheduleAsynchronous(
+    HDSchedulerCallback pCallback, void* pUserData, HDushort nPriority)
+{
+    return gScheduler.add(pCallback, pUserData, nPriority);
+}
+
+/* Runs the callback on the scheduler thread and waits for it to finish.
+   Before the scheduler starts, or from a servo callback, it runs on the
+   calling thread instead. */
+void HDAPIENTRY hdScheduleSynchronous(
+    HDSchedulerCallback pCallback, void* pUserData, HDushort nPriority)
+{
+    if (!gScheduler.running() || gScheduler.onSchedulerThread())
+    {
+        while (pCallback(pUserData) != HD_CALLBACK_DONE)
+        {
+        }
+        return;
+    }
+
+    const HDSchedulerHandle handle = gScheduler.add(pCallback, pUserData, nPriority);
+    gScheduler.waitUntilDone(handle);
+    gScheduler.remove(handle);
+}
+
+void HDAPIENTRY hdUnschedule(HDSchedulerHandle hHandle)
+{
+    if (!gScheduler.remove(hHandle))
+    {
+        raiseError(HD_INVALID_CALLBACK_HANDLE);
+    }
+}
+
+/* Returns whether the callback is still scheduled, after waiting for it to
+   finish with HD_WAIT_INFINITE. */
+HDboolean HDAPIENTRY hdWaitForCompletion(HDSchedulerHandle hHandle, HDuint param)
+{
+    if (param == HD_WAIT_INFINITE)
+    {
+        gScheduler.waitUntilDone(hHandle);
+    }
+    return gScheduler.scheduled(hHandle) ? HD_TRUE : HD_FALSE;
+}
+
+/******************************************************************************/
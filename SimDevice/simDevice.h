@@ -0,0 +1,60 @@
+/*****************************************************************************
+
+Module Name:
+
+  simDevice.h
+
+Description:
+
+  Extensions of the simulated device that the real HD library does not
+  have. Programs that use them only build with SIMDEVICE=1.
+
+*******************************************************************************/
+
+#ifndef SimDevice_H_
+#define SimDevice_H_
+
+/* Timing of one servo tick, in seconds on the steady clock. */
+struct SimTickTiming
+{
+    unsigned long long tick; // counting from 0 since the scheduler started
+    double deadline;         // when the tick was due to start
+    double start;            // when its first callback was called
+    double end;              // when its last callback returned
+};
+
+typedef void (*SimTickObserver)(const SimTickTiming& timing, void* userData);
+
+/* Installs a function the scheduler thread calls after every tick, or
+   removes it when observer is NULL. Set it while the scheduler is stopped;
+   the observer runs inside the servo loop, so it must not block. */
+void simSetTickObserver(SimTickObserver observer, void* userData);
+
+/* Seconds on the clock SimTickTiming is measured with. */
+double simClock();
+
+/* What the scheduler does with the ticks an overrun made late. */
+enum SimCatchUpPolicy
+{
+    SIM_CATCHUP_SKIP,    // drop them and resume at the next deadline
+    SIM_CATCHUP_SUBSTEP  // run up to maxCatchUpTicks of them back to back
+};
+
+/* Overrides SIMHD_CATCHUP. Set it while the scheduler is stopped. */
+void simSetCatchUpPolicy(SimCatchUpPolicy policy, int maxCatchUpTicks);
+SimCatchUpPolicy simCatchUpPolicy();
+
+struct SimSchedulerStats
+{
+    unsigned long long ticks;        // ticks run
+    unsigned long long overruns;     // ticks still running at the next tick's deadline
+    unsigned long long skippedTicks; // late ticks dropped
+    unsigned long long catchUpTicks; // late ticks run back to back
+};
+
+/* Counters since the scheduler last started. */
+void simGetSchedulerStats(SimSchedulerStats* stats);
+
+#endif /* SimDevice_H_ */
+
+/******************************************************************************/
@@ -42,45 +42,56 @@ static void restore_term(void)
     }
 }
 
-int _kbhit()
+int conio_init()
 {
     static int initialized;
-	
+
+    if(initialized)
+    {
+        return 0;
+    }
+
+    if(tcgetattr(STDIN_FILENO, &term_attribs) < 0)
+    {
+        return -1;
+    }
+
+    term_attribs_old = term_attribs;
+
+    if(atexit(restore_term))
+    {
+        perror("atexit: ");
+        exit(-1);
+    }
+
+    term_attribs.c_lflag &= ~(ECHO | ICANON | ISIG | IEXTEN);
+    term_attribs.c_iflag &= ~(IXON | BRKINT | INPCK | ICRNL | ISTRIP);
+    term_attribs.c_cflag &= ~(CSIZE | PARENB);
+    term_attribs.c_cflag |= CS8;
+    term_attribs.c_cc[VTIME] = 0;
+    term_attribs.c_cc[VMIN] = 0;
+
+    if(tcsetattr(STDIN_FILENO, TCSANOW, &term_attribs) < 0)
+    {
+        perror("tcsetattr: ");
+        exit(-1);
+    }
+
+    initialized = 1;
+    return 0;
+}
+
+int _kbhit()
+{
     fd_set rfds;
     struct timeval tv;
     int retcode;
 	
-    if(!initialized)
+    if(conio_init() < 0)
     {
-        if(tcgetattr(STDIN_FILENO, &term_attribs) < 0)
-        {
-            perror("tcgetattr: ");
-            exit(-1);
-        }
-
-        term_attribs_old = term_attribs;
-
-        if(atexit(restore_term))
-        {
-            perror("atexit: ");
-            exit(-1);
-        }
-
-        term_attribs.c_lflag &= ~(ECHO | ICANON | ISIG | IEXTEN);
-        term_attribs.c_iflag &= ~(IXON | BRKINT | INPCK | ICRNL | ISTRIP);
-        term_attribs.c_cflag &= ~(CSIZE | PARENB);
-        term_attribs.c_cflag |= CS8;
-        term_attribs.c_cc[VTIME] = 0;
-        term_attribs.c_cc[VMIN] = 0;
-
-        if(tcsetattr(STDIN_FILENO, TCSANOW, &term_attribs) < 0)
-        {
-            perror("tcsetattr: ");
-            exit(-1);
-        }
-
-        initialized = 1;
-    }	
+        perror("tcgetattr: ");
+        exit(-1);
+    }
 
     FD_ZERO(&rfds);
     FD_SET(STDIN_FILENO, &rfds);
@@ -26,9 +26,17 @@ Description:
 extern "C" {
 #endif // _cplusplus
 
+/* Puts the console in raw mode (unechoed keys, one at a time, no Enter
+   needed) and restores it at exit. _kbhit does this on its first call.
+   Returns 0, or -1 if the console is not a terminal. */
+int conio_init();
+
 int _kbhit();
 int getch();
 
+/* Windows spelling of getch, so the examples build unchanged. */
+#define _getch getch
+
 #ifdef _cplusplus
 }
 #endif // _cplusplus
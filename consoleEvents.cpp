@@ -0,0 +1,241 @@
+/*****************************************************************************
+
+Module Name:
+
+  consoleEvents.cpp
+
+Description:
+
+  Event loop for the console programs.
+
+*******************************************************************************/
+
+#include <stdio.h>
+
+#include "consoleEvents.h"
+
+#if defined(__linux__)
+# include <errno.h>
+# include <signal.h>
+# include <stdint.h>
+# include <string.h>
+# include <unistd.h>
+# include <sys/epoll.h>
+# include <sys/eventfd.h>
+# include <sys/signalfd.h>
+# include "conio.h"
+#else
+# include <chrono>
+# include <thread>
+# if defined(WIN32)
+#  include <conio.h>
+# else
+#  include "conio.h"
+# endif
+#endif
+
+namespace
+{
+
+#if !defined(__linux__)
+// How often the keyboard is polled where there is no epoll (ms).
+const int kPollPeriod = 10;
+#endif
+
+} // namespace
+
+/******************************************************************************
+ ConsoleEvents
+******************************************************************************/
+ConsoleEvents::ConsoleEvents() :
+    m_epoll(-1),
+    m_notify(-1),
+    m_signals(-1),
+    m_console(false),
+    m_consoleTerminal(false),
+    m_notified(false)
+{
+}
+
+ConsoleEvents::~ConsoleEvents()
+{
+    close();
+}
+
+#if defined(__linux__)
+
+/******************************************************************************
+ Sets up the epoll set: the console, the eventfd and the signalfd.
+******************************************************************************/
+bool ConsoleEvents::open()
+{
+    sigset_t quitSignals;
+    sigemptyset(&quitSignals);
+    sigaddset(&quitSignals, SIGINT);
+    sigaddset(&quitSignals, SIGTERM);
+    sigaddset(&quitSignals, SIGHUP);
+    if (sigprocmask(SIG_BLOCK, &quitSignals, NULL) != 0)
+    {
+        fprintf(stderr, "Cannot block the quit signals (%s).\n", strerror(errno));
+        return false;
+    }
+
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    m_notify = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    m_signals = signalfd(-1, &quitSignals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (m_epoll < 0 || m_notify < 0 || m_signals < 0)
+    {
+        fprintf(stderr, "Cannot set up the console event loop (%s).\n", strerror(errno));
+        close();
+        return false;
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = m_notify;
+    epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_notify, &event);
+    event.data.fd = m_signals;
+    epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_signals, &event);
+
+    // Keys arrive one at a time, unechoed, without waiting for Enter. A
+    // redirected console cannot be put in raw mode and is read as it is;
+    // a regular file cannot be waited on at all.
+    m_consoleTerminal = conio_init() == 0;
+    event.data.fd = STDIN_FILENO;
+    m_console = epoll_ctl(m_epoll, EPOLL_CTL_ADD, STDIN_FILENO, &event) == 0;
+    return true;
+}
+
+void ConsoleEvents::close()
+{
+    if (m_epoll >= 0)
+    {
+        ::close(m_epoll);
+    }
+    if (m_notify >= 0)
+    {
+        ::close(m_notify);
+    }
+    if (m_signals >= 0)
+    {
+        ::close(m_signals);
+    }
+    m_epoll = m_notify = m_signals = -1;
+    m_console = false;
+}
+
+/******************************************************************************
+ Wakes the waiting thread: one write to the eventfd.
+******************************************************************************/
+void ConsoleEvents::notify()
+{
+    const uint64_t one = 1;
+    if (m_notify >= 0 && write(m_notify, &one, sizeof(one)) < 0)
+    {
+        // Only fails when the counter is about to overflow, i.e. a wakeup is pending anyway.
+    }
+}
+
+/******************************************************************************
+ Sleeps in epoll_wait until one of the sources is ready.
+******************************************************************************/
+ConsoleEvents::Event ConsoleEvents::wait(int timeoutMs, int& value)
+{
+    for (;;)
+    {
+        struct epoll_event event;
+        const int ready = epoll_wait(m_epoll, &event, 1, timeoutMs);
+        if (ready < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (ready <= 0)
+        {
+            return EVENT_TIMEOUT;
+        }
+
+        if (event.data.fd == m_notify)
+        {
+            uint64_t count;
+            if (read(m_notify, &count, sizeof(count)) == (ssize_t) sizeof(count))
+            {
+                return EVENT_NOTIFY;
+            }
+        }
+        else if (event.data.fd == m_signals)
+        {
+            struct signalfd_siginfo info;
+            if (read(m_signals, &info, sizeof(info)) == (ssize_t) sizeof(info))
+            {
+                value = (int) info.ssi_signo;
+                return EVENT_SIGNAL;
+            }
+        }
+        else
+        {
+            unsigned char key;
+            const ssize_t count = read(STDIN_FILENO, &key, 1);
+            if (count == 1)
+            {
+                value = key;
+                return EVENT_KEY;
+            }
+            if (count == 0 && !m_consoleTerminal)
+            {
+                // End of a redirected console: from now on only notify() and signals wake us.
+                epoll_ctl(m_epoll, EPOLL_CTL_DEL, STDIN_FILENO, NULL);
+                m_console = false;
+            }
+        }
+    }
+}
+
+#else
+
+/******************************************************************************
+ Without epoll the console is polled; there are no signal events.
+******************************************************************************/
+bool ConsoleEvents::open()
+{
+    m_console = true;
+    m_consoleTerminal = true;
+    return true;
+}
+
+void ConsoleEvents::close()
+{
+    m_console = false;
+}
+
+void ConsoleEvents::notify()
+{
+    m_notified.store(true);
+}
+
+ConsoleEvents::Event ConsoleEvents::wait(int timeoutMs, int& value)
+{
+    const std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    for (;;)
+    {
+        if (m_notified.exchange(false))
+        {
+            return EVENT_NOTIFY;
+        }
+        if (_kbhit())
+        {
+            value = _getch();
+            return EVENT_KEY;
+        }
+        if (timeoutMs >= 0 && std::chrono::steady_clock::now() >= deadline)
+        {
+            return EVENT_TIMEOUT;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(kPollPeriod));
+    }
+}
+
+#endif
+
+/******************************************************************************/
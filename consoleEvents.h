@@ -0,0 +1,69 @@
+/*****************************************************************************
+
+Module Name:
+
+  consoleEvents.h
+
+Description:
+
+  Event loop for the console programs. The main thread sleeps until a key
+  is pressed, another thread asks it to wake up (for example the servo
+  callback when it stops), or the process is asked to quit with SIGINT,
+  SIGTERM or SIGHUP, instead of polling the keyboard and the scheduler in
+  a loop that keeps a core busy.
+
+  On Linux this is one epoll set holding the console, an eventfd and a
+  signalfd. Elsewhere the keyboard is still polled, but with a short sleep
+  between polls.
+
+*******************************************************************************/
+
+#ifndef ConsoleEvents_H_
+#define ConsoleEvents_H_
+
+#include <atomic>
+
+class ConsoleEvents
+{
+public:
+    enum Event
+    {
+        EVENT_KEY,     // a key was pressed
+        EVENT_NOTIFY,  // notify() was called
+        EVENT_SIGNAL,  // a quit signal arrived
+        EVENT_TIMEOUT
+    };
+
+    ConsoleEvents();
+    ~ConsoleEvents();
+
+    /* Puts the console in raw mode and sets up the event sources. The quit
+       signals are blocked in the calling thread, and threads inherit that,
+       so call this from main before any other thread starts. Prints a
+       message and returns false on failure. A console that is not a
+       terminal still delivers keys, until its end. */
+    bool open();
+    void close();
+
+    /* Wakes wait() with EVENT_NOTIFY. Safe from any thread. */
+    void notify();
+
+    /* Sleeps until one of the events, or for at most timeoutMs (-1 for no
+       limit). value receives the key or the signal number. */
+    Event wait(int timeoutMs, int& value);
+
+private:
+    int m_epoll;
+    int m_notify;  // eventfd
+    int m_signals; // signalfd
+    bool m_console;         // the console is in the epoll set
+    bool m_consoleTerminal; // and is a terminal, which never ends
+    std::atomic<bool> m_notified;
+
+    ConsoleEvents(const ConsoleEvents&);
+    ConsoleEvents& operator=(const ConsoleEvents&);
+};
+
+#endif /* ConsoleEvents_H_ */
+
+/******************************************************************************/